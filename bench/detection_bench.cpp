@@ -0,0 +1,679 @@
+//
+//  detection_bench.cpp
+//  Inference
+//
+//  Microbenchmarks for the detection and tracking hot paths.
+//
+//  The repository ships the .param graphs but not the .bin weights, so the
+//  inference benchmarks load the graph with zero-filled weights: ncnn asks
+//  the DataReader for every weight blob with the shape given in the param
+//  file, which times exactly like the trained model.
+//
+//  Usage: bench [--benchmark_filter=<regex>] [--benchmark_format=json]
+//               [--benchmark_out=<file>]
+//  OHTRACK_BENCH_PARAM overrides the param file used for inference.
+//
+
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <thread>
+
+#include "box_geometry.h"
+#include "candidate_scorer.h"
+#include "detector_yolo_inference.hpp"
+#include "inference_allocator.h"
+#include "raw_video.h"
+#include "spatial_grid.h"
+#include "tiled_detection.h"
+#include "utils.h"
+#include "tracker_core.h"
+#include "yolo_decode_layer.h"
+
+namespace {
+
+class DataReaderFromEmpty : public ncnn::DataReader
+{
+public:
+    int scan(const char* format, void* p) const override { return 0; }
+    size_t read(void* buf, size_t size) const override
+    {
+        memset(buf, 0, size);
+        return size;
+    }
+};
+
+const char* modelParamPath()
+{
+    const char* path = std::getenv("OHTRACK_BENCH_PARAM");
+    return path ? path : BENCH_MODEL_PARAM;
+}
+
+// One synthetic net per thread count (and decode placement), loaded on
+// first use. `fused` appends the YoloDecode layer, as InferenceService does.
+ncnn::Net* syntheticModel(int numThreads, bool fused = false)
+{
+    static std::map<std::pair<int, bool>, std::unique_ptr<ncnn::Net>> nets;
+    auto it = nets.find({numThreads, fused});
+    if (it != nets.end())
+        return it->second.get();
+
+    auto net = std::make_unique<ncnn::Net>();
+    net->opt.num_threads = numThreads;
+    yolo::DecodeLayerParams decode;
+    decode.numLabels = 1;
+    if ((fused ? yolo::load_param_with_decode(*net, modelParamPath(), decode) : net->load_param(modelParamPath())) != 0)
+        return nullptr;
+    DataReaderFromEmpty dr;
+    net->load_model(dr);
+    return (nets[{numThreads, fused}] = std::move(net)).get();
+}
+
+cv::Mat syntheticFrame(int width, int height)
+{
+    cv::Mat frame(height, width, CV_8UC3);
+    cv::randu(frame, cv::Scalar(0, 0, 0), cv::Scalar(255, 255, 255));
+    return frame;
+}
+
+std::vector<yolo::Object> syntheticObjects(int n, int imgSize = 640)
+{
+    cv::RNG rng(12345);
+    std::vector<yolo::Object> objects(n);
+    for (auto& obj : objects) {
+        float w = rng.uniform(8.0, 160.0);
+        float h = rng.uniform(8.0, 160.0);
+        obj.rect = cv::Rect_<float>(rng.uniform(0.0, imgSize - w), rng.uniform(0.0, imgSize - h), w, h);
+        obj.label = 0;
+        obj.prob = rng.uniform(0.5, 1.0);
+    }
+    return objects;
+}
+
+std::vector<BoxInfo> syntheticBoxes(int n, int width = 1920, int height = 1080)
+{
+    cv::RNG rng(54321);
+    std::vector<BoxInfo> boxes;
+    for (int i = 0; i < n; i++) {
+        int w = rng.uniform(16, 400);
+        int h = rng.uniform(16, 400);
+        boxes.emplace_back(-1, 0, float(rng.uniform(0.5, 1.0)), rng.uniform(0, width - w), rng.uniform(0, height - h), w, h);
+    }
+    return boxes;
+}
+
+}
+
+// ---- INPUT ---- //
+// Writes `frames` frames of noise at the given size, once per size.
+static std::string syntheticVideo(int width, int height, bool y4m, int frames = 30)
+{
+    std::string path = "/tmp/ohtrack_bench_" + std::to_string(width) + "x" + std::to_string(height) +
+                       (y4m ? ".y4m" : ".avi");
+    if (std::ifstream(path).good())
+        return path;
+
+    cv::Mat bgr = syntheticFrame(width, height);
+    if (y4m) {
+        cv::Mat i420;
+        cv::cvtColor(bgr, i420, cv::COLOR_BGR2YUV_I420);
+        std::ofstream out(path, std::ios::binary);
+        out << "YUV4MPEG2 W" << width << " H" << height << " F30:1 Ip A1:1 C420jpeg\n";
+        for (int i = 0; i < frames; i++) {
+            out << "FRAME\n";
+            out.write(reinterpret_cast<const char*>(i420.data), std::streamsize(i420.total()));
+        }
+        return path;
+    }
+    cv::VideoWriter writer(path, cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), 30, bgr.size());
+    for (int i = 0; i < frames; i++)
+        writer.write(bgr);
+    return path;
+}
+
+// Frames from an (MJPG) file through cv::VideoCapture, as the demo reads
+// ordinary video: decode plus conversion to BGR.
+static void BM_VideoCaptureRead(benchmark::State& state)
+{
+    const std::string path = syntheticVideo(int(state.range(0)), int(state.range(1)), false);
+    cv::VideoCapture cap(path);
+    if (!cap.isOpened()) {
+        state.SkipWithError("cannot write or open the MJPG test video");
+        return;
+    }
+    cv::Mat frame;
+    for (auto _ : state) {
+        if (!cap.read(frame)) {
+            state.PauseTiming();
+            cap.open(path);
+            cap.read(frame);
+            state.ResumeTiming();
+        }
+        benchmark::DoNotOptimize(frame.data);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_VideoCaptureRead)->ArgNames({"w", "h"})
+    ->Args({1920, 1080})->Args({3840, 2160})
+    ->Unit(benchmark::kMicrosecond);
+
+// The same frames from a mapped y4m file. bgr=0 is what the YUV pipeline
+// consumes (a header over the mapping; the luma mean touches its pages),
+// bgr=1 adds the conversion the BGR pipeline would need.
+static void BM_RawVideoRead(benchmark::State& state)
+{
+    const std::string path = syntheticVideo(int(state.range(0)), int(state.range(1)), true);
+    const bool bgr = state.range(2) != 0;
+    MappedVideoReader reader;
+    if (!reader.open(path)) {
+        state.SkipWithError("cannot write or map the y4m test video");
+        return;
+    }
+    YuvFrame yuv;
+    cv::Mat frame;
+    for (auto _ : state) {
+        if (!reader.read(yuv)) {
+            reader.open(path);
+            reader.read(yuv);
+        }
+        if (bgr)
+            yuv.toBgr(frame);
+        else
+            benchmark::DoNotOptimize(cv::mean(yuv.luma()));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RawVideoRead)->ArgNames({"w", "h", "bgr"})
+    ->Args({1920, 1080, 0})->Args({1920, 1080, 1})->Args({3840, 2160, 0})->Args({3840, 2160, 1})
+    ->Unit(benchmark::kMicrosecond);
+
+// ---- PREPROCESS ---- //
+static void BM_Letterbox(benchmark::State& state)
+{
+    cv::Mat frame = syntheticFrame(int(state.range(0)), int(state.range(1)));
+    for (auto _ : state) {
+        yolo::Letterbox lb;
+        yolo::letterbox(frame, TARGET_SIZE, lb);
+        benchmark::DoNotOptimize(lb.in_pad.data);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Letterbox)->ArgNames({"w", "h"})
+    ->Args({1280, 720})->Args({1920, 1080})->Args({3840, 2160})
+    ->Unit(benchmark::kMicrosecond);
+
+// ---- INFERENCE ---- //
+static void BM_Inference(benchmark::State& state)
+{
+    ncnn::Net* net = syntheticModel(int(state.range(0)));
+    if (!net) {
+        state.SkipWithError("cannot load model param");
+        return;
+    }
+    yolo::Letterbox lb;
+    yolo::letterbox(syntheticFrame(1920, 1080), TARGET_SIZE, lb);
+    for (auto _ : state) {
+        ncnn::Extractor ex = net->create_extractor();
+        ex.input("in0", lb.in_pad);
+        ncnn::Mat out;
+        ex.extract("out0", out, 0);
+        benchmark::DoNotOptimize(out.data);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Inference)->ArgName("threads")->Arg(1)->Arg(2)->Arg(4)->Arg(8)
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// fused=1 decodes in the YoloDecode layer, fused=0 scans out0 on the host.
+static void BM_Detect(benchmark::State& state)
+{
+    ncnn::Net* net = syntheticModel(4, state.range(2) != 0);
+    if (!net) {
+        state.SkipWithError("cannot load model param");
+        return;
+    }
+    DetectorClassInfo classInfo = {1, {0}};
+    cv::Mat frame = syntheticFrame(int(state.range(0)), int(state.range(1)));
+    for (auto _ : state) {
+        std::vector<BoxInfo> results;
+        yolo::detect(classInfo, *net, frame, results);
+        benchmark::DoNotOptimize(results.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Detect)->ArgNames({"w", "h", "fused"})
+    ->Args({1920, 1080, 0})->Args({1920, 1080, 1})->Args({3840, 2160, 0})->Args({3840, 2160, 1})
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// yolo::detect on a worker's pooled allocators. After the first frame the
+// pools hold every blob, so pool_system_allocs per frame should be 0;
+// BM_Detect above is the same work on ncnn's per-extractor allocators.
+static void BM_DetectPooled(benchmark::State& state)
+{
+    ncnn::Net* net = syntheticModel(4);
+    if (!net) {
+        state.SkipWithError("cannot load model param");
+        return;
+    }
+    DetectorClassInfo classInfo = {1, {0}};
+    cv::Mat frame = syntheticFrame(int(state.range(0)), int(state.range(1)));
+    WorkerAllocators pools;
+    yolo::ExtractorAllocators allocators;
+    allocators.blob = pools.blob();
+    allocators.workspace = pools.workspace();
+    std::vector<BoxInfo> warm;
+    yolo::detect(classInfo, *net, frame, warm, allocators);
+
+    const std::size_t before = pools.getBlobStats().systemAllocations + pools.getWorkspaceStats().systemAllocations;
+    for (auto _ : state) {
+        std::vector<BoxInfo> results;
+        yolo::detect(classInfo, *net, frame, results, allocators);
+        benchmark::DoNotOptimize(results.data());
+    }
+    const AllocatorStats blob = pools.getBlobStats();
+    const AllocatorStats workspace = pools.getWorkspaceStats();
+    state.counters["pool_system_allocs"] = benchmark::Counter(
+        double(blob.systemAllocations + workspace.systemAllocations - before), benchmark::Counter::kAvgIterations);
+    state.counters["blob_peak_MB"] = blob.peakBytes / 1048576.0;
+    state.counters["workspace_peak_MB"] = workspace.peakBytes / 1048576.0;
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DetectPooled)->ArgNames({"w", "h"})
+    ->Args({1920, 1080})->Args({3840, 2160})
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// The first inference of a freshly loaded net, on a fresh thread, with and
+// without yolo::warm_up() before it: the first-frame latency a new stream sees.
+static void BM_FirstInference(benchmark::State& state)
+{
+    const bool warm = state.range(0) != 0;
+    yolo::Letterbox lb;
+    yolo::letterbox(syntheticFrame(1920, 1080), TARGET_SIZE, lb);
+    for (auto _ : state) {
+        ncnn::Net net;
+        net.opt.num_threads = 4;
+        if (net.load_param(modelParamPath()) != 0) {
+            state.SkipWithError("cannot load model param");
+            return;
+        }
+        DataReaderFromEmpty dr;
+        net.load_model(dr);
+        double seconds = 0.0;
+        std::thread first([&] {
+            if (warm)
+                yolo::warm_up(net);
+            auto t0 = std::chrono::steady_clock::now();
+            ncnn::Extractor ex = net.create_extractor();
+            ex.input("in0", lb.in_pad);
+            ncnn::Mat out;
+            ex.extract("out0", out, 0);
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        });
+        first.join();
+        state.SetIterationTime(seconds);
+    }
+}
+BENCHMARK(BM_FirstInference)->ArgName("warm")->Arg(0)->Arg(1)
+    ->Unit(benchmark::kMillisecond)->UseManualTime()->Iterations(5);
+
+// ---- POSTPROCESS ---- //
+// Builds an out0-shaped tensor ((4 + labels) x 8400) where `passPercent` of
+// the anchors score above PROB_THRESHOLD.
+static void BM_ParseDetections(benchmark::State& state)
+{
+    const int numLabels = int(state.range(0));
+    const int passPercent = int(state.range(1));
+    const int numAnchors = 8400;
+    const int numChannels = 4 + numLabels;
+
+    cv::RNG rng(777);
+    std::vector<float> tensor(size_t(numChannels) * numAnchors);
+    for (int a = 0; a < numAnchors; a++) {
+        tensor[0 * numAnchors + a] = rng.uniform(0.0, 640.0);
+        tensor[1 * numAnchors + a] = rng.uniform(0.0, 640.0);
+        tensor[2 * numAnchors + a] = rng.uniform(8.0, 160.0);
+        tensor[3 * numAnchors + a] = rng.uniform(8.0, 160.0);
+        bool pass = rng.uniform(0, 100) < passPercent;
+        for (int c = 0; c < numLabels; c++)
+            tensor[size_t(4 + c) * numAnchors + a] = pass && c == 0 ? rng.uniform(0.6, 1.0) : rng.uniform(0.0, 0.4);
+    }
+
+    for (auto _ : state) {
+        std::vector<yolo::Object> objects;
+        yolo::parse_yolov_detections(tensor.data(), PROB_THRESHOLD, numChannels, numAnchors, numLabels, 640, 640, objects);
+        benchmark::DoNotOptimize(objects.data());
+    }
+    state.SetItemsProcessed(state.iterations() * numAnchors);
+}
+BENCHMARK(BM_ParseDetections)->ArgNames({"labels", "pass%"})
+    ->Args({1, 1})->Args({1, 10})->Args({80, 1})->Args({80, 10})
+    ->Unit(benchmark::kMicrosecond);
+
+// The same tensor through YoloDecode and decode_candidates(), i.e. the host
+// work that is left plus the layer's, when the tensor is cold. In the graph
+// the layer reads it straight after the Concat that wrote it.
+static void BM_DecodeLayer(benchmark::State& state)
+{
+    const int numLabels = int(state.range(0));
+    const int passPercent = int(state.range(1));
+    const int numAnchors = 8400;
+    const int numChannels = 4 + numLabels;
+
+    cv::RNG rng(777);
+    ncnn::Mat tensor(numAnchors, numChannels);
+    for (int a = 0; a < numAnchors; a++) {
+        tensor.row(0)[a] = rng.uniform(0.0, 640.0);
+        tensor.row(1)[a] = rng.uniform(0.0, 640.0);
+        tensor.row(2)[a] = rng.uniform(8.0, 160.0);
+        tensor.row(3)[a] = rng.uniform(8.0, 160.0);
+        bool pass = rng.uniform(0, 100) < passPercent;
+        for (int c = 0; c < numLabels; c++)
+            tensor.row(4 + c)[a] = pass && c == 0 ? rng.uniform(0.6, 1.0) : rng.uniform(0.0, 0.4);
+    }
+
+    ncnn::ParamDict pd;
+    pd.set(0, numLabels);
+    pd.set(1, float(PROB_THRESHOLD));
+    pd.set(2, 640);
+    pd.set(3, 640);
+    yolo::YoloDecodeLayer layer;
+    layer.load_param(pd);
+    ncnn::Option opt;
+    opt.num_threads = 1;
+
+    yolo::Letterbox lb;
+    lb.img_w = lb.img_h = 640;
+    DetectorClassInfo classInfo = {numLabels, {0}};
+    for (auto _ : state) {
+        ncnn::Mat candidates;
+        layer.forward(tensor, candidates, opt);
+        BoxSet results;
+        yolo::decode_candidates(classInfo, candidates, lb, NMS_THRESHOLD, results);
+        benchmark::DoNotOptimize(results.x0.data());
+    }
+    state.SetItemsProcessed(state.iterations() * numAnchors);
+}
+BENCHMARK(BM_DecodeLayer)->ArgNames({"labels", "pass%"})
+    ->Args({1, 1})->Args({1, 10})->Args({80, 1})->Args({80, 10})
+    ->Unit(benchmark::kMicrosecond);
+
+static void BM_QsortDescent(benchmark::State& state)
+{
+    const std::vector<yolo::Object> source = syntheticObjects(int(state.range(0)));
+    std::vector<yolo::Object> objects;
+    for (auto _ : state) {
+        state.PauseTiming();
+        objects = source;
+        state.ResumeTiming();
+        yolo::qsort_descent_inplace(objects);
+        benchmark::DoNotOptimize(objects.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_QsortDescent)->ArgName("n")->RangeMultiplier(4)->Range(16, 4096);
+
+static void BM_NmsSortedBboxes(benchmark::State& state)
+{
+    std::vector<yolo::Object> objects = syntheticObjects(int(state.range(0)));
+    yolo::qsort_descent_inplace(objects);
+    std::vector<int> picked;
+    for (auto _ : state) {
+        yolo::nms_sorted_bboxes(objects, picked, NMS_THRESHOLD);
+        benchmark::DoNotOptimize(picked.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_NmsSortedBboxes)->ArgName("n")->RangeMultiplier(4)->Range(16, 4096);
+
+static void BM_NmsSortedBoxes(benchmark::State& state)
+{
+    BoxSet boxes;
+    for (const yolo::Object& obj : syntheticObjects(int(state.range(0))))
+        boxes.push_back(Box2f::fromRect(obj.rect), obj.prob, obj.label);
+    boxes.sortByScore();
+    std::vector<int> picked;
+    for (auto _ : state) {
+        yolo::nms_sorted_boxes(boxes, picked, NMS_THRESHOLD);
+        benchmark::DoNotOptimize(picked.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_NmsSortedBoxes)->ArgName("n")->RangeMultiplier(4)->Range(16, 4096);
+
+// Cross-tile merge of a 4K frame cut into 640 px tiles; n boxes per tile.
+static void BM_TileMerge(benchmark::State& state)
+{
+    const cv::Size frameSize(3840, 2160);
+    const std::vector<cv::Rect> tiles = yolo::tile_grid(frameSize, yolo::TileLayout());
+    const std::vector<BoxInfo> tileBoxes = syntheticBoxes(int(state.range(0)), 600, 600);
+    std::vector<BoxInfo> results;
+    for (auto _ : state) {
+        yolo::TileMerger merger(frameSize);
+        for (const cv::Rect& tile : tiles)
+            merger.add(tileBoxes, tile, frameSize);
+        results.clear();
+        merger.merge(results);
+        benchmark::DoNotOptimize(results.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * tiles.size());
+}
+BENCHMARK(BM_TileMerge)->ArgName("n")->RangeMultiplier(4)->Range(4, 256);
+
+// ---- BBOX UTILS ---- //
+static void BM_CalculateIoU(benchmark::State& state)
+{
+    std::vector<BoxInfo> boxes = syntheticBoxes(int(state.range(0)));
+    BoxInfo reference = boxes.front();
+    for (auto _ : state) {
+        double sum = 0;
+        for (auto& box : boxes)
+            sum += bboxUtils::calculateIoU(reference, box);
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_CalculateIoU)->ArgName("n")->RangeMultiplier(4)->Range(16, 4096);
+
+static void BM_CalculateOverlap(benchmark::State& state)
+{
+    std::vector<BoxInfo> boxes = syntheticBoxes(int(state.range(0)));
+    cv::Rect reference;
+    bboxUtils::convertToRect(boxes.front(), reference);
+    for (auto _ : state) {
+        double sum = 0;
+        for (auto& box : boxes)
+            sum += bboxUtils::calculateOverlap(reference, box.getBox());
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_CalculateOverlap)->ArgName("n")->RangeMultiplier(4)->Range(16, 4096);
+
+static void BM_ComputeDistance(benchmark::State& state)
+{
+    std::vector<BoxInfo> boxes = syntheticBoxes(int(state.range(0)));
+    BBoxCenter reference = boxes.front().getCenter();
+    for (auto _ : state) {
+        double sum = 0;
+        for (auto& box : boxes)
+            sum += bboxUtils::computeDistance(reference, box.getCenter());
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ComputeDistance)->ArgName("n")->RangeMultiplier(4)->Range(16, 4096);
+
+// All five rank lookups for each candidate, as target selection does.
+static void BM_RankFunctions(benchmark::State& state)
+{
+    std::vector<BoxInfo> boxes = syntheticBoxes(int(state.range(0)));
+    cv::Rect reference;
+    bboxUtils::convertToRect(boxes.front(), reference);
+    BBoxCenter center = boxes.front().getCenter();
+    const double maxArea = 400.0 * 400.0;
+    const double diagonal = std::sqrt(1920.0 * 1920.0 + 1080.0 * 1080.0);
+    for (auto _ : state) {
+        int sum = 0;
+        for (auto& box : boxes) {
+            double distance = bboxUtils::computeDistance(center, box.getCenter());
+            sum += bboxUtils::getConfidenceScoreRank(box.getConfidence());
+            sum += bboxUtils::getDistanceRank(distance, diagonal);
+            sum += bboxUtils::getDistanceFromRank(distance / diagonal);
+            sum += bboxUtils::getAreaRank(box.getWidth() * box.getHeight(), maxArea);
+            sum += bboxUtils::getOverlapRank(reference, box.getBox());
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_RankFunctions)->ArgName("n")->RangeMultiplier(4)->Range(16, 4096);
+
+// The same ranks for the whole batch from SoA arrays, keeping the best five.
+static void BM_CandidateScorerTopK(benchmark::State& state)
+{
+    std::vector<BoxInfo> boxes = syntheticBoxes(int(state.range(0)));
+    CandidateSet candidates;
+    candidates.assign(boxes);
+    ScoringReference reference;
+    bboxUtils::convertToRect(boxes.front(), reference.box);
+    reference.maxArea = 400.0 * 400.0;
+    reference.diagonal = reference.distanceThreshold = std::sqrt(1920.0 * 1920.0 + 1080.0 * 1080.0);
+    CandidateScorer scorer(reference);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(scorer.topK(candidates, 5));
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_CandidateScorerTopK)->ArgName("n")->RangeMultiplier(4)->Range(16, 4096);
+
+static void BM_SortBoundingBox(benchmark::State& state)
+{
+    const std::vector<BoxInfo> source = syntheticBoxes(int(state.range(0)));
+    BoxInfoVector boxes;
+    for (auto _ : state) {
+        state.PauseTiming();
+        boxes = source;
+        state.ResumeTiming();
+        bboxUtils::sortBoundingBox(2, boxes);
+        benchmark::DoNotOptimize(boxes.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SortBoundingBox)->ArgName("n")->RangeMultiplier(4)->Range(16, 1024);
+
+// ---- BOX GEOMETRY ---- //
+// N×M matrices from SoA boxes; items are matrix cells. The label names the
+// row kernels in use (avx2, neon or scalar).
+template <void (*Kernel)(const geometry::BoxView&, const geometry::BoxView&, std::vector<float>&)>
+static void BM_GeometryMatrix(benchmark::State& state)
+{
+    BoxSet rows, columns;
+    rows.assign(syntheticBoxes(int(state.range(0))));
+    columns.assign(syntheticBoxes(int(state.range(1)), 1600, 900));
+    std::vector<float> out;
+    for (auto _ : state) {
+        Kernel(rows, columns, out);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetLabel(geometry::instructionSet());
+    state.SetItemsProcessed(state.iterations() * state.range(0) * state.range(1));
+}
+
+static void geometrySizes(benchmark::internal::Benchmark* b)
+{
+    b->ArgNames({"n", "m"});
+    for (int n : {10, 50, 100, 250, 500})
+        b->Args({n, n});
+}
+
+BENCHMARK_TEMPLATE(BM_GeometryMatrix, geometry::iou)->Apply(geometrySizes);
+BENCHMARK_TEMPLATE(BM_GeometryMatrix, geometry::overlap)->Apply(geometrySizes);
+BENCHMARK_TEMPLATE(BM_GeometryMatrix, geometry::distance)->Apply(geometrySizes);
+BENCHMARK_TEMPLATE(BM_GeometryMatrix, geometry::squaredDistance)->Apply(geometrySizes);
+
+// The same IoU matrix one pair at a time, as before the batch kernels.
+static void BM_PairwiseIoUMatrix(benchmark::State& state)
+{
+    std::vector<BoxInfo> rows = syntheticBoxes(int(state.range(0)));
+    std::vector<BoxInfo> columns = syntheticBoxes(int(state.range(1)), 1600, 900);
+    std::vector<double> out(rows.size() * columns.size());
+    for (auto _ : state) {
+        for (std::size_t i = 0; i < rows.size(); i++)
+            for (std::size_t j = 0; j < columns.size(); j++)
+                out[i * columns.size() + j] = bboxUtils::calculateIoU(rows[i], columns[j]);
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * state.range(1));
+}
+BENCHMARK(BM_PairwiseIoUMatrix)->Apply(geometrySizes);
+
+// Per-frame rebuild, then one neighbour query per box: the grid side of
+// crowded-scene NMS and association.
+static void BM_SpatialGrid(benchmark::State& state)
+{
+    BoxSet boxes;
+    boxes.assign(syntheticBoxes(int(state.range(0)), 3840, 2160));
+    SpatialGrid grid;
+    std::vector<int> near;
+    for (auto _ : state) {
+        grid.build(boxes);
+        std::size_t found = 0;
+        for (std::size_t i = 0; i < boxes.size(); i++) {
+            grid.query(boxes.box(i), 0.f, near);
+            found += near.size();
+        }
+        benchmark::DoNotOptimize(found);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SpatialGrid)->ArgName("n")->RangeMultiplier(4)->Range(16, 4096);
+
+// ---- TRACKING ---- //
+static void BM_CsrtUpdate(benchmark::State& state)
+{
+    const int roiSize = int(state.range(0));
+    cv::Mat frame = syntheticFrame(1920, 1080);
+    cv::Rect target(960 - roiSize / 2, 540 - roiSize / 2, roiSize, roiSize);
+    cv::rectangle(frame, target, cv::Scalar(0, 255, 0), cv::FILLED);
+
+    TrackerManager tracker;
+    tracker.reinit(frame, target);
+    for (auto _ : state) {
+        cv::Rect roi = target;
+        benchmark::DoNotOptimize(tracker.track(frame, roi));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CsrtUpdate)->ArgName("roi")->Arg(32)->Arg(96)->Arg(256)
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_DAMMemory(benchmark::State& state)
+{
+    std::vector<BoxInfo> boxes = syntheticBoxes(int(state.range(0)));
+    std::vector<cv::Rect> rects;
+    bboxUtils::convertToRect(boxes, rects);
+
+    // updateDRM logs every insert; keep that out of the measurement.
+    std::ostringstream sink;
+    std::streambuf* coutBuf = std::cout.rdbuf(sink.rdbuf());
+
+    DAMMemory dam;
+    for (auto _ : state) {
+        for (std::size_t i = 0; i < rects.size(); i++) {
+            if (i % 4 == 0) dam.updateDRM(rects[i]);
+            else dam.updateRAM(rects[i]);
+            benchmark::DoNotOptimize(dam.getMedianArea());
+            benchmark::DoNotOptimize(dam.getBestMemory());
+        }
+        sink.str(std::string());
+    }
+    std::cout.rdbuf(coutBuf);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DAMMemory)->ArgName("n")->RangeMultiplier(4)->Range(16, 1024);
+
+BENCHMARK_MAIN();
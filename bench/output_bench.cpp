@@ -0,0 +1,135 @@
+//
+//  output_bench.cpp
+//  Inference
+//
+//  Per-frame result output: BoundingBoxSaver (one pretty-printed JSON file
+//  per box) against the streaming NDJSON writer and the binary track log,
+//  for writing and for reading back. Files go to a scratch directory under
+//  the system temp path.
+//
+
+#include <benchmark/benchmark.h>
+
+#include <filesystem>
+
+#include "bounding_box_saver.h"
+#include "ndjson_results.h"
+#include "track_log.h"
+
+namespace {
+
+std::filesystem::path scratchDir(const std::string& name)
+{
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "ohtrack_bench" / name;
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    return dir;
+}
+
+TrackLogRecord syntheticRecord(std::uint32_t frame)
+{
+    TrackLogRecord r;
+    r.frameIndex = frame;
+    r.timestampUs = 1700000000000000LL + std::int64_t(frame) * 16667;
+    r.score = 0.9f;
+    r.x = 400.f + frame % 50;
+    r.y = 220.f;
+    r.width = 96.f;
+    r.height = 80.f;
+    return r;
+}
+
+const int readBackRecords = 1000;
+
+}
+
+// ---- WRITE ---- //
+static void BM_BoundingBoxSaverWrite(benchmark::State& state)
+{
+    std::filesystem::path dir = scratchDir("saver_write");
+    std::uint32_t frame = 0;
+    for (auto _ : state) {
+        TrackLogRecord r = syntheticRecord(++frame);
+        cv::Rect box(int(r.x), int(r.y), int(r.width), int(r.height));
+        BoundingBoxSaver::saveBoundingBox((dir / (std::to_string(frame % 1000) + ".json")).string(), box, "frame");
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_BoundingBoxSaverWrite);
+
+static void BM_NdjsonWrite(benchmark::State& state)
+{
+    std::filesystem::path dir = scratchDir("ndjson_write");
+    NdjsonWriter writer((dir / "results.ndjson").string());
+    std::uint32_t frame = 0;
+    for (auto _ : state)
+        writer.write(syntheticRecord(++frame));
+    writer.flush();
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(writer.getBytesWritten());
+}
+BENCHMARK(BM_NdjsonWrite);
+
+static void BM_TrackLogWrite(benchmark::State& state)
+{
+    std::filesystem::path dir = scratchDir("tracklog_write");
+    TrackLogWriter writer((dir / "results.trk").string());
+    std::uint32_t frame = 0;
+    for (auto _ : state)
+        writer.append(syntheticRecord(++frame));
+    writer.flush();
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(writer.getBytesWritten());
+}
+BENCHMARK(BM_TrackLogWrite);
+
+// ---- READ ---- //
+static void BM_BoundingBoxSaverRead(benchmark::State& state)
+{
+    std::filesystem::path dir = scratchDir("saver_read");
+    for (int i = 1; i <= readBackRecords; i++) {
+        TrackLogRecord r = syntheticRecord(i);
+        BoundingBoxSaver::saveBoundingBox((dir / (std::to_string(i) + ".json")).string(),
+                                          cv::Rect(int(r.x), int(r.y), int(r.width), int(r.height)), "frame");
+    }
+    for (auto _ : state) {
+        for (int i = 1; i <= readBackRecords; i++)
+            benchmark::DoNotOptimize(BoundingBoxSaver::loadBoundingBox((dir / (std::to_string(i) + ".json")).string()));
+    }
+    state.SetItemsProcessed(state.iterations() * readBackRecords);
+}
+BENCHMARK(BM_BoundingBoxSaverRead)->Unit(benchmark::kMillisecond);
+
+static void BM_NdjsonRead(benchmark::State& state)
+{
+    std::filesystem::path path = scratchDir("ndjson_read") / "results.ndjson";
+    {
+        NdjsonWriter writer(path.string());
+        for (int i = 1; i <= readBackRecords; i++)
+            writer.write(syntheticRecord(i));
+    }
+    for (auto _ : state) {
+        NdjsonReader reader(path.string());
+        TrackLogRecord r;
+        while (reader.next(r))
+            benchmark::DoNotOptimize(r);
+    }
+    state.SetItemsProcessed(state.iterations() * readBackRecords);
+}
+BENCHMARK(BM_NdjsonRead)->Unit(benchmark::kMillisecond);
+
+static void BM_TrackLogRead(benchmark::State& state)
+{
+    std::filesystem::path path = scratchDir("tracklog_read") / "results.trk";
+    {
+        TrackLogWriter writer(path.string());
+        for (int i = 1; i <= readBackRecords; i++)
+            writer.append(syntheticRecord(i));
+    }
+    for (auto _ : state) {
+        TrackLogReader reader(path.string());
+        benchmark::DoNotOptimize(reader.readAll());
+    }
+    state.SetItemsProcessed(state.iterations() * readBackRecords);
+}
+BENCHMARK(BM_TrackLogRead)->Unit(benchmark::kMillisecond);
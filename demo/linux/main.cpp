@@ -1,214 +1,644 @@
 #include <iostream>
-#include <deque>
+#include <memory>
+#include <thread>
 #include <opencv2/opencv.hpp>
-#include <opencv2/tracking.hpp>
 #include <chrono>
-#include "detector_yolo_inference.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include "inference_service.h"
+#include "memory_profile.h"
+#include "metrics.h"
+#include "overlay_renderer.h"
+#include "preview_sink.h"
+#include "raw_video.h"
+#include "stream_tracker.h"
+#include "encoder_sink.h"
+#include "thread_budget.h"
+#include "work_stealing_executor.h"
+#include "yuv_frame.h"
 
 using namespace yolo;
 
-// ---- CONFIG ---- //
-struct Config {
-    static constexpr int RAM_SIZE = 3; // 3
-    static constexpr int DRM_SIZE = 6;
-    static constexpr int AREA_HISTORY_SIZE = 10;
-    static constexpr int UPDATE_INTERVAL = 10;
-    static constexpr int DETECTION_INTERVAL = 10;
-    static constexpr float IOU_THRESHOLD = 0.4;
-    static constexpr float AREA_TOLERANCE = 0.9;
-    static constexpr double OVERLAP_THRESHOLD = 0.4;
-};
-
-// ---- UTILS ---- //
-class Utils {
-public:
-    static double computeIoU(const cv::Rect& r1, const cv::Rect& r2) {
-        double intersection = (r1 & r2).area();
-        double unionArea = r1.area() + r2.area() - intersection;
-        return (intersection > 0) ? intersection / unionArea : 0.0;
-    }
+// Reads the next frame. Frames the decoder skipped (its position advanced by
+// more than one) are counted as dropped.
+static bool readFrame(cv::VideoCapture& cap, cv::Mat& frame) {
+    static metrics::LatencyHistogram& decodeLatency = metrics::registry().histogram("video_decode");
+    static metrics::Counter& droppedFrames = metrics::registry().counter("frames_dropped");
+    static metrics::Counter& frames = metrics::registry().counter("frames");
 
-    static double computeMedianArea(const std::deque<double>& areas) {
-        std::vector<double> sortedAreas(areas.begin(), areas.end());
-        std::sort(sortedAreas.begin(), sortedAreas.end());
-        size_t n = sortedAreas.size();
-        return (n % 2 == 0) ? (sortedAreas[n / 2 - 1] + sortedAreas[n / 2]) / 2.0 : sortedAreas[n / 2];
-    }
-};
-
-// ---- DAM MEMORY ---- //
-class DAMMemory {
-public:
-    std::deque<cv::Rect> RAM;
-    std::deque<cv::Rect> DRM;
-    std::deque<double> maskAreas;
-
-    void updateRAM(const cv::Rect& box) {
-        if (RAM.size() >= Config::RAM_SIZE) RAM.pop_front();
-        RAM.push_back(box);
-        if (maskAreas.size() >= Config::AREA_HISTORY_SIZE) maskAreas.pop_front();
-        maskAreas.push_back(box.area());
+    double expected = cap.get(cv::CAP_PROP_POS_FRAMES) + 1;
+    {
+        metrics::ScopedTimer timer(decodeLatency);
+        cap >> frame;
     }
+    if (frame.empty()) return false;
 
-    void updateDRM(const cv::Rect& box) {
-        if (DRM.size() >= Config::DRM_SIZE) DRM.pop_front();
-        DRM.push_back(box);
-        std::cout << "Distractor saved to DRM.\n";
-    }
-
-    double getMedianArea() const {
-        return Utils::computeMedianArea(maskAreas);
-    }
-
-    cv::Rect getBestMemory() const {
-        if (!DRM.empty()) return DRM.back();
-        if (!RAM.empty()) return RAM.back();
-        return cv::Rect();
-    }
-};
-
-// ---- TRACKER MANAGER ---- //
-class TrackerManager {
-    cv::Ptr<cv::TrackerCSRT> tracker;
-public:
-    TrackerManager() { tracker = cv::TrackerCSRT::create(); }
+    double position = cap.get(cv::CAP_PROP_POS_FRAMES);
+    if (position > expected) droppedFrames.add(std::uint64_t(position - expected));
+    frames.add();
+    return true;
+}
 
-    void reinit(const cv::Mat& frame, const cv::Rect& box) {
-        tracker.release();
-        tracker = cv::TrackerCSRT::create();
-        tracker->init(frame, box);
+static bool readFrame(YuvVideoReader& reader, YuvFrame& frame) {
+    static metrics::LatencyHistogram& decodeLatency = metrics::registry().histogram("video_decode");
+    static metrics::Counter& frames = metrics::registry().counter("frames");
+    {
+        metrics::ScopedTimer timer(decodeLatency);
+        if (!reader.read(frame)) return false;
     }
+    frames.add();
+    return true;
+}
 
-    bool track(const cv::Mat& frame, cv::Rect& roi) {
-        return tracker->update(frame, roi);
+// Raw sources have nothing to decode: this times the read alone, a copy out
+// of the pipe or, for mapped files, at most a page fault.
+template <typename Frame>
+static bool readFrame(RawVideoSource& source, Frame& frame) {
+    static metrics::LatencyHistogram& readLatency = metrics::registry().histogram("raw_read");
+    static metrics::Counter& frames = metrics::registry().counter("frames");
+    {
+        metrics::ScopedTimer timer(readLatency);
+        if (!source.read(frame)) return false;
     }
-};
+    frames.add();
+    return true;
+}
 
 // ---- MAIN APP ---- //
 class ObjectTrackerApp {
-    ncnn::Net yolov11;
-    DetectorClassInfo classInfo = {1, {0}};
-    DAMMemory dam;
-    TrackerManager tracker;
-    cv::Rect selectedROI;
-    bool trackingInitialized = false;
-    bool isOccluded = false;
-    int frameCount = 0;
+    InferenceService& detector;
+    EncoderSinkOptions outputOptions;
+    bool display;
+    PreviewSinkOptions previewOptions;
+    TilingPolicy tiling;
+    int streamId;
+    StreamTracker stream;
+    std::unique_ptr<PreviewSink> preview;
     double avg_fps = 0.0;
+    StreamMemory memory;
+    RawVideoInfo rawInfo;
 
 public:
-    ObjectTrackerApp(const std::string& paramPath, const std::string& binPath) {
-        yolov11.load_param(paramPath.c_str());
-        yolov11.load_model(binPath.c_str());
-    }
+    ObjectTrackerApp(InferenceService& detector, const EncoderSinkOptions& outputOptions, bool display = true,
+                     const PreviewSinkOptions& previewOptions = PreviewSinkOptions(),
+                     const TilingPolicy& tiling = TilingPolicy())
+        : detector(detector),
+          outputOptions(outputOptions),
+          display(display),
+          previewOptions(previewOptions),
+          tiling(tiling),
+          streamId(detector.registerStream("main")),
+          stream([this](const cv::Mat& frame, std::vector<BoxInfo>& detections) {
+              if (this->tiling.useTiles(stream.getROI(), frame.size()))
+                  this->detector.detectTiled(streamId, frame, this->tiling.layout, detections);
+              else
+                  this->detector.detect(streamId, frame, stream.cascadeHint(), detections);
+          }, [this](const YuvFrame& frame, std::vector<BoxInfo>& detections) {
+              if (this->tiling.useTiles(stream.getROI(), cv::Size(frame.width, frame.height)))
+                  this->detector.detectTiled(streamId, frame, this->tiling.layout, detections);
+              else
+                  this->detector.detect(streamId, frame, stream.cascadeHint(), detections);
+          }) {}
+
+    // Takes effect from the next detection round.
+    void setTilingMode(TilingMode mode) { tiling.mode = mode; }
+    // Call before run(); the tracker starts at this scale.
+    void setTrackerScale(double scale) { stream.setTrackerScale(scale); }
+    // Describes headerless rawvideo input (see openRawVideo()).
+    void setRawVideoInfo(const RawVideoInfo& info) { rawInfo = info; }
+
+    // What the stream held by the end of run().
+    const StreamMemory& getMemory() const { return memory; }
+
+    // With yuvInput the decoder's NV12 planes feed detection and tracking
+    // directly; BGR is then only produced for display and encoding. Raw
+    // input (stdin, .y4m, rawvideo files) is never decoded.
+    void run(const std::string& videoPath, const std::string& outputVideoPath, bool yuvInput = false) {
+        if (std::unique_ptr<RawVideoSource> raw = openRawVideo(videoPath, rawInfo.width > 0 ? &rawInfo : nullptr)) {
+            if (raw->isYuv())
+                runYuv(*raw, outputVideoPath);
+            else
+                runRaw(*raw, outputVideoPath);
+            return;
+        }
+        if (yuvInput) {
+            YuvVideoReader reader;
+            if (reader.open(videoPath)) {
+                runYuv(reader, outputVideoPath);
+                return;
+            }
+            std::cout << "YUV input unavailable, decoding to BGR.\n";
+        }
 
-    void run(const std::string& videoPath, const std::string& outputVideoPath) {
         cv::VideoCapture cap(videoPath);
         if (!cap.isOpened()) return;
 
         int width = (int)cap.get(cv::CAP_PROP_FRAME_WIDTH);
         int height = (int)cap.get(cv::CAP_PROP_FRAME_HEIGHT);
         int fps = (int)cap.get(cv::CAP_PROP_FPS);
-        cv::VideoWriter writer(outputVideoPath, cv::VideoWriter::fourcc('M', 'P', '4', 'V'), fps, cv::Size(width, height));
+        EncoderSink sink(outputVideoPath, fps, cv::Size(width, height), outputOptions);
 
         cv::Mat frame;
+        double busySeconds = 0.0;
         while (true) {
             auto t0 = std::chrono::steady_clock::now();
-            cap >> frame;
-            if (frame.empty()) break;
-            frameCount++;
+            if (!readFrame(cap, frame)) break;
 
-            if (frameCount == 1) initROI(frame);
-            if (trackingInitialized) track(frame);
-            if (frameCount % Config::DETECTION_INTERVAL == 0) detectAndUpdate(frame);
+            if (stream.getFrameCount() == 0) {
+                stream.init(frame, selectTarget(frame));
+                startPreview();
+                t0 = std::chrono::steady_clock::now();
+            }
+            stream.process(frame);
 
-            visualize(frame);
-            writer.write(frame);
+            if (needsRender(sink)) visualize(frame);
+            sink.write(frame, trackRecord());
             auto t1 = std::chrono::steady_clock::now();
-            double frame_time = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
-            avg_fps = (avg_fps * (frameCount - 1) + 1000.0 / frame_time) / frameCount;
-            if (cv::waitKey(1) == 'q') break;
+            busySeconds += std::chrono::duration<double>(t1 - t0).count();
+            if (busySeconds > 0) avg_fps = stream.getFrameCount() / busySeconds;
+            if (preview && preview->quitRequested()) break;
         }
+        recordMemory(frame, sink);
     }
 
 private:
-    void initROI(const cv::Mat& frame) {
+    // For YuvVideoReader and the 4:2:0 raw sources.
+    template <typename Reader>
+    void runYuv(Reader& reader, const std::string& outputVideoPath) {
+        EncoderSink sink(outputVideoPath, reader.getFps(), reader.getSize(), outputOptions);
+
+        static metrics::LatencyHistogram& convertLatency = metrics::registry().histogram("yuv_to_bgr");
+
+        YuvFrame yuv;
+        cv::Mat frame;
+        double busySeconds = 0.0;
+        while (true) {
+            auto t0 = std::chrono::steady_clock::now();
+            if (!readFrame(reader, yuv)) break;
+
+            if (stream.getFrameCount() == 0) {
+                yuv.toBgr(frame);
+                stream.init(yuv, selectTarget(frame));
+                startPreview();
+                t0 = std::chrono::steady_clock::now();
+            }
+            stream.process(yuv);
+
+            if (needsRender(sink)) {
+                {
+                    metrics::ScopedTimer timer(convertLatency);
+                    yuv.toBgr(frame);
+                }
+                visualize(frame);
+            }
+            sink.write(frame, trackRecord());
+            auto t1 = std::chrono::steady_clock::now();
+            busySeconds += std::chrono::duration<double>(t1 - t0).count();
+            if (busySeconds > 0) avg_fps = stream.getFrameCount() / busySeconds;
+            if (preview && preview->quitRequested()) break;
+        }
+        recordMemory(frame, sink);
+        memory.frameBytes += yuv.data.total() * yuv.data.elemSize();
+    }
+
+    // Raw BGR frames are read-only views of the source, so drawing and
+    // encoding work on a copy, made only for the frames that are rendered.
+    void runRaw(RawVideoSource& source, const std::string& outputVideoPath) {
+        EncoderSink sink(outputVideoPath, source.getFps(), source.getSize(), outputOptions);
+
+        cv::Mat frame;
+        cv::Mat canvas;
+        double busySeconds = 0.0;
+        while (true) {
+            auto t0 = std::chrono::steady_clock::now();
+            if (!readFrame(source, frame)) break;
+
+            if (stream.getFrameCount() == 0) {
+                stream.init(frame, selectTarget(frame));
+                startPreview();
+                t0 = std::chrono::steady_clock::now();
+            }
+            stream.process(frame);
+
+            if (needsRender(sink)) {
+                frame.copyTo(canvas);
+                visualize(canvas);
+            }
+            sink.write(canvas, trackRecord());
+            auto t1 = std::chrono::steady_clock::now();
+            busySeconds += std::chrono::duration<double>(t1 - t0).count();
+            if (busySeconds > 0) avg_fps = stream.getFrameCount() / busySeconds;
+            if (preview && preview->quitRequested()) break;
+        }
+        recordMemory(canvas, sink);
+    }
+
+    void recordMemory(const cv::Mat& frame, const EncoderSink& sink) {
+        memory = StreamMemory();
+        memory.name = "main";
+        memory.frameBytes = frame.total() * frame.elemSize();
+        memory.encoderBytes = sink.getStats().maxHeldBytes;
+        stream.reportMemory(memory);
+    }
+
+    TrackRecord trackRecord() const {
+        TrackRecord record;
+        record.frameIndex = stream.getFrameCount();
+        record.box = stream.getROI();
+        record.tracked = stream.isInitialized();
+        return record;
+    }
+
+    // The preview window opens once the ROI selection window is closed.
+    void startPreview() {
+        if (display && !preview) preview = std::make_unique<PreviewSink>(previewOptions);
+    }
+
+    // Frames that are neither encoded nor picked up by the preview are not drawn.
+    bool needsRender(const EncoderSink& sink) const {
+        return sink.needsFrames() || (preview && preview->isDue());
+    }
+
+    cv::Rect selectTarget(const cv::Mat& frame) {
         std::cout << "Draw ROI around target...\n";
         cv::imshow("YOLOv11 Detection", frame);
-        selectedROI = cv::selectROI("YOLOv11 Detection", frame, false, false);
+        cv::Rect roi = cv::selectROI("YOLOv11 Detection", frame, false, false);
         cv::destroyWindow("YOLOv11 Detection");
-        if (selectedROI.area() == 0) exit(0);
-        tracker.reinit(frame, selectedROI);
-        dam.updateRAM(selectedROI);
-        trackingInitialized = true;
+        if (roi.area() == 0) exit(0);
+        return roi;
     }
 
-    void track(const cv::Mat& frame) {
-        if (!tracker.track(frame, selectedROI)) {
-            std::cout << "CSRT lost target, marking as occluded...\n";
-            trackingInitialized = false;
-            isOccluded = true;
+    void visualize(cv::Mat& frame) {
+        static metrics::LatencyHistogram& drawLatency = metrics::registry().histogram("draw");
+        static metrics::LatencyHistogram& displayLatency = metrics::registry().histogram("display");
+        {
+            metrics::ScopedTimer timer(drawLatency);
+            static const TextStyle fpsStyle = {cv::FONT_HERSHEY_SIMPLEX, 0.8, 2, 0};
+            cv::rectangle(frame, stream.getROI(), cv::Scalar(0, 255, 0), 2);
+            char fps_text[32];
+            std::snprintf(fps_text, sizeof(fps_text), "FPS: %d", int(avg_fps));
+            OverlayRenderer::shared().drawText(frame, fps_text, cv::Point(10, 30), fpsStyle, cv::Scalar(0, 0, 255));
         }
+        if (!preview) return;
+        metrics::ScopedTimer timer(displayLatency);
+        preview->show(frame);
     }
+};
 
-    void detectAndUpdate(const cv::Mat& frame) {
-        std::vector<BoxInfo> detections;
-        yolo::detect(classInfo, yolov11, frame, detections);
-        bool targetFound = false;
-
-        for (auto& box : detections) {
-            BBox bbox = box.getBox();
-            cv::Rect detectedBox(bbox.x, bbox.y, bbox.w, bbox.h);
-            double iou = Utils::computeIoU(selectedROI, detectedBox);
-            double medianArea = dam.getMedianArea();
-            double areaDiff = std::abs(detectedBox.area() - medianArea) / medianArea;
-
-            if (iou > Config::OVERLAP_THRESHOLD) {
-                targetFound = true;
-                tracker.reinit(frame, detectedBox);
-                selectedROI = detectedBox;
-                dam.updateRAM(detectedBox);
-                trackingInitialized = true;
-            } else if (iou < Config::IOU_THRESHOLD && areaDiff <= Config::AREA_TOLERANCE) {
-                dam.updateDRM(detectedBox);
-            }
+// ---- MULTI-STREAM SERVER ---- //
+// Every stream keeps its own CSRT tracker and DAM memory; detection requests
+// of all streams go to the shared InferenceService. The per-frame read,
+// track, DAM update and draw steps are posted to the stream's strand on a
+// WorkStealingExecutor, so they run in frame order while idle workers pick
+// up whichever stream is behind. Executor workers never wait for inference:
+// a detection round submits its request and the service posts the DAM
+// update and the rest of the frame back to the strand when it completes.
+class MultiStreamServer {
+    struct Stream {
+        std::string videoPath;
+        int streamId = -1;
+        int strand = -1;
+        std::unique_ptr<StreamTracker> tracker;
+        cv::VideoCapture cap;
+        std::unique_ptr<RawVideoSource> raw;    // used instead of cap when set
+        std::unique_ptr<EncoderSink> sink;
+        cv::Mat frame;
+        cv::Mat canvas;     // drawn and encoded copy of a read-only raw BGR frame
+        std::size_t frames = 0;
+        std::chrono::steady_clock::time_point start;
+        double seconds = 0.0;
+    };
+
+    InferenceService& detector;
+    WorkStealingExecutor& executor;
+    EncoderSinkOptions outputOptions;
+    double trackerScale;
+    RawVideoInfo rawInfo;
+    std::vector<std::unique_ptr<Stream>> streams;
+
+public:
+    MultiStreamServer(InferenceService& detector, WorkStealingExecutor& executor, const EncoderSinkOptions& outputOptions,
+                      double trackerScale = 1.0)
+        : detector(detector), executor(executor), outputOptions(outputOptions), trackerScale(trackerScale) {}
+
+    // Describes headerless rawvideo input (see openRawVideo()).
+    void setRawVideoInfo(const RawVideoInfo& info) { rawInfo = info; }
+
+    // Opens the stream and asks for its target ROI on the first frame. ROI
+    // selection stays on the calling thread since HighGUI is not thread-safe.
+    bool addStream(const std::string& videoPath, const std::string& outputVideoPath) {
+        auto stream = std::make_unique<Stream>();
+        stream->videoPath = videoPath;
+        stream->raw = openRawVideo(videoPath, rawInfo.width > 0 ? &rawInfo : nullptr);
+        if (!stream->raw && !stream->cap.open(videoPath)) {
+            std::cout << "Cannot open " << videoPath << "\n";
+            return false;
         }
+        if (!readStreamFrame(stream.get())) return false;
 
-        if (!targetFound) isOccluded = true;
-        else isOccluded = false;
+        std::string window = "Select target: " + videoPath;
+        cv::Rect roi = cv::selectROI(window, stream->frame, false, false);
+        cv::destroyWindow(window);
+        if (roi.area() == 0) return false;
 
-        if (isOccluded) recover(frame);
+        int streamId = detector.registerStream(videoPath);
+        stream->streamId = streamId;
+        stream->strand = executor.createStrand();
+        Stream* owner = stream.get();
+        stream->tracker = std::make_unique<StreamTracker>([this, streamId, owner](const cv::Mat& frame, std::vector<BoxInfo>& detections) {
+            detector.detect(streamId, frame, owner->tracker->cascadeHint(), detections);
+        });
+        stream->tracker->setTrackerScale(trackerScale);
+        stream->tracker->init(stream->frame, roi);
+
+        int fps = stream->raw ? (int)stream->raw->getFps() : (int)stream->cap.get(cv::CAP_PROP_FPS);
+        stream->sink = std::make_unique<EncoderSink>(outputVideoPath, fps, stream->frame.size(), outputOptions);
+        streams.push_back(std::move(stream));
+        return true;
     }
 
-    void recover(const cv::Mat& frame) {
-        cv::Rect recoveryBox = dam.getBestMemory();
-        if (recoveryBox.area() > 0) {
-            tracker.reinit(frame, recoveryBox);
-            selectedROI = recoveryBox;
-            trackingInitialized = true;
-            isOccluded = false;
-            std::cout << "Recovered using DAM memory.\n";
+    void run() {
+        auto t0 = std::chrono::steady_clock::now();
+        for (auto& stream : streams) {
+            stream->start = t0;
+            postFrame(stream.get());
         }
+        executor.waitIdle();
+        auto t1 = std::chrono::steady_clock::now();
+        report(std::chrono::duration<double>(t1 - t0).count());
     }
 
-    void visualize(cv::Mat& frame) {
-        cv::rectangle(frame, selectedROI, cv::Scalar(0, 255, 0), 2);
-        std::string fps_text = "FPS: " + std::to_string(int(avg_fps));
-        cv::putText(frame, fps_text, cv::Point(10, 30), cv::FONT_HERSHEY_SIMPLEX, 0.8, cv::Scalar(0, 0, 255), 2);
-        cv::imshow("YOLOv11 Detection", frame);
+private:
+    // Tracking here takes BGR, so 4:2:0 raw frames are converted into the
+    // stream's own frame; raw BGR frames stay views of the source.
+    static bool readStreamFrame(Stream* stream) {
+        if (!stream->raw) return readFrame(stream->cap, stream->frame);
+        if (!stream->raw->isYuv()) return readFrame(*stream->raw, stream->frame);
+        YuvFrame yuv;
+        if (!readFrame(*stream->raw, yuv)) return false;
+        yuv.toBgr(stream->frame);
+        return true;
+    }
+
+    // The first frame was already read by addStream(); every later frame is
+    // read by the task that finished the previous one.
+    void postFrame(Stream* stream) {
+        StreamTracker* tracker = stream->tracker.get();
+        executor.post(stream->strand, [stream, tracker] { tracker->trackFrame(stream->frame); });
+        executor.post(stream->strand, [this, stream, tracker] {
+            if (!tracker->isDetectionFrame() || !tracker->startDetectionRound(stream->frame)) {
+                postOutput(stream);
+                return;
+            }
+            // stream->frame is only replaced by postOutput(), after the round.
+            auto resume = executor.defer(stream->strand);
+            detector.submit(stream->streamId, stream->frame, tracker->cascadeHint(),
+                            [this, stream, tracker, resume](std::vector<BoxInfo> detections) {
+                resume([this, stream, tracker, detections = std::move(detections)] {
+                    tracker->finishDetectionRound(stream->frame, detections);
+                    postOutput(stream);
+                });
+            });
+        });
+    }
+
+    // Draws and writes the frame, then reads the next one.
+    void postOutput(Stream* stream) {
+        StreamTracker* tracker = stream->tracker.get();
+        executor.post(stream->strand, [this, stream, tracker] {
+            static metrics::LatencyHistogram& drawLatency = metrics::registry().histogram("draw");
+            const bool readOnly = stream->raw && !stream->raw->isYuv();
+            cv::Mat& output = readOnly ? stream->canvas : stream->frame;
+            if (stream->sink->needsFrames()) {
+                metrics::ScopedTimer timer(drawLatency);
+                if (readOnly) stream->frame.copyTo(stream->canvas);
+                cv::rectangle(output, tracker->getROI(), cv::Scalar(0, 255, 0), 2);
+            }
+            TrackRecord record;
+            record.frameIndex = tracker->getFrameCount();
+            record.box = tracker->getROI();
+            record.tracked = tracker->isInitialized();
+            stream->sink->write(output, record);
+            stream->frames++;
+
+            if (readStreamFrame(stream)) {
+                postFrame(stream);
+                return;
+            }
+            stream->sink->close();
+            auto t1 = std::chrono::steady_clock::now();
+            stream->seconds = std::chrono::duration<double>(t1 - stream->start).count();
+        });
+    }
+
+    void report(double wallSeconds) const {
+        std::size_t totalFrames = 0;
+        std::cout << "---- throughput ----\n";
+        for (const auto& stream : streams) {
+            std::cout << stream->videoPath << ": " << stream->frames << " frames, "
+                      << (stream->seconds > 0 ? stream->frames / stream->seconds : 0.0) << " fps\n";
+            EncoderSinkStats sinkStats = stream->sink->getStats();
+            std::cout << "  [sink] written=" << sinkStats.frames << " dropped=" << sinkStats.dropped
+                      << " maxQueued=" << sinkStats.maxQueued << " encodeMs=" << sinkStats.encodeMs
+                      << " blockedMs=" << sinkStats.blockedMs;
+            if (sinkStats.annotationsDropped > 0)
+                std::cout << " annotationsDropped=" << sinkStats.annotationsDropped;
+            std::cout << "\n";
+            totalFrames += stream->frames;
+        }
+        std::cout << "aggregate: " << totalFrames << " frames over " << streams.size() << " streams, "
+                  << (wallSeconds > 0 ? totalFrames / wallSeconds : 0.0) << " fps\n";
+
+        ExecutorStats stats = executor.getStats();
+        std::cout << "[executor] tasks=" << stats.tasks << " steals=" << stats.steals
+                  << " utilization=" << stats.utilization << "\n";
+        for (std::size_t i = 0; i < stats.workers.size(); i++) {
+            const ExecutorWorkerStats& worker = stats.workers[i];
+            std::cout << "  worker " << i << ": tasks=" << worker.tasks << " steals=" << worker.steals
+                      << " busyMs=" << worker.busyMs << " utilization=" << worker.utilization << "\n";
+        }
+        detector.printReport(std::cout);
+
+        MemoryReport memory;
+        memory.addShared(detector);
+        for (const auto& stream : streams) {
+            StreamMemory usage;
+            usage.name = stream->videoPath;
+            usage.frameBytes = stream->frame.total() * stream->frame.elemSize();
+            usage.encoderBytes = stream->sink->getStats().maxHeldBytes;
+            stream->tracker->reportMemory(usage);
+            memory.streams.push_back(usage);
+        }
+        memory.print(std::cout);
     }
 };
 
+// OHTRACK_OUTPUT=annotations writes only the per-frame track results next to
+// the output path, as a track log unless OHTRACK_ANNOTATIONS picks ndjson or
+// csv; OHTRACK_CODEC (fourcc) and OHTRACK_QUALITY (0..100) tune the video
+// encoder.
+static EncoderSinkOptions outputOptionsFromEnv() {
+    EncoderSinkOptions options;
+    if (const char* mode = std::getenv("OHTRACK_OUTPUT")) options.mode = EncoderSink::parseMode(mode);
+    if (const char* format = std::getenv("OHTRACK_ANNOTATIONS")) options.annotationFormat = format;
+    if (const char* codec = std::getenv("OHTRACK_CODEC")) options.fourcc = codec;
+    if (const char* quality = std::getenv("OHTRACK_QUALITY")) options.quality = std::atof(quality);
+    return options;
+}
+
+// OHTRACK_PREVIEW_FPS caps the preview refresh rate and OHTRACK_PREVIEW_SIZE
+// (<width>x<height>) the window size.
+static PreviewSinkOptions previewOptionsFromEnv() {
+    PreviewSinkOptions options;
+    if (const char* fps = std::getenv("OHTRACK_PREVIEW_FPS")) options.refreshHz = std::atof(fps);
+    if (const char* size = std::getenv("OHTRACK_PREVIEW_SIZE")) {
+        int width = 0, height = 0;
+        if (std::sscanf(size, "%dx%d", &width, &height) == 2) options.maxSize = cv::Size(width, height);
+    }
+    return options;
+}
+
+// OHTRACK_TILING=always|adaptive turns on sliced inference (adaptive tiles
+// only while the target is small); OHTRACK_TILE=<size>[,<overlap>[,<scale>]]
+// sets the tile layout, e.g. 640,0.2,1 for native-resolution 640 px tiles.
+static TilingPolicy tilingPolicyFromEnv() {
+    TilingPolicy policy;
+    if (const char* mode = std::getenv("OHTRACK_TILING")) policy.mode = TilingPolicy::parseMode(mode);
+    if (const char* layout = std::getenv("OHTRACK_TILE")) {
+        TileLayout& tile = policy.layout;
+        std::sscanf(layout, "%d,%f,%f", &tile.tileSize, &tile.overlap, &tile.scale);
+    }
+    return policy;
+}
+
+// OHTRACK_CORES caps the cores the process budgets for (default: all it may
+// run on) and OHTRACK_PIN=1 pins inference and tracking workers to their
+// share of them.
+static ThreadBudgetOptions threadBudgetOptionsFromEnv(int streams) {
+    ThreadBudgetOptions options;
+    options.streams = streams;
+    if (const char* cores = std::getenv("OHTRACK_CORES")) options.cores = std::atoi(cores);
+    if (const char* pin = std::getenv("OHTRACK_PIN")) options.pinThreads = std::string(pin) == "1";
+    return options;
+}
+
+// OHTRACK_LOW_MEMORY=1 selects the low-memory profile (see MemoryProfile);
+// OHTRACK_TRACKER_SCALE overrides the frame scale CSRT runs at.
+static MemoryProfile memoryProfileFromEnv() {
+    const char* low = std::getenv("OHTRACK_LOW_MEMORY");
+    MemoryProfile profile = low && std::string(low) == "1" ? MemoryProfile::low() : MemoryProfile();
+    if (const char* scale = std::getenv("OHTRACK_TRACKER_SCALE")) profile.trackerScale = std::atof(scale);
+    return profile;
+}
+
+// OHTRACK_RAW_FORMAT=<width>x<height>[:<pix_fmt>[:<fps>]] describes headerless
+// rawvideo input, e.g. 1920x1080:nv12:30 (pix_fmt bgr24, nv12 or yuv420p).
+static RawVideoInfo rawVideoInfoFromEnv() {
+    RawVideoInfo info;
+    if (const char* spec = std::getenv("OHTRACK_RAW_FORMAT")) {
+        if (!RawVideoInfo::parse(spec, info)) std::cout << "Ignoring OHTRACK_RAW_FORMAT=" << spec << "\n";
+    }
+    return info;
+}
+
 // ---- MAIN ---- //
-int main()
+// Usage: det_demo [<video> <output>]...
+// Without arguments the default single video is tracked interactively; with
+// more than one video/output pair all of them run through MultiStreamServer.
+// A video of "-" reads stdin: y4m (ffmpeg -f yuv4mpegpipe), or rawvideo
+// (ffmpeg -f rawvideo) described by OHTRACK_RAW_FORMAT, which also maps
+// .yuv/.raw files; .y4m files are mapped. None of these are decoded.
+// OHTRACK_YUV=1 reads the single video as NV12 (see YuvVideoReader);
+// OHTRACK_DISPLAY=0 runs the single video without the live preview window;
+// OHTRACK_TILING / OHTRACK_TILE enable tiled detection for it.
+// OHTRACK_LIGHT_MODEL=<dir> (model.ncnn.param/.bin inside, e.g. a yolo11n
+// export) runs that model first and the main model only on escalation.
+// OHTRACK_CORES / OHTRACK_PIN size and pin the thread budget.
+// OHTRACK_LOW_MEMORY=1 trades some speed for a smaller footprint per stream.
+// OHTRACK_WARMUP=<runs> sets the warm-up inferences per worker (0 skips
+// them), OHTRACK_WARMUP_ASYNC=1 warms up while the video opens and
+// OHTRACK_MAP_WEIGHTS=1 uses the weight files in place from a memory map.
+// OHTRACK_HOST_DECODE=1 copies the whole output tensor out of the net and
+// decodes it on the host instead of in the YoloDecode layer.
+// OHTRACK_METRICS=<file> sets where the metrics snapshots go (default
+// output_video/metrics.json); a .prom file gets the Prometheus text format.
+int main(int argc, char** argv)
 {
     std::string base = "/Users/3i-a1-2022-062/workspace/yolo11_track";
-    ObjectTrackerApp app(base + "/best_ncnn_model/model.ncnn.param", base + "/best_ncnn_model/model.ncnn.bin");
+    DetectorClassInfo classInfo = {1, {0}};
+
+    const bool multiStream = argc > 3;
+
+    // In multi-stream mode inference and the tracking executor split the cores.
+    const ThreadBudget budget = ThreadBudget::plan(threadBudgetOptionsFromEnv(multiStream ? (argc - 1) / 2 : 1));
+    budget.apply();
+    budget.print(std::cout);
+
+    InferenceServiceOptions options;
+    options.numThreads = budget.inferenceThreads;
+    options.numWorkers = budget.inferenceWorkers;
+    options.cpuAffinity = budget.affinity(budget.inferenceCores);
+    if (const char* warmup = std::getenv("OHTRACK_WARMUP")) options.warmupRuns = std::max(0, std::atoi(warmup));
+    options.warmupInBackground = std::getenv("OHTRACK_WARMUP_ASYNC") != nullptr;
+    options.mapWeights = std::getenv("OHTRACK_MAP_WEIGHTS") != nullptr;
+    options.fusedDecode = std::getenv("OHTRACK_HOST_DECODE") == nullptr;
+    EncoderSinkOptions outputOptions = outputOptionsFromEnv();
+    const MemoryProfile memoryProfile = memoryProfileFromEnv();
+    memoryProfile.apply(options, outputOptions);
+    if (const char* light = std::getenv("OHTRACK_LIGHT_MODEL")) {
+        options.lightParamPath = std::string(light) + "/model.ncnn.param";
+        options.lightBinPath = std::string(light) + "/model.ncnn.bin";
+    }
+    std::unique_ptr<InferenceService> service;
+    try {
+        service = std::make_unique<InferenceService>(base + "/best_ncnn_model/model.ncnn.param",
+                                                     base + "/best_ncnn_model/model.ncnn.bin", classInfo, options);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    InferenceService& detector = *service;
+
+    // Stage latencies and counters go next to the output video unless
+    // OHTRACK_METRICS names the file.
+    const char* metricsEnv = std::getenv("OHTRACK_METRICS");
+    std::string metricsPath = metricsEnv ? metricsEnv : base + "/output_video/metrics.json";
+    metrics::MetricsReporter reporter(metrics::registry(), metricsPath, metrics::MetricsReporter::formatForPath(metricsPath));
+    ContentionMonitor contention(budget);
+    const RawVideoInfo rawInfo = rawVideoInfoFromEnv();
+
+    if (multiStream) {
+        WorkStealingExecutor executor(budget.trackingWorkers, 4, budget.affinity(budget.trackingCores),
+                                      budget.trackingOpenmpThreads);
+        MultiStreamServer server(detector, executor, outputOptions, memoryProfile.trackerScale);
+        server.setRawVideoInfo(rawInfo);
+        for (int i = 1; i + 1 < argc; i += 2)
+            server.addStream(argv[i], argv[i + 1]);
+        server.run();
+        contention.printReport(std::cout);
+        return 0;
+    }
 
     std::string video = "/Users/3i-a1-2022-062/workspace/videos/occlusion-cases/2.mp4";
     std::string output = "/Users/3i-a1-2022-062/workspace/yolo11_track/output_video/output_detection.mp4";
+    if (argc == 3) {
+        video = argv[1];
+        output = argv[2];
+    }
+
+    const char* displayEnv = std::getenv("OHTRACK_DISPLAY");
+    ObjectTrackerApp app(detector, outputOptions, !(displayEnv && std::string(displayEnv) == "0"), previewOptionsFromEnv(),
+                         tilingPolicyFromEnv());
+    app.setTrackerScale(memoryProfile.trackerScale);
+    app.setRawVideoInfo(rawInfo);
+    app.run(video, output, std::getenv("OHTRACK_YUV") != nullptr);
+    detector.printReport(std::cout);
 
-    app.run(video, output);
+    MemoryReport memory;
+    memory.addShared(detector);
+    memory.streams.push_back(app.getMemory());
+    memory.print(std::cout);
+    contention.printReport(std::cout);
     return 0;
 }
 
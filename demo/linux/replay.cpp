@@ -0,0 +1,293 @@
+//
+//  replay.cpp
+//  Inference
+//
+//  Deterministic replay of the tracker over local videos with ground truth.
+//
+//  Usage: replay [--model <param> <bin>] [--threads N] [--seed S] [--yuv]
+//                <video> <gt_dir> [<video> <gt_dir>]...
+//
+//  <gt_dir> holds one BoundingBoxSaver JSON file per annotated frame, named
+//  by its 1-based frame index (e.g. 1.json, 2.json, ...). A box with zero
+//  area marks a frame where the target is not visible. The tracker is
+//  initialised from the first annotated frame.
+//
+//  --yuv decodes to NV12 (YuvVideoReader) instead of BGR, so the two input
+//  paths can be compared on the same videos.
+//
+//  Videos run one after another with one inference worker, a fixed thread
+//  count and fixed RNG seeds, so two runs of the same build produce the same
+//  tracks and the quality columns can be compared across builds.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <opencv2/opencv.hpp>
+
+#include "bounding_box_saver.h"
+#include "inference_service.h"
+#include "metrics.h"
+#include "stream_tracker.h"
+#include "yuv_frame.h"
+
+using namespace yolo;
+
+namespace {
+
+const char* stageNames[] = {"video_decode", "preprocess", "inference", "postprocess", "track", "dam", "yuv_to_bgr"};
+const int numStages = sizeof(stageNames) / sizeof(stageNames[0]);
+
+struct ReplayResult {
+    std::string name;
+    std::size_t frames = 0;
+    std::size_t scoredFrames = 0;
+    std::vector<double> ious;            // per scored frame
+    std::vector<double> centerErrors;    // per scored frame, pixels
+    std::size_t lostFrames = 0;
+    std::vector<int> recoveryFrames;     // frames from each loss until the target is overlapped again
+    double seconds = 0.0;
+    double stageMs[numStages] = {};
+};
+
+std::map<int, cv::Rect> loadGroundTruth(const std::string& dir) {
+    std::map<int, cv::Rect> groundTruth;
+    for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+        if (entry.path().extension() != ".json") continue;
+        const std::string stem = entry.path().stem().string();
+        if (stem.empty() || !std::all_of(stem.begin(), stem.end(), ::isdigit)) continue;
+        groundTruth[std::stoi(stem)] = BoundingBoxSaver::loadBoundingBox(entry.path().string());
+    }
+    return groundTruth;
+}
+
+double centerError(const cv::Rect& a, const cv::Rect& b) {
+    double dx = (a.x + a.width / 2.0) - (b.x + b.width / 2.0);
+    double dy = (a.y + a.height / 2.0) - (b.y + b.height / 2.0);
+    return std::sqrt(dx * dx + dy * dy);
+}
+
+// Area under the OTB success curve: mean success rate over IoU thresholds 0, 0.05, ..., 1.
+double successAUC(const std::vector<double>& ious) {
+    if (ious.empty()) return 0.0;
+    double sum = 0.0;
+    for (int t = 0; t <= 20; t++) {
+        double threshold = t * 0.05;
+        sum += std::count_if(ious.begin(), ious.end(), [threshold](double iou) { return iou > threshold; }) / double(ious.size());
+    }
+    return sum / 21.0;
+}
+
+// Area under the precision curve: mean precision over center-error thresholds 0..50 px.
+double precisionAUC(const std::vector<double>& errors) {
+    if (errors.empty()) return 0.0;
+    double sum = 0.0;
+    for (int t = 0; t <= 50; t++)
+        sum += std::count_if(errors.begin(), errors.end(), [t](double e) { return e <= t; }) / double(errors.size());
+    return sum / 51.0;
+}
+
+double precisionAt(const std::vector<double>& errors, double threshold) {
+    if (errors.empty()) return 0.0;
+    return std::count_if(errors.begin(), errors.end(), [threshold](double e) { return e <= threshold; }) / double(errors.size());
+}
+
+bool replay(InferenceService& detector, const std::string& videoPath, const std::string& gtDir, bool yuvInput,
+            ReplayResult& result) {
+    result.name = std::filesystem::path(videoPath).filename().string();
+
+    std::map<int, cv::Rect> groundTruth = loadGroundTruth(gtDir);
+    if (groundTruth.empty()) {
+        std::cerr << "No ground truth in " << gtDir << "\n";
+        return false;
+    }
+
+    cv::VideoCapture cap;
+    YuvVideoReader reader;
+    if (yuvInput ? !reader.open(videoPath) : !cap.open(videoPath)) {
+        std::cerr << "Cannot open " << videoPath << "\n";
+        return false;
+    }
+
+    metrics::registry().reset();
+    int streamId = detector.registerStream(result.name);
+    StreamTracker stream([&detector, streamId](const cv::Mat& frame, std::vector<BoxInfo>& detections) {
+        detector.detect(streamId, frame, detections);
+    }, [&detector, streamId](const YuvFrame& frame, std::vector<BoxInfo>& detections) {
+        detector.detect(streamId, frame, detections);
+    });
+
+    const int initFrame = groundTruth.begin()->first;
+    bool lost = false;
+    int lostSince = 0;
+    cv::Mat frame;
+    YuvFrame yuv;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int frameIndex = 1; ; frameIndex++) {
+        bool ok;
+        {
+            static metrics::LatencyHistogram& decodeLatency = metrics::registry().histogram("video_decode");
+            metrics::ScopedTimer timer(decodeLatency);
+            ok = yuvInput ? reader.read(yuv) : cap.read(frame) && !frame.empty();
+        }
+        if (!ok) break;
+        result.frames++;
+
+        if (frameIndex < initFrame) continue;
+        if (yuvInput) {
+            if (frameIndex == initFrame) stream.init(yuv, groundTruth[initFrame]);
+            stream.process(yuv);
+        } else {
+            if (frameIndex == initFrame) stream.init(frame, groundTruth[initFrame]);
+            stream.process(frame);
+        }
+
+        auto gt = groundTruth.find(frameIndex);
+        if (gt == groundTruth.end() || gt->second.area() == 0 || frameIndex == initFrame) continue;
+
+        const cv::Rect& predicted = stream.getROI();
+        double iou = Utils::computeIoU(predicted, gt->second);
+        result.scoredFrames++;
+        result.ious.push_back(iou);
+        result.centerErrors.push_back(centerError(predicted, gt->second));
+
+        if (iou <= 0.0) {
+            result.lostFrames++;
+            if (!lost) {
+                lost = true;
+                lostSince = frameIndex;
+            }
+        } else if (lost) {
+            lost = false;
+            result.recoveryFrames.push_back(frameIndex - lostSince);
+        }
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    for (int i = 0; i < numStages; i++) {
+        metrics::LatencyHistogram::Snapshot snap = metrics::registry().histogram(stageNames[i]).snapshot();
+        result.stageMs[i] = result.frames ? snap.sumNs / 1e6 / result.frames : 0.0;
+    }
+    return true;
+}
+
+void printTable(const std::vector<ReplayResult>& results) {
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << std::left << std::setw(28) << "video" << std::right
+              << std::setw(7) << "frames" << std::setw(9) << "succAUC" << std::setw(9) << "precAUC"
+              << std::setw(9) << "prec@20" << std::setw(7) << "lost" << std::setw(9) << "recov"
+              << std::setw(9) << "fps";
+    for (int i = 0; i < numStages; i++)
+        std::cout << std::setw(13) << (std::string(stageNames[i]) + "ms");
+    std::cout << "\n";
+
+    ReplayResult total;
+    total.name = "ALL";
+    for (const auto& r : results) {
+        total.frames += r.frames;
+        total.scoredFrames += r.scoredFrames;
+        total.ious.insert(total.ious.end(), r.ious.begin(), r.ious.end());
+        total.centerErrors.insert(total.centerErrors.end(), r.centerErrors.begin(), r.centerErrors.end());
+        total.lostFrames += r.lostFrames;
+        total.recoveryFrames.insert(total.recoveryFrames.end(), r.recoveryFrames.begin(), r.recoveryFrames.end());
+        total.seconds += r.seconds;
+        for (int i = 0; i < numStages; i++)
+            total.stageMs[i] += r.stageMs[i] * r.frames;
+    }
+    for (int i = 0; i < numStages; i++)
+        total.stageMs[i] = total.frames ? total.stageMs[i] / total.frames : 0.0;
+
+    auto printRow = [](const ReplayResult& r) {
+        double recovery = r.recoveryFrames.empty() ? 0.0
+            : std::accumulate(r.recoveryFrames.begin(), r.recoveryFrames.end(), 0.0) / r.recoveryFrames.size();
+        std::cout << std::left << std::setw(28) << r.name.substr(0, 27) << std::right
+                  << std::setw(7) << r.frames
+                  << std::setw(9) << successAUC(r.ious)
+                  << std::setw(9) << precisionAUC(r.centerErrors)
+                  << std::setw(9) << precisionAt(r.centerErrors, 20.0)
+                  << std::setw(7) << r.lostFrames
+                  << std::setw(9) << recovery
+                  << std::setw(9) << (r.seconds > 0 ? r.frames / r.seconds : 0.0);
+        for (int i = 0; i < numStages; i++)
+            std::cout << std::setw(13) << r.stageMs[i];
+        std::cout << "\n";
+    };
+    for (const auto& r : results)
+        printRow(r);
+    if (results.size() > 1)
+        printRow(total);
+    std::cout << "recov = mean frames from losing the target (IoU 0) until it is overlapped again; "
+              << "stage columns are mean ms per frame\n";
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    std::string base = "/Users/3i-a1-2022-062/workspace/yolo11_track";
+    std::string paramPath = base + "/best_ncnn_model/model.ncnn.param";
+    std::string binPath = base + "/best_ncnn_model/model.ncnn.bin";
+    int threads = 4;
+    int seed = 0;
+    bool yuvInput = false;
+    std::vector<std::pair<std::string, std::string>> inputs;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--model" && i + 2 < argc) {
+            paramPath = argv[++i];
+            binPath = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = std::atoi(argv[++i]);
+        } else if (arg == "--yuv") {
+            yuvInput = true;
+        } else if (i + 1 < argc) {
+            inputs.emplace_back(arg, argv[++i]);
+        } else {
+            std::cerr << "Usage: replay [--model <param> <bin>] [--threads N] [--seed S] [--yuv] <video> <gt_dir>...\n";
+            return 1;
+        }
+    }
+    if (inputs.empty()) {
+        std::cerr << "Usage: replay [--model <param> <bin>] [--threads N] [--seed S] [--yuv] <video> <gt_dir>...\n";
+        return 1;
+    }
+
+    cv::setNumThreads(threads);
+    cv::setRNGSeed(seed);
+    std::srand(seed);
+
+    DetectorClassInfo classInfo = {1, {0}};
+    InferenceServiceOptions options;
+    options.numThreads = threads;
+    options.numWorkers = 1;
+    std::unique_ptr<InferenceService> service;
+    try {
+        service = std::make_unique<InferenceService>(paramPath, binPath, classInfo, options);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    InferenceService& detector = *service;
+
+    std::vector<ReplayResult> results;
+    for (const auto& input : inputs) {
+        ReplayResult result;
+        if (replay(detector, input.first, input.second, yuvInput, result))
+            results.push_back(result);
+    }
+
+    std::cout << "---- replay (threads=" << threads << ", seed=" << seed
+              << ", input=" << (yuvInput ? "nv12" : "bgr") << ") ----\n";
+    printTable(results);
+    return 0;
+}
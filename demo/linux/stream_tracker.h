@@ -0,0 +1,301 @@
+//
+//  stream_tracker.h
+//  Inference
+//
+//  Per-stream tracking state: CSRT tracker, DAM memory and the periodic
+//  detection/recovery loop. Detection itself is injected so that several
+//  streams can share one detector.
+//
+//  Each detection round picks a single detection to continue the track
+//  (TargetAssociator, or TargetReacquirer when none overlaps it), so the
+//  tracker is re-anchored at most once per round.
+//
+//  A FrameGate looks at every frame: detection rounds on an unchanged
+//  picture are skipped (the previous results stay in effect), and a hard
+//  scene cut triggers detection right away and re-anchors the tracker.
+//
+//  YuvFrame input skips the full-frame BGR conversion: the detector takes
+//  the planes directly, the gate reads the Y plane, and CSRT runs on a BGR
+//  canvas in which only the window around the target is converted.
+//
+
+#ifndef stream_tracker_h
+#define stream_tracker_h
+
+#include <functional>
+#include <vector>
+#include "box_set.h"
+#include "detector_cascade.h"
+#include "frame_gate.h"
+#include "memory_profile.h"
+#include "tracker_core.h"
+#include "yuv_frame.h"
+
+class StreamTracker {
+public:
+    using Detector = std::function<void(const cv::Mat&, std::vector<BoxInfo>&)>;
+    using YuvDetector = std::function<void(const YuvFrame&, std::vector<BoxInfo>&)>;
+
+private:
+    Detector detector;
+    YuvDetector yuvDetector;
+    const YuvFrame* yuv = nullptr;  // set while a YuvFrame is processed
+    cv::Mat canvas;                 // BGR, only valid around the target
+    DAMMemory dam;
+    TrackerManager tracker;
+    FrameGate gate;
+    std::vector<BoxInfo> detections;    // detector output, reused every round
+    BoxSet lastDetections;
+    SpatialGrid detectionGrid;      // over lastDetections in crowded rounds
+    TargetAssociator::AppearanceScore appearance;
+    TargetReacquirer reacquirer;
+    int roundReinits = 0;           // tracker re-anchors in the current detection round
+    cv::Rect selectedROI;
+    bool trackingInitialized = false;
+    bool isOccluded = false;
+    int frameCount = 0;
+
+public:
+    explicit StreamTracker(Detector detector, YuvDetector yuvDetector = nullptr)
+        : detector(std::move(detector)), yuvDetector(std::move(yuvDetector)) {}
+
+    void init(const cv::Mat& frame, const cv::Rect& roi) {
+        selectedROI = roi;
+        reinitTracker(frame, selectedROI);
+        dam.updateRAM(selectedROI);
+        trackingInitialized = true;
+    }
+
+    // Runs one frame through tracking and, every DETECTION_INTERVAL frames,
+    // through detection + DAM update.
+    void process(const cv::Mat& frame) {
+        trackFrame(frame);
+        if (isDetectionFrame()) detectAndUpdate(frame);
+    }
+
+    // YUV counterparts of init() and process(); needs a YuvDetector.
+    void init(const YuvFrame& frame, const cv::Rect& roi) {
+        yuv = &frame;
+        init(canvas, roi);
+        yuv = nullptr;
+    }
+
+    void process(const YuvFrame& frame) {
+        yuv = &frame;
+        trackFrame(canvas);
+        if (isDetectionFrame()) detectAndUpdate(canvas);
+        yuv = nullptr;
+    }
+
+    // The two halves of process(), for callers that schedule them separately.
+    void trackFrame(const cv::Mat& frame) {
+        static metrics::LatencyHistogram& trackLatency = metrics::registry().histogram("track");
+        static metrics::LatencyHistogram& gateLatency = metrics::registry().histogram("frame_gate");
+        frameCount++;
+        if (Config::FRAME_GATING) {
+            metrics::ScopedTimer timer(gateLatency);
+            gate.update(yuv ? yuv->luma() : frame);
+        }
+        // Across a cut the old ROI means nothing; detectAndUpdate re-anchors.
+        if (trackingInitialized && !gate.isSceneCut()) {
+            metrics::ScopedTimer timer(trackLatency);
+            track(frame);
+        }
+    }
+
+    bool isDetectionFrame() const {
+        return frameCount % Config::DETECTION_INTERVAL == 0 || gate.isSceneCut();
+    }
+
+    // One detection round, with the injected detector.
+    void detectAndUpdate(const cv::Mat& frame) {
+        if (!startDetectionRound(frame)) return;
+        detections.clear();
+        if (yuv) yuvDetector(*yuv, detections);
+        else detector(frame, detections);
+        finishDetectionRound(frame, detections);
+    }
+
+    // detectAndUpdate() in two halves, for callers whose detector finishes
+    // later (MultiStreamServer). False when the round needs no detections:
+    // the frame gate skipped it and it is already complete. Otherwise the
+    // caller detects on `frame` and passes the results, with the same frame
+    // and nothing processed in between, to finishDetectionRound().
+    bool startDetectionRound(const cv::Mat& frame) {
+        static metrics::Counter& skippedDetections = metrics::registry().counter("detections_skipped_static");
+        roundReinits = 0;
+        if (Config::FRAME_GATING && gate.shouldSkipDetection()) {
+            skippedDetections.add();
+            // Nothing moved since the last round: its results still hold, and
+            // only a lost tracker needs them again.
+            if (!trackingInitialized) updateFromDetections(frame, lastDetections);
+            endDetectionRound();
+            return false;
+        }
+        return true;
+    }
+
+    void finishDetectionRound(const cv::Mat& frame, const std::vector<BoxInfo>& results) {
+        static metrics::Counter& sceneCuts = metrics::registry().counter("scene_cuts");
+        gate.markDetection();
+        lastDetections.assign(results);
+
+        if (gate.isSceneCut()) {
+            sceneCuts.add();
+            resetOnSceneCut(frame, lastDetections);
+        } else {
+            updateFromDetections(frame, lastDetections);
+        }
+        endDetectionRound();
+    }
+
+    const cv::Rect& getROI() const { return selectedROI; }
+    int getFrameCount() const { return frameCount; }
+    bool isInitialized() const { return trackingInitialized; }
+    bool isTargetOccluded() const { return isOccluded; }
+
+    // Target state for the detector cascade: re-detection while the target
+    // is lost always gets the full model.
+    yolo::CascadeHint cascadeHint() const {
+        yolo::CascadeHint hint;
+        hint.track = selectedROI;
+        hint.recovering = isOccluded || !trackingInitialized;
+        return hint;
+    }
+    const FrameGate& getFrameGate() const { return gate; }
+    int getRoundReinits() const { return roundReinits; }
+
+    // Optional appearance term for target association (0..1 similarity).
+    void setAppearanceScore(TargetAssociator::AppearanceScore score) { appearance = std::move(score); }
+
+    // Frame scale CSRT runs at (see TrackerManager), from the next re-anchor.
+    void setTrackerScale(double scale) { tracker.setScale(scale); }
+
+    // Adds the canvas and tracker to `memory`; the caller owns the frames.
+    void reportMemory(StreamMemory& memory) const {
+        memory.frameBytes += canvas.total() * canvas.elemSize();
+        memory.trackerBytes += tracker.memoryBytes();
+    }
+
+private:
+    // At most one tracker re-anchor is expected per round; rounds with more
+    // are counted separately.
+    void endDetectionRound() {
+        static metrics::Counter& rounds = metrics::registry().counter("detection_rounds");
+        static metrics::Counter& roundReinitCount = metrics::registry().counter("detection_round_reinits");
+        static metrics::Counter& multiReinitRounds = metrics::registry().counter("detection_rounds_multi_reinit");
+        rounds.add();
+        roundReinitCount.add(std::uint64_t(roundReinits));
+        if (roundReinits > 1) multiReinitRounds.add();
+    }
+
+    void updateFromDetections(const cv::Mat& frame, const BoxSet& detections) {
+        static metrics::LatencyHistogram& damLatency = metrics::registry().histogram("dam");
+        static metrics::Counter& ambiguousRounds = metrics::registry().counter("association_ambiguous");
+        static metrics::Counter& reacquisitions = metrics::registry().counter("reacquisitions");
+        metrics::ScopedTimer timer(damLatency);
+
+        const SpatialGrid* grid = nullptr;
+        if ((int)detections.size() >= Config::GRID_MIN_DETECTIONS) {
+            detectionGrid.build(detections);
+            grid = &detectionGrid;
+        }
+        Association match = TargetAssociator::associate(selectedROI, detections, dam.getMedianArea(), appearance, grid);
+        if (match.candidates > 1) ambiguousRounds.add();
+        if (match.target < 0) {
+            cv::Size frameSize = yuv ? cv::Size(yuv->width, yuv->height) : frame.size();
+            match.target = reacquirer.select(selectedROI, detections, dam.getMedianArea(), frameSize);
+            if (match.target >= 0) reacquisitions.add();
+        }
+        // The reacquired detection was clear of the track, so it can be in
+        // match.distractors; it is the target now and stays out of the DRM.
+        for (int i : match.distractors)
+            if (i != match.target) dam.updateDRM(detections.rect(i));
+
+        isOccluded = match.target < 0;
+        if (isOccluded) {
+            recover(frame);
+            return;
+        }
+        cv::Rect detectedBox = detections.rect(match.target);
+        reinitTracker(frame, detectedBox);
+        selectedROI = detectedBox;
+        dam.updateRAM(detectedBox);
+        trackingInitialized = true;
+    }
+
+    // After a cut positions are meaningless, so distractors are dropped and
+    // the target is re-anchored on the detection whose size best matches the
+    // remembered target area.
+    void resetOnSceneCut(const cv::Mat& frame, const BoxSet& detections) {
+        dam.DRM.clear();
+        double medianArea = dam.getMedianArea();
+        cv::Rect best;
+        double bestScore = 0.0;
+        for (std::size_t i = 0; i < detections.size(); i++) {
+            cv::Rect detectedBox = detections.rect(i);
+            double areaDiff = std::abs(detectedBox.area() - medianArea) / medianArea;
+            double score = detections.score[i] / (1.0 + areaDiff);
+            if (areaDiff <= Config::AREA_TOLERANCE && score > bestScore) {
+                bestScore = score;
+                best = detectedBox;
+            }
+        }
+
+        if (best.area() > 0) {
+            reinitTracker(frame, best);
+            selectedROI = best;
+            dam.updateRAM(best);
+            trackingInitialized = true;
+            isOccluded = false;
+            std::cout << "Scene cut, tracker re-anchored.\n";
+        } else {
+            trackingInitialized = false;
+            isOccluded = true;
+            std::cout << "Scene cut, target not found.\n";
+        }
+    }
+
+    // CSRT samples a square window of about size + 3 * sqrt(area) around the
+    // target, up to ~1.4x larger during its scale search. In YUV mode just
+    // that window is converted into the canvas.
+    void prepareRegion(const cv::Rect& box) {
+        if (!yuv) return;
+        static metrics::LatencyHistogram& convertLatency = metrics::registry().histogram("yuv_to_bgr");
+        metrics::ScopedTimer timer(convertLatency);
+        double side = 1.5 * (std::max(box.width, box.height) + 3.0 * std::sqrt(double(box.area())));
+        double cx = box.x + box.width / 2.0;
+        double cy = box.y + box.height / 2.0;
+        yuv->toBgr(cv::Rect(int(cx - side / 2), int(cy - side / 2), int(side), int(side)), canvas);
+    }
+
+    void reinitTracker(const cv::Mat& frame, const cv::Rect& box) {
+        roundReinits++;
+        prepareRegion(box);
+        tracker.reinit(frame, box);
+    }
+
+    void track(const cv::Mat& frame) {
+        prepareRegion(selectedROI);
+        if (!tracker.track(frame, selectedROI)) {
+            std::cout << "CSRT lost target, marking as occluded...\n";
+            trackingInitialized = false;
+            isOccluded = true;
+        }
+    }
+
+    void recover(const cv::Mat& frame) {
+        static metrics::Counter& recoveries = metrics::registry().counter("recoveries");
+        cv::Rect recoveryBox = dam.getBestMemory();
+        if (recoveryBox.area() > 0) {
+            recoveries.add();
+            reinitTracker(frame, recoveryBox);
+            selectedROI = recoveryBox;
+            trackingInitialized = true;
+            isOccluded = false;
+            std::cout << "Recovered using DAM memory.\n";
+        }
+    }
+};
+
+#endif /* stream_tracker_h */
@@ -0,0 +1,71 @@
+//
+//  track_log_tool.cpp
+//  Inference
+//
+//  Inspects and converts binary track logs (see track_log.h).
+//
+//  Usage: track_log dump <log> [frame]
+//         track_log to-json <log> <dir> [trackId]
+//         track_log from-json <dir> <log> [trackId]
+//
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "track_log.h"
+
+namespace {
+
+void printRecord(const TrackLogRecord& r) {
+    std::cout << r.frameIndex << " t=" << r.timestampUs << " track=" << r.trackId << " class=" << r.classId
+              << " score=" << r.score << " box=(" << r.x << ", " << r.y << ", " << r.width << ", " << r.height << ")\n";
+}
+
+int usage() {
+    std::cerr << "Usage: track_log dump <log> [frame]\n"
+              << "       track_log to-json <log> <dir> [trackId]\n"
+              << "       track_log from-json <dir> <log> [trackId]\n";
+    return 1;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) return usage();
+    const std::string command = argv[1];
+
+    try {
+        if (command == "dump") {
+            TrackLogReader reader(argv[2]);
+            std::cout << reader.getRecordCount() << " records in " << reader.getBlockCount() << " blocks, frames "
+                      << reader.getFirstFrame() << ".." << reader.getLastFrame() << "\n";
+            if (argc > 3) {
+                for (const TrackLogRecord& r : reader.readFrame(std::uint32_t(std::atoi(argv[3]))))
+                    printRecord(r);
+            } else {
+                for (const TrackLogRecord& r : reader.readAll())
+                    printRecord(r);
+            }
+        } else if (command == "to-json" && argc > 3) {
+            TrackLogReader reader(argv[2]);
+            std::size_t n = exportTrackLogJson(reader, argv[3], argc > 4 ? std::atoi(argv[4]) : 0);
+            std::cout << n << " records written to " << argv[3] << "\n";
+        } else if (command == "from-json" && argc > 3) {
+            TrackLogWriter writer(argv[3]);
+            std::size_t n = importTrackLogJson(argv[2], writer, argc > 4 ? std::atoi(argv[4]) : 0);
+            writer.flush();
+            std::cout << n << " records appended to " << argv[3] << " (" << writer.getBytesWritten() << " bytes)";
+            if (writer.getDroppedCount() > 0)
+                std::cout << ", " << writer.getDroppedCount() << " before the end of the log dropped";
+            std::cout << "\n";
+        } else {
+            return usage();
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,286 @@
+//
+//  tracker_core.h
+//  Inference
+//
+//  Tracking building blocks shared by the single- and multi-stream apps.
+//
+
+#ifndef tracker_core_h
+#define tracker_core_h
+
+#include <iostream>
+#include <deque>
+#include <functional>
+#include <vector>
+#include <algorithm>
+#include <opencv2/opencv.hpp>
+#include <opencv2/tracking.hpp>
+#include "box_geometry.h"
+#include "box_set.h"
+#include "candidate_scorer.h"
+#include "metrics.h"
+#include "spatial_grid.h"
+
+// ---- CONFIG ---- //
+struct Config {
+    static constexpr int RAM_SIZE = 3; // 3
+    static constexpr int DRM_SIZE = 6;
+    static constexpr int AREA_HISTORY_SIZE = 10;
+    static constexpr int UPDATE_INTERVAL = 10;
+    static constexpr int DETECTION_INTERVAL = 10;
+    static constexpr float IOU_THRESHOLD = 0.4;
+    static constexpr float AREA_TOLERANCE = 0.9;
+    static constexpr double OVERLAP_THRESHOLD = 0.4;
+    static constexpr bool FRAME_GATING = true; // skip detection on static frames, re-detect on scene cuts
+    // Target association score weights (see TargetAssociator)
+    static constexpr double MATCH_IOU_WEIGHT = 0.5;
+    static constexpr double MATCH_AREA_WEIGHT = 0.3;
+    static constexpr double MATCH_DISTANCE_WEIGHT = 0.2;
+    static constexpr double MATCH_APPEARANCE_WEIGHT = 0.5;
+    static constexpr int GRID_MIN_DETECTIONS = 32; // index detections in a SpatialGrid from this many
+    static constexpr double REACQUIRE_DISTANCE = 3.0; // in track sizes; farther detections never continue a lost track
+};
+
+// ---- UTILS ---- //
+class Utils {
+public:
+    static double computeIoU(const cv::Rect& r1, const cv::Rect& r2) {
+        return geometry::iou(Box2f::fromRect(r1), Box2f::fromRect(r2));
+    }
+
+    static double computeMedianArea(const std::deque<double>& areas) {
+        std::vector<double> sortedAreas(areas.begin(), areas.end());
+        std::sort(sortedAreas.begin(), sortedAreas.end());
+        size_t n = sortedAreas.size();
+        return (n % 2 == 0) ? (sortedAreas[n / 2 - 1] + sortedAreas[n / 2]) / 2.0 : sortedAreas[n / 2];
+    }
+};
+
+// ---- DAM MEMORY ---- //
+class DAMMemory {
+public:
+    std::deque<cv::Rect> RAM;
+    std::deque<cv::Rect> DRM;
+    std::deque<double> maskAreas;
+
+    void updateRAM(const cv::Rect& box) {
+        if (RAM.size() >= Config::RAM_SIZE) RAM.pop_front();
+        RAM.push_back(box);
+        if (maskAreas.size() >= Config::AREA_HISTORY_SIZE) maskAreas.pop_front();
+        maskAreas.push_back(box.area());
+    }
+
+    void updateDRM(const cv::Rect& box) {
+        static metrics::Counter& drmInserts = metrics::registry().counter("drm_inserts");
+        drmInserts.add();
+        if (DRM.size() >= Config::DRM_SIZE) DRM.pop_front();
+        DRM.push_back(box);
+        std::cout << "Distractor saved to DRM.\n";
+    }
+
+    double getMedianArea() const {
+        return Utils::computeMedianArea(maskAreas);
+    }
+
+    cv::Rect getBestMemory() const {
+        if (!DRM.empty()) return DRM.back();
+        if (!RAM.empty()) return RAM.back();
+        return cv::Rect();
+    }
+};
+
+// ---- ASSOCIATION ---- //
+// Matches one detection round against the track in a single pass. Every
+// detection overlapping the track (IoU above OVERLAP_THRESHOLD) is a
+// candidate, scored on IoU, area consistency with the DAM median area,
+// center distance and, if a scorer is given, appearance; the best one
+// continues the track. Other detections of target-like size that are clear
+// of the track (and of the winner) are distractors. With a SpatialGrid over
+// the detections, IoU is only computed for the detections it reports as
+// touching the track or the winner; the rest are known to be 0.
+struct Association {
+    int target = -1;                // index into the detections, -1 if none matched
+    double score = 0.0;
+    int candidates = 0;             // detections that passed the IoU gate
+    std::vector<int> distractors;
+};
+
+class TargetAssociator {
+public:
+    // Similarity of a box to the target, 0..1.
+    using AppearanceScore = std::function<double(const cv::Rect&)>;
+
+    static Association associate(const cv::Rect& roi, const BoxSet& detections, double medianArea,
+                                 const AppearanceScore& appearance = nullptr,
+                                 const SpatialGrid* grid = nullptr) {
+        Association result;
+        const Box2f track = Box2f::fromRect(roi);
+        const double scale = std::max(1.0, std::sqrt(double(roi.area())));
+        std::vector<float> ious, distances;
+        iouRow(track, detections, grid, ious);
+        geometry::distance(track, detections, distances);
+        std::vector<int> losers;
+
+        for (int i = 0; i < (int)detections.size(); i++) {
+            double iou = ious[i];
+            double areaDiff = std::abs(detections.box(i).area() - medianArea) / medianArea;
+
+            if (iou > Config::OVERLAP_THRESHOLD) {
+                double distance = distances[i] / scale;
+                double score = Config::MATCH_IOU_WEIGHT * iou
+                    + Config::MATCH_AREA_WEIGHT * (1.0 - std::min(1.0, areaDiff))
+                    + Config::MATCH_DISTANCE_WEIGHT * (1.0 - std::min(1.0, distance));
+                if (appearance) score += Config::MATCH_APPEARANCE_WEIGHT * appearance(detections.rect(i));
+
+                result.candidates++;
+                if (result.target < 0 || score > result.score) {
+                    if (result.target >= 0) losers.push_back(result.target);
+                    result.target = i;
+                    result.score = score;
+                } else {
+                    losers.push_back(i);
+                }
+            } else if (iou < Config::IOU_THRESHOLD && areaDiff <= Config::AREA_TOLERANCE) {
+                result.distractors.push_back(i);
+            }
+        }
+
+        // A second candidate that is a different object next to the target.
+        if (!losers.empty()) {
+            iouRow(detections.box(result.target), detections, grid, ious);
+            for (int i : losers) {
+                double areaDiff = std::abs(detections.box(i).area() - medianArea) / medianArea;
+                if (ious[i] < Config::IOU_THRESHOLD && areaDiff <= Config::AREA_TOLERANCE)
+                    result.distractors.push_back(i);
+            }
+        }
+        return result;
+    }
+
+private:
+    static void iouRow(const Box2f& box, const BoxSet& detections, const SpatialGrid* grid, std::vector<float>& ious) {
+        if (!grid) {
+            geometry::iou(box, detections, ious);
+            return;
+        }
+        std::vector<int> near;
+        grid->query(box, 0.f, near);
+        ious.assign(detections.size(), 0.f);
+        for (int i : near)
+            ious[i] = geometry::iou(box, detections.box(i));
+    }
+};
+
+// ---- REACQUISITION ---- //
+// For rounds in which no detection overlaps the track. The detections of
+// target-like size within REACQUIRE_DISTANCE track sizes of the last box
+// are ranked with CandidateScorer (confidence, distance, distance relative
+// to the frame, area and overlap ranks) and the best one continues the
+// track. Only when there is none does the tracker fall back to DAM memory.
+class TargetReacquirer {
+    CandidateScorer scorer{ScoringReference()};
+    CandidateSet candidates;
+    std::vector<int> indices;       // candidate -> detection
+    std::vector<float> distances;
+public:
+    // Index into the detections, -1 if none is close enough.
+    int select(const cv::Rect& roi, const BoxSet& detections, double medianArea, cv::Size frameSize) {
+        const double maxDistance = Config::REACQUIRE_DISTANCE * std::max(1.0, std::sqrt(double(roi.area())));
+        geometry::distance(Box2f::fromRect(roi), detections, distances);
+        candidates.clear();
+        indices.clear();
+        for (int i = 0; i < (int)detections.size(); i++) {
+            cv::Rect box = detections.rect(i);
+            double areaDiff = std::abs(box.area() - medianArea) / medianArea;
+            if (areaDiff <= Config::AREA_TOLERANCE && distances[i] <= maxDistance) {
+                candidates.push_back(box, detections.score[i]);
+                indices.push_back(i);
+            }
+        }
+        if (candidates.empty()) return -1;
+
+        ScoringReference reference;
+        reference.box = roi;
+        reference.distanceThreshold = maxDistance;
+        reference.diagonal = std::max(1.0, std::hypot(double(frameSize.width), double(frameSize.height)));
+        reference.maxArea = medianArea;
+        scorer.setReference(reference);
+        return indices[scorer.topK(candidates, 1).front().index];
+    }
+};
+
+// ---- TRACKER MANAGER ---- //
+// With a scale below 1 CSRT sees a downscaled copy of the frame. That only
+// shrinks its feature maps for targets whose window is below CSRT's own
+// template size (larger windows are already resampled to it), and costs a
+// scaled copy of the whole frame plus one full-frame resize per frame, so
+// it is off unless asked for (OHTRACK_TRACKER_SCALE).
+class TrackerManager {
+    cv::Ptr<cv::TrackerCSRT> tracker;
+    double scale = 1.0;
+    double activeScale = 1.0;   // scale of the current tracker
+    cv::Mat scaled;     // the frame at activeScale
+    cv::Rect window;    // last target box, for the memory estimate
+public:
+    TrackerManager() { tracker = cv::TrackerCSRT::create(); }
+
+    // Takes effect from the next reinit().
+    void setScale(double value) { scale = std::min(std::max(value, 0.1), 1.0); }
+    double getScale() const { return scale; }
+
+    void reinit(const cv::Mat& frame, const cv::Rect& box) {
+        static metrics::Counter& reinits = metrics::registry().counter("tracker_reinits");
+        reinits.add();
+        tracker.release();
+        tracker = cv::TrackerCSRT::create();
+        activeScale = scale;
+        tracker->init(input(frame), toScaled(box));
+        window = box;
+    }
+
+    bool track(const cv::Mat& frame, cv::Rect& roi) {
+        bool found;
+        if (activeScale == 1.0) {
+            found = tracker->update(frame, roi);
+        } else {
+            cv::Rect scaledRoi = toScaled(roi);
+            found = tracker->update(input(frame), scaledRoi);
+            roi = fromScaled(scaledRoi);
+        }
+        window = roi;
+        return found;
+    }
+
+    // The scaled frame plus CSRT's model: about 29 float feature channels
+    // (HOG, color names, gray) per 4x4 cell of its window (target plus
+    // padding, scaled down to a 200 px template when larger), held in
+    // around six copies (features, filters, their spectra).
+    std::size_t memoryBytes() const {
+        std::size_t bytes = scaled.total() * scaled.elemSize();
+        if (window.area() <= 0) return bytes;
+        double side = (std::max(window.width, window.height) + 3.0 * std::sqrt(double(window.area()))) * activeScale;
+        side = std::min(side, 200.0 * 1.4);
+        double cells = (side / 4) * (side / 4);
+        return bytes + std::size_t(cells * 29 * sizeof(float) * 6);
+    }
+
+private:
+    const cv::Mat& input(const cv::Mat& frame) {
+        if (activeScale == 1.0) return frame;
+        cv::resize(frame, scaled, cv::Size(), activeScale, activeScale, cv::INTER_AREA);
+        return scaled;
+    }
+
+    cv::Rect toScaled(const cv::Rect& box) const {
+        if (activeScale == 1.0) return box;
+        return cv::Rect(cvRound(box.x * activeScale), cvRound(box.y * activeScale),
+                        std::max(1, cvRound(box.width * activeScale)), std::max(1, cvRound(box.height * activeScale)));
+    }
+
+    cv::Rect fromScaled(const cv::Rect& box) const {
+        return cv::Rect(cvRound(box.x / activeScale), cvRound(box.y / activeScale),
+                        cvRound(box.width / activeScale), cvRound(box.height / activeScale));
+    }
+};
+
+#endif /* tracker_core_h */
@@ -1,5 +1,11 @@
+#ifndef bounding_box_saver_h
+#define bounding_box_saver_h
+
 #include <nlohmann/json.hpp>
+#include <chrono>
 #include <fstream>
+#include <iomanip>
+#include <iostream>
 #include <opencv2/opencv.hpp>
 
 using json = nlohmann::json;
@@ -68,4 +74,6 @@ public:
             throw;
         }
     }
-};
\ No newline at end of file
+};
+
+#endif /* bounding_box_saver_h */
@@ -0,0 +1,245 @@
+//
+//  box_geometry.cpp
+//  Inference
+//
+
+#include "box_geometry.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define GEOMETRY_AVX2 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#define GEOMETRY_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace geometry {
+
+namespace {
+
+enum class Metric { IoU, Overlap, Distance, SquaredDistance };
+
+// One row box, with the values every column needs precomputed.
+struct RowBox {
+    float x0, y0, x1, y1;
+    float area;
+    float cx, cy;
+
+    RowBox(const BoxView& a, std::size_t i)
+        : x0(a.x0[i]), y0(a.y0[i]), x1(a.x1[i]), y1(a.y1[i]),
+          area((x1 - x0) * (y1 - y0)),
+          cx(0.5f * (x0 + x1)), cy(0.5f * (y0 + y1)) {}
+};
+
+// ---- SCALAR ---- //
+template <Metric M>
+inline float pair(const RowBox& a, float bx0, float by0, float bx1, float by1)
+{
+    if constexpr (M == Metric::IoU || M == Metric::Overlap) {
+        const float iw = std::max(0.f, std::min(a.x1, bx1) - std::max(a.x0, bx0));
+        const float ih = std::max(0.f, std::min(a.y1, by1) - std::max(a.y0, by0));
+        const float inter = iw * ih;
+        const float denom = M == Metric::IoU ? a.area + (bx1 - bx0) * (by1 - by0) - inter : a.area;
+        return denom > 0.f ? inter / denom : 0.f;
+    } else {
+        const float dx = 0.5f * (bx0 + bx1) - a.cx;
+        const float dy = 0.5f * (by0 + by1) - a.cy;
+        const float d2 = dx * dx + dy * dy;
+        return M == Metric::Distance ? std::sqrt(d2) : d2;
+    }
+}
+
+template <Metric M>
+void rowScalar(const RowBox& a, const BoxView& b, std::size_t from, float* __restrict out)
+{
+    for (std::size_t j = from; j < b.size; j++)
+        out[j] = pair<M>(a, b.x0[j], b.y0[j], b.x1[j], b.y1[j]);
+}
+
+template <Metric M>
+void fillScalar(const BoxView& a, const BoxView& b, float* out)
+{
+    for (std::size_t i = 0; i < a.size; i++)
+        rowScalar<M>(RowBox(a, i), b, 0, out + i * b.size);
+}
+
+// ---- AVX2 ---- //
+#ifdef GEOMETRY_AVX2
+template <Metric M>
+__attribute__((target("avx2")))
+void fillAvx2(const BoxView& a, const BoxView& b, float* out)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 half = _mm256_set1_ps(0.5f);
+
+    for (std::size_t i = 0; i < a.size; i++) {
+        const RowBox row(a, i);
+        float* rowOut = out + i * b.size;
+        const __m256 ax0 = _mm256_set1_ps(row.x0);
+        const __m256 ay0 = _mm256_set1_ps(row.y0);
+        const __m256 ax1 = _mm256_set1_ps(row.x1);
+        const __m256 ay1 = _mm256_set1_ps(row.y1);
+        const __m256 aArea = _mm256_set1_ps(row.area);
+        const __m256 acx = _mm256_set1_ps(row.cx);
+        const __m256 acy = _mm256_set1_ps(row.cy);
+
+        std::size_t j = 0;
+        for (; j + 8 <= b.size; j += 8) {
+            const __m256 bx0 = _mm256_loadu_ps(b.x0 + j);
+            const __m256 by0 = _mm256_loadu_ps(b.y0 + j);
+            const __m256 bx1 = _mm256_loadu_ps(b.x1 + j);
+            const __m256 by1 = _mm256_loadu_ps(b.y1 + j);
+            __m256 value;
+            if constexpr (M == Metric::IoU || M == Metric::Overlap) {
+                const __m256 iw = _mm256_max_ps(zero, _mm256_sub_ps(_mm256_min_ps(ax1, bx1), _mm256_max_ps(ax0, bx0)));
+                const __m256 ih = _mm256_max_ps(zero, _mm256_sub_ps(_mm256_min_ps(ay1, by1), _mm256_max_ps(ay0, by0)));
+                const __m256 inter = _mm256_mul_ps(iw, ih);
+                __m256 denom = aArea;
+                if constexpr (M == Metric::IoU) {
+                    const __m256 bArea = _mm256_mul_ps(_mm256_sub_ps(bx1, bx0), _mm256_sub_ps(by1, by0));
+                    denom = _mm256_sub_ps(_mm256_add_ps(aArea, bArea), inter);
+                }
+                // Lanes with no area divide by zero; the mask clears them.
+                const __m256 valid = _mm256_cmp_ps(denom, zero, _CMP_GT_OQ);
+                value = _mm256_and_ps(valid, _mm256_div_ps(inter, denom));
+            } else {
+                const __m256 dx = _mm256_sub_ps(_mm256_mul_ps(half, _mm256_add_ps(bx0, bx1)), acx);
+                const __m256 dy = _mm256_sub_ps(_mm256_mul_ps(half, _mm256_add_ps(by0, by1)), acy);
+                value = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+                if constexpr (M == Metric::Distance)
+                    value = _mm256_sqrt_ps(value);
+            }
+            _mm256_storeu_ps(rowOut + j, value);
+        }
+        // The tail is SSE code; without this every scalar divide pays the
+        // AVX-SSE transition penalty (10x on short rows).
+        _mm256_zeroupper();
+        rowScalar<M>(row, b, j, rowOut);
+    }
+}
+
+bool hasAvx2()
+{
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+#endif
+
+// ---- NEON ---- //
+#ifdef GEOMETRY_NEON
+template <Metric M>
+void fillNeon(const BoxView& a, const BoxView& b, float* out)
+{
+    const float32x4_t zero = vdupq_n_f32(0.f);
+    const float32x4_t half = vdupq_n_f32(0.5f);
+
+    for (std::size_t i = 0; i < a.size; i++) {
+        const RowBox row(a, i);
+        float* rowOut = out + i * b.size;
+        const float32x4_t ax0 = vdupq_n_f32(row.x0);
+        const float32x4_t ay0 = vdupq_n_f32(row.y0);
+        const float32x4_t ax1 = vdupq_n_f32(row.x1);
+        const float32x4_t ay1 = vdupq_n_f32(row.y1);
+        const float32x4_t aArea = vdupq_n_f32(row.area);
+        const float32x4_t acx = vdupq_n_f32(row.cx);
+        const float32x4_t acy = vdupq_n_f32(row.cy);
+
+        std::size_t j = 0;
+        for (; j + 4 <= b.size; j += 4) {
+            const float32x4_t bx0 = vld1q_f32(b.x0 + j);
+            const float32x4_t by0 = vld1q_f32(b.y0 + j);
+            const float32x4_t bx1 = vld1q_f32(b.x1 + j);
+            const float32x4_t by1 = vld1q_f32(b.y1 + j);
+            float32x4_t value;
+            if constexpr (M == Metric::IoU || M == Metric::Overlap) {
+                const float32x4_t iw = vmaxq_f32(zero, vsubq_f32(vminq_f32(ax1, bx1), vmaxq_f32(ax0, bx0)));
+                const float32x4_t ih = vmaxq_f32(zero, vsubq_f32(vminq_f32(ay1, by1), vmaxq_f32(ay0, by0)));
+                const float32x4_t inter = vmulq_f32(iw, ih);
+                float32x4_t denom = aArea;
+                if constexpr (M == Metric::IoU) {
+                    const float32x4_t bArea = vmulq_f32(vsubq_f32(bx1, bx0), vsubq_f32(by1, by0));
+                    denom = vsubq_f32(vaddq_f32(aArea, bArea), inter);
+                }
+                const uint32x4_t valid = vcgtq_f32(denom, zero);
+                value = vbslq_f32(valid, vdivq_f32(inter, denom), zero);
+            } else {
+                const float32x4_t dx = vsubq_f32(vmulq_f32(half, vaddq_f32(bx0, bx1)), acx);
+                const float32x4_t dy = vsubq_f32(vmulq_f32(half, vaddq_f32(by0, by1)), acy);
+                value = vaddq_f32(vmulq_f32(dx, dx), vmulq_f32(dy, dy));
+                if constexpr (M == Metric::Distance)
+                    value = vsqrtq_f32(value);
+            }
+            vst1q_f32(rowOut + j, value);
+        }
+        rowScalar<M>(row, b, j, rowOut);
+    }
+}
+#endif
+
+template <Metric M>
+void fill(const BoxView& a, const BoxView& b, float* out)
+{
+    if (a.size == 0 || b.size == 0)
+        return;
+#if defined(GEOMETRY_NEON)
+    fillNeon<M>(a, b, out);
+#else
+#if defined(GEOMETRY_AVX2)
+    if (hasAvx2()) {
+        fillAvx2<M>(a, b, out);
+        return;
+    }
+#endif
+    fillScalar<M>(a, b, out);
+#endif
+}
+
+template <Metric M>
+void fill(const BoxView& a, const BoxView& b, std::vector<float>& out)
+{
+    out.resize(a.size * b.size);
+    fill<M>(a, b, out.data());
+}
+
+}
+
+// ---- KERNELS ---- //
+void iou(const BoxView& a, const BoxView& b, float* out) { fill<Metric::IoU>(a, b, out); }
+void overlap(const BoxView& targets, const BoxView& others, float* out) { fill<Metric::Overlap>(targets, others, out); }
+void distance(const BoxView& a, const BoxView& b, float* out) { fill<Metric::Distance>(a, b, out); }
+void squaredDistance(const BoxView& a, const BoxView& b, float* out) { fill<Metric::SquaredDistance>(a, b, out); }
+
+void iou(const BoxView& a, const BoxView& b, std::vector<float>& out) { fill<Metric::IoU>(a, b, out); }
+void overlap(const BoxView& targets, const BoxView& others, std::vector<float>& out) { fill<Metric::Overlap>(targets, others, out); }
+void distance(const BoxView& a, const BoxView& b, std::vector<float>& out) { fill<Metric::Distance>(a, b, out); }
+void squaredDistance(const BoxView& a, const BoxView& b, std::vector<float>& out) { fill<Metric::SquaredDistance>(a, b, out); }
+
+float iou(const Box2f& a, const Box2f& b)
+{
+    return pair<Metric::IoU>(RowBox(BoxView(a), 0), b.x0, b.y0, b.x1, b.y1);
+}
+
+float overlap(const Box2f& target, const Box2f& other)
+{
+    return pair<Metric::Overlap>(RowBox(BoxView(target), 0), other.x0, other.y0, other.x1, other.y1);
+}
+
+const char* instructionSet()
+{
+#if defined(GEOMETRY_NEON)
+    return "neon";
+#else
+#if defined(GEOMETRY_AVX2)
+    if (hasAvx2())
+        return "avx2";
+#endif
+    return "scalar";
+#endif
+}
+
+}
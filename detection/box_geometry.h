@@ -0,0 +1,61 @@
+//
+//  box_geometry.h
+//  Inference
+//
+//  Batch box geometry over structure-of-arrays corners. Each kernel fills
+//  an N×M row-major matrix (row i holds box a[i] against every box of b):
+//  IoU, intersection over the area of a[i], and center distance, plus a
+//  squared distance for callers that only compare against a threshold.
+//  Rows run 8 boxes at a time with AVX2 (picked at runtime on x86) or 4 at
+//  a time with NEON on AArch64, and fall back to plain loops elsewhere.
+//  Association, NMS and the tracker IoU all go through here.
+//
+
+#ifndef box_geometry_h
+#define box_geometry_h
+
+#include <vector>
+
+#include "box_set.h"
+
+namespace geometry {
+
+// Read-only corner arrays. A view of a single Box2f points into that box,
+// so it must outlive the view.
+struct BoxView {
+    const float* x0;
+    const float* y0;
+    const float* x1;
+    const float* y1;
+    std::size_t size;
+
+    BoxView(const float* x0, const float* y0, const float* x1, const float* y1, std::size_t size)
+        : x0(x0), y0(y0), x1(x1), y1(y1), size(size) {}
+    BoxView(const BoxSet& boxes)
+        : x0(boxes.x0.data()), y0(boxes.y0.data()), x1(boxes.x1.data()), y1(boxes.y1.data()), size(boxes.size()) {}
+    BoxView(const Box2f& box)
+        : x0(&box.x0), y0(&box.y0), x1(&box.x1), y1(&box.y1), size(1) {}
+};
+
+// `out` holds a.size * b.size values; the vector forms resize it.
+// Degenerate boxes (zero union or zero target area) give 0.
+void iou(const BoxView& a, const BoxView& b, float* out);
+void overlap(const BoxView& targets, const BoxView& others, float* out);
+void distance(const BoxView& a, const BoxView& b, float* out);
+void squaredDistance(const BoxView& a, const BoxView& b, float* out);
+
+void iou(const BoxView& a, const BoxView& b, std::vector<float>& out);
+void overlap(const BoxView& targets, const BoxView& others, std::vector<float>& out);
+void distance(const BoxView& a, const BoxView& b, std::vector<float>& out);
+void squaredDistance(const BoxView& a, const BoxView& b, std::vector<float>& out);
+
+// One pair, with the same arithmetic as the matrix kernels.
+float iou(const Box2f& a, const Box2f& b);
+float overlap(const Box2f& target, const Box2f& other);
+
+// "avx2", "neon" or "scalar": the row kernels this process uses.
+const char* instructionSet();
+
+}
+
+#endif /* box_geometry_h */
@@ -0,0 +1,92 @@
+//
+//  box_set.cpp
+//  Inference
+//
+
+#include "box_set.h"
+
+#include <algorithm>
+#include <numeric>
+
+void BoxSet::clear()
+{
+    x0.clear();
+    y0.clear();
+    x1.clear();
+    y1.clear();
+    score.clear();
+    classId.clear();
+    id.clear();
+}
+
+void BoxSet::reserve(std::size_t n)
+{
+    x0.reserve(n);
+    y0.reserve(n);
+    x1.reserve(n);
+    y1.reserve(n);
+    score.reserve(n);
+    classId.reserve(n);
+    id.reserve(n);
+}
+
+void BoxSet::push_back(const Box2f& box, float boxScore, int boxClassId, int boxId)
+{
+    x0.push_back(box.x0);
+    y0.push_back(box.y0);
+    x1.push_back(box.x1);
+    y1.push_back(box.y1);
+    score.push_back(boxScore);
+    classId.push_back(boxClassId);
+    id.push_back(boxId);
+}
+
+void BoxSet::push_back(const BoxInfo& box)
+{
+    push_back(Box2f::fromBBox(box.getBox()), box.getConfidence(), box.getClassId(), box.getId());
+}
+
+void BoxSet::assign(const std::vector<BoxInfo>& boxes)
+{
+    clear();
+    reserve(boxes.size());
+    for (const BoxInfo& box : boxes)
+        push_back(box);
+}
+
+void BoxSet::appendTo(std::vector<BoxInfo>& boxes) const
+{
+    boxes.reserve(boxes.size() + size());
+    for (std::size_t i = 0; i < size(); i++)
+        boxes.push_back(boxInfo(i));
+}
+
+void BoxSet::sortByScore()
+{
+    std::vector<int> order(size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [this](int a, int b) { return score[a] > score[b]; });
+    permute(order);
+}
+
+void BoxSet::select(const std::vector<int>& indices)
+{
+    permute(indices);
+}
+
+void BoxSet::permute(const std::vector<int>& order)
+{
+    auto gather = [&order](auto& values) {
+        std::remove_reference_t<decltype(values)> out(order.size());
+        for (std::size_t i = 0; i < order.size(); i++)
+            out[i] = values[order[i]];
+        values.swap(out);
+    };
+    gather(x0);
+    gather(y0);
+    gather(x1);
+    gather(y1);
+    gather(score);
+    gather(classId);
+    gather(id);
+}
@@ -0,0 +1,81 @@
+//
+//  box_set.h
+//  Inference
+//
+//  Float box type and a structure-of-arrays box container for the
+//  detection pipeline. Decode, NMS, target association and drawing keep
+//  their boxes in a BoxSet (corner coordinates, score, class and id in
+//  separate arrays), so batch geometry can run over contiguous floats.
+//  BoxInfo and cv::Rect only appear at the API edges, through the
+//  conversions below.
+//
+
+#ifndef box_set_h
+#define box_set_h
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "boxinfo.h"
+
+struct Box2f {
+    float x0 = 0.f;
+    float y0 = 0.f;
+    float x1 = 0.f;
+    float y1 = 0.f;
+
+    float width() const { return x1 - x0; }
+    float height() const { return y1 - y0; }
+    float area() const { return (x1 - x0) * (y1 - y0); }
+    float centerX() const { return 0.5f * (x0 + x1); }
+    float centerY() const { return 0.5f * (y0 + y1); }
+
+    template <typename T>
+    static Box2f fromRect(const cv::Rect_<T>& r) {
+        return {float(r.x), float(r.y), float(r.x + r.width), float(r.y + r.height)};
+    }
+    static Box2f fromBBox(const BBox& b) {
+        return {float(b.x), float(b.y), float(b.x + b.w), float(b.y + b.h)};
+    }
+
+    // Integer boxes truncate each of x, y, width and height, as BBox always has.
+    cv::Rect toRect() const { return cv::Rect(int(x0), int(y0), int(x1 - x0), int(y1 - y0)); }
+    BBox toBBox() const { return BBox(int(x0), int(y0), int(x1 - x0), int(y1 - y0)); }
+};
+
+class BoxSet {
+public:
+    std::vector<float> x0;
+    std::vector<float> y0;
+    std::vector<float> x1;
+    std::vector<float> y1;
+    std::vector<float> score;
+    std::vector<int> classId;
+    std::vector<int> id;
+
+    std::size_t size() const { return x0.size(); }
+    bool empty() const { return x0.empty(); }
+    void clear();
+    void reserve(std::size_t n);
+
+    void push_back(const Box2f& box, float score, int classId, int id = -1);
+    void push_back(const BoxInfo& box);
+
+    Box2f box(std::size_t i) const { return {x0[i], y0[i], x1[i], y1[i]}; }
+    cv::Rect rect(std::size_t i) const { return box(i).toRect(); }
+    BoxInfo boxInfo(std::size_t i) const { return BoxInfo(id[i], classId[i], score[i], box(i).toBBox()); }
+
+    void assign(const std::vector<BoxInfo>& boxes);
+    void appendTo(std::vector<BoxInfo>& boxes) const;
+
+    // Highest score first; equal scores keep their order.
+    void sortByScore();
+
+    // Keeps the boxes at `indices`, in that order.
+    void select(const std::vector<int>& indices);
+
+private:
+    void permute(const std::vector<int>& order);
+};
+
+#endif /* box_set_h */
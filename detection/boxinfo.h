@@ -21,7 +21,7 @@ struct BBox {
     int w;
     int h;
     
-    BBoxCenter getCenter() {
+    BBoxCenter getCenter() const {
         return BBoxCenter{x + w/2, y + h/2};
     }
     
@@ -101,11 +101,11 @@ public:
         box = bbox;
     }
     
-    int getId() {
+    int getId() const {
         return trackId;
     }
 
-    float getConfidence() {
+    float getConfidence() const {
         return confidenceScore;
     }
 
@@ -113,31 +113,31 @@ public:
         return classId;
     }
 
-    int getLeft() {
+    int getLeft() const {
         return box.x;
     }
 
-    int getRight() {
+    int getRight() const {
         return (box.x + box.w);
     }
 
-    int getTop() {
+    int getTop() const {
         return box.y;
     }
 
-    int getBottom() {
+    int getBottom() const {
         return (box.y + box.h);
     }
 
-    int getWidth() {
+    int getWidth() const {
         return box.w;
     }
 
-    int getHeight() {
+    int getHeight() const {
         return box.h;
     }
     
-    BBoxCenter getCenter() {
+    BBoxCenter getCenter() const {
         return BBoxCenter{box.x + box.w/2, box.y + box.h/2};
     }
 };
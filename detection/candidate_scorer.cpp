@@ -0,0 +1,118 @@
+//
+//  candidate_scorer.cpp
+//  Inference
+//
+
+#include "candidate_scorer.h"
+
+#include <cmath>
+
+// ---- CANDIDATES ---- //
+void CandidateSet::clear()
+{
+    x.clear();
+    y.clear();
+    w.clear();
+    h.clear();
+    score.clear();
+}
+
+void CandidateSet::reserve(std::size_t n)
+{
+    x.reserve(n);
+    y.reserve(n);
+    w.reserve(n);
+    h.reserve(n);
+    score.reserve(n);
+}
+
+void CandidateSet::push_back(const BoxInfo& box)
+{
+    const BBox b = box.getBox();
+    x.push_back(b.x);
+    y.push_back(b.y);
+    w.push_back(b.w);
+    h.push_back(b.h);
+    score.push_back(box.getConfidence());
+}
+
+void CandidateSet::push_back(const cv::Rect& box, float boxScore)
+{
+    x.push_back(box.x);
+    y.push_back(box.y);
+    w.push_back(box.width);
+    h.push_back(box.height);
+    score.push_back(boxScore);
+}
+
+void CandidateSet::assign(const std::vector<BoxInfo>& boxes)
+{
+    clear();
+    reserve(boxes.size());
+    for (const BoxInfo& box : boxes)
+        push_back(box);
+}
+
+// ---- SCORING ---- //
+void CandidateScorer::score(const CandidateSet& candidates, std::vector<int>& out) const
+{
+    const std::size_t n = candidates.size();
+    out.resize(n);
+
+    const int* __restrict xs = candidates.x.data();
+    const int* __restrict ys = candidates.y.data();
+    const int* __restrict ws = candidates.w.data();
+    const int* __restrict hs = candidates.h.data();
+    const float* __restrict scores = candidates.score.data();
+    int* __restrict ranks = out.data();
+
+    // Centers in integer pixels, as BBox::getCenter() computes them.
+    const cv::Rect& ref = reference.box;
+    const int refCx = ref.x + ref.width / 2;
+    const int refCy = ref.y + ref.height / 2;
+    const int refX0 = ref.x;
+    const int refY0 = ref.y;
+    const int refX1 = ref.x + ref.width;
+    const int refY1 = ref.y + ref.height;
+    const int overlapWeight = ref.empty() ? 0 : 1;   // getOverlapRank() is 0 without a track
+    const double refArea = double(ref.width) * ref.height;
+    const double distanceThreshold = reference.distanceThreshold;
+    const double diagonal = reference.diagonal;
+    const double maxArea = reference.maxArea;
+
+    for (std::size_t i = 0; i < n; i++) {
+        const double dx = double(xs[i] + ws[i] / 2 - refCx);
+        const double dy = double(ys[i] + hs[i] / 2 - refCy);
+        const double distance = std::sqrt(dx * dx + dy * dy);
+
+        int rank = bboxUtils::confidenceRanks.lookup(scores[i]);
+        rank += bboxUtils::distanceRanks.lookup(distance / distanceThreshold);
+        rank += bboxUtils::distanceFromRanks.lookup(distance / diagonal);
+        rank += bboxUtils::areaRanks.lookup(double(ws[i] * hs[i]) / maxArea);
+
+        const int iw = std::max(0, std::min(refX1, xs[i] + ws[i]) - std::max(refX0, xs[i]));
+        const int ih = std::max(0, std::min(refY1, ys[i] + hs[i]) - std::max(refY0, ys[i]));
+        rank += overlapWeight * bboxUtils::overlapRanks.lookup(double(iw * ih) / refArea);
+
+        ranks[i] = rank;
+    }
+}
+
+std::vector<ScoredCandidate> CandidateScorer::topK(const CandidateSet& candidates, std::size_t k)
+{
+    score(candidates, ranks);
+
+    const std::size_t n = candidates.size();
+    k = std::min(k, n);
+    order.resize(n);
+    for (std::size_t i = 0; i < n; i++)
+        order[i] = int(i);
+
+    auto better = [this](int a, int b) { return ranks[a] < ranks[b] || (ranks[a] == ranks[b] && a < b); };
+    std::partial_sort(order.begin(), order.begin() + k, order.end(), better);
+
+    std::vector<ScoredCandidate> best(k);
+    for (std::size_t i = 0; i < k; i++)
+        best[i] = {order[i], ranks[order[i]]};
+    return best;
+}
@@ -0,0 +1,68 @@
+//
+//  candidate_scorer.h
+//  Inference
+//
+//  Batch form of the target-selection ranks in bboxUtils. Candidates are
+//  held as a structure of arrays, and one pass over them computes the
+//  confidence, distance, distance-from, area and overlap ranks against the
+//  reference track, with the same results as calling the five scalar rank
+//  functions box by box. The pass has no branches or allocations per box,
+//  so it vectorizes; picking the best k is a partial sort of indices.
+//
+
+#ifndef candidate_scorer_h
+#define candidate_scorer_h
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "utils.h"
+
+struct CandidateSet {
+    std::vector<int> x;
+    std::vector<int> y;
+    std::vector<int> w;
+    std::vector<int> h;
+    std::vector<float> score;
+
+    std::size_t size() const { return x.size(); }
+    bool empty() const { return x.empty(); }
+    void clear();
+    void reserve(std::size_t n);
+    void push_back(const BoxInfo& box);
+    void push_back(const cv::Rect& box, float score);
+    void assign(const std::vector<BoxInfo>& boxes);
+};
+
+struct ScoringReference {
+    cv::Rect box;                   // current track; an empty box ranks every overlap 0
+    double distanceThreshold = 1.0; // getDistanceRank() threshold
+    double diagonal = 1.0;          // getDistanceFromRank() normalization
+    double maxArea = 1.0;           // getAreaRank() normalization
+};
+
+struct ScoredCandidate {
+    int index;      // into the CandidateSet
+    int rank;       // sum of the five ranks, lower is better
+};
+
+class CandidateScorer {
+public:
+    explicit CandidateScorer(const ScoringReference& reference) : reference(reference) {}
+
+    void setReference(const ScoringReference& reference) { this->reference = reference; }
+    const ScoringReference& getReference() const { return reference; }
+
+    // Rank sum of every candidate.
+    void score(const CandidateSet& candidates, std::vector<int>& ranks) const;
+
+    // The k best candidates, best first; equal ranks keep the input order.
+    std::vector<ScoredCandidate> topK(const CandidateSet& candidates, std::size_t k);
+
+private:
+    ScoringReference reference;
+    std::vector<int> ranks;
+    std::vector<int> order;
+};
+
+#endif /* candidate_scorer_h */
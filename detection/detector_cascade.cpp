@@ -0,0 +1,45 @@
+//
+//  detector_cascade.cpp
+//  Inference
+//
+
+#include "detector_cascade.h"
+
+#include "box_geometry.h"
+
+namespace yolo {
+
+Escalation cascade_escalation(const CascadeHint& hint)
+{
+    return hint.recovering || hint.track.empty() ? Escalation::Recovery : Escalation::None;
+}
+
+Escalation cascade_escalation(const std::vector<BoxInfo>& detections, const CascadeHint& hint,
+                              const CascadeOptions& options)
+{
+    if (cascade_escalation(hint) != Escalation::None)
+        return Escalation::Recovery;
+
+    const Box2f track = Box2f::fromRect(hint.track);
+    int onTrack = 0;
+    float bestIoU = 0.f;
+    float bestScore = 0.f;
+    for (const BoxInfo& box : detections) {
+        const float iou = geometry::iou(track, Box2f::fromBBox(box.getBox()));
+        if (iou < options.minTrackIoU)
+            continue;
+        onTrack++;
+        if (iou > bestIoU) {
+            bestIoU = iou;
+            bestScore = box.getConfidence();
+        }
+    }
+
+    if (onTrack != 1)
+        return Escalation::Disagreement;
+    if (bestScore < options.minTargetScore)
+        return Escalation::LowScore;
+    return Escalation::None;
+}
+
+}
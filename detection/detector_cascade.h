@@ -0,0 +1,64 @@
+//
+//  detector_cascade.h
+//  Inference
+//
+//  Two-model detection cascade. A light model (a nano-sized export of the
+//  same classes) runs first; its result is kept unless the tracker's view
+//  of the target says it is not trustworthy, in which case the full model
+//  runs on the same frame. InferenceService applies the cascade to
+//  requests that carry a CascadeHint and counts the escalations and the
+//  full-model time they saved.
+//
+
+#ifndef detector_cascade_h
+#define detector_cascade_h
+
+#include <cstddef>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "boxinfo.h"
+
+namespace yolo {
+
+// What the tracker knows about its target when it asks for detections.
+struct CascadeHint {
+    cv::Rect track;             // current track box, empty if none
+    bool recovering = false;    // target lost or occluded
+};
+
+struct CascadeOptions {
+    float minTargetScore = 0.6f;    // the detection on the track must score at least this
+    float minTrackIoU = 0.3f;       // IoU for a detection to count as on the track
+};
+
+enum class Escalation {
+    None,
+    Recovery,       // the tracker is searching for the target
+    Disagreement,   // no detection, or more than one, on the track
+    LowScore,       // the detection on the track scores below minTargetScore
+};
+
+// What the hint alone decides: Recovery, or None when it takes the light
+// model's detections to tell.
+Escalation cascade_escalation(const CascadeHint& hint);
+
+// Whether the light model's `detections` need the full model.
+Escalation cascade_escalation(const std::vector<BoxInfo>& detections, const CascadeHint& hint,
+                              const CascadeOptions& options);
+
+struct CascadeStats {
+    std::size_t rounds = 0;
+    std::size_t escalations = 0;
+    std::size_t recovery = 0;
+    std::size_t disagreement = 0;
+    std::size_t lowScore = 0;
+    double lightMs = 0.0;       // light model time over all rounds
+    double savedMs = 0.0;       // estimated full-model time avoided, net of the light runs
+
+    double escalationRate() const { return rounds ? double(escalations) / rounds : 0.0; }
+};
+
+}
+
+#endif /* detector_cascade_h */
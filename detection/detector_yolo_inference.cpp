@@ -6,6 +6,11 @@
 //
 
 #include "detector_yolo_inference.hpp"
+#include "box_geometry.h"
+#include "metrics.h"
+#include "overlay_renderer.h"
+#include "spatial_grid.h"
+#include "yolo_decode_layer.h"
 
 namespace yolo {
 float intersection_area(const yolo::Object& a, const yolo::Object& b)
@@ -100,6 +105,73 @@ void nms_sorted_bboxes(const std::vector<yolo::Object>& faceobjects, std::vector
     }
 }
 
+// Kept boxes after which NMS switches from IoU rows to the spatial grid;
+// with few survivors a row against all of them is cheaper than the grid.
+static const int NMS_GRID_MIN_KEPT = 128;
+
+void nms_sorted_boxes(const BoxSet& boxes, std::vector<int>& picked, float nms_threshold, bool agnostic)
+{
+    picked.clear();
+    
+    // Kept boxes are copied into their own arrays, so each candidate is
+    // one IoU row against everything kept so far. Once many boxes survive
+    // (a crowded frame), the remaining candidates are only tested against
+    // the kept boxes sharing a grid cell with them.
+    BoxSet kept;
+    kept.reserve(boxes.size());
+    std::vector<float> ious;
+    SpatialGrid grid;
+    std::vector<char> isKept;
+    
+    const int n = int(boxes.size());
+    for (int i = 0; i < n; i++)
+    {
+        const Box2f box = boxes.box(i);
+        int keep = 1;
+        
+        if (grid.size() == 0 && (int)kept.size() >= NMS_GRID_MIN_KEPT)
+        {
+            grid.build(boxes);
+            isKept.assign(n, 0);
+            for (int k : picked)
+                isKept[k] = 1;
+        }
+        
+        if (grid.size() != 0)
+        {
+            grid.forEachCell(box, [&](const int* cell, int count) {
+                for (int c = 0; c < count && keep && cell[c] < i; c++)
+                {
+                    const int k = cell[c];
+                    if (!isKept[k] || (!agnostic && boxes.classId[i] != boxes.classId[k]))
+                        continue;
+                    if (geometry::iou(box, boxes.box(k)) > nms_threshold)
+                        keep = 0;
+                }
+            });
+        }
+        else
+        {
+            geometry::iou(box, kept, ious);
+            for (int k = 0; k < (int)kept.size() && keep; k++)
+            {
+                if (!agnostic && boxes.classId[i] != kept.classId[k])
+                    continue;
+                if (ious[k] > nms_threshold)
+                    keep = 0;
+            }
+        }
+        
+        if (keep)
+        {
+            picked.push_back(i);
+            kept.push_back(box, boxes.score[i], boxes.classId[i]);
+            if (!isKept.empty())
+                isKept[i] = 1;
+        }
+    }
+}
+
 float sigmoid(float x)
 {
     return static_cast<float>(1.f / (1.f + exp(-x)));
@@ -111,63 +183,74 @@ float clampf(float d, float min, float max)
     return t > max ? max : t;
 }
 
+// The output is channel-major (4 + num_labels rows of num_anchors), so the
+// best class of every anchor is found row by row over contiguous floats
+// instead of transposing the tensor first.
 void parse_yolov_detections(
-                                   float* inputs, float confidence_threshold,
+                                   const float* inputs, float confidence_threshold,
                                    int num_channels, int num_anchors, int num_labels,
                                    int infer_img_width, int infer_img_height,
-                                   std::vector<yolo::Object>& objects)
+                                   BoxSet& proposals)
 {
-    std::vector<yolo::Object> detections;
+    proposals.clear();
+    if (num_labels <= 0 || num_channels < 4 + num_labels)
+        return;
     
-    cv::Mat output = cv::Mat((int)num_channels, (int)num_anchors, CV_32F, inputs).t();
+    std::vector<float> best(inputs + size_t(4) * num_anchors, inputs + size_t(5) * num_anchors);
+    std::vector<int> label(num_anchors, 0);
+    for (int k = 1; k < num_labels; k++)
+    {
+        const float* row = inputs + size_t(4 + k) * num_anchors;
+        for (int i = 0; i < num_anchors; i++)
+        {
+            const bool higher = row[i] > best[i];
+            best[i] = higher ? row[i] : best[i];
+            label[i] = higher ? k : label[i];
+        }
+    }
     
+    const float* xs = inputs;
+    const float* ys = inputs + size_t(num_anchors);
+    const float* ws = inputs + size_t(2) * num_anchors;
+    const float* hs = inputs + size_t(3) * num_anchors;
     for (int i = 0; i < num_anchors; i++)
     {
-        const float* row_ptr = output.row(i).ptr<float>();
-        const float* bboxes_ptr = row_ptr; // 0x140e2b09c    0x0000000140e2b0 9c
-        const float* scores_ptr = row_ptr + 4; // 0x140e2b0a0    0x0000000140e2b0 a0
-        const float* max_s_ptr = std::max_element(scores_ptr, scores_ptr + num_labels);
-        float score = *max_s_ptr;
-        
-        if (score > confidence_threshold)
+        if (best[i] > confidence_threshold)
         {
-            float x = *bboxes_ptr++;
-            float y = *bboxes_ptr++;
-            float w = *bboxes_ptr++;
-            float h = *bboxes_ptr;
-            
-            float x0 = clampf((x - 0.5f * w), 0.f, (float)infer_img_width);
-            float y0 = clampf((y - 0.5f * h), 0.f, (float)infer_img_height);
-            float x1 = clampf((x + 0.5f * w), 0.f, (float)infer_img_width);
-            float y1 = clampf((y + 0.5f * h), 0.f, (float)infer_img_height);
-            
-            cv::Rect_<float> bbox;
-            bbox.x = x0;
-            bbox.y = y0;
-            bbox.width = x1 - x0;
-            bbox.height = y1 - y0;
-            yolo::Object object;
-            object.label = int(max_s_ptr - scores_ptr);
-            object.prob = score;
-            object.rect = bbox;
-            detections.push_back(object);
+            Box2f box;
+            box.x0 = clampf((xs[i] - 0.5f * ws[i]), 0.f, (float)infer_img_width);
+            box.y0 = clampf((ys[i] - 0.5f * hs[i]), 0.f, (float)infer_img_height);
+            box.x1 = clampf((xs[i] + 0.5f * ws[i]), 0.f, (float)infer_img_width);
+            box.y1 = clampf((ys[i] + 0.5f * hs[i]), 0.f, (float)infer_img_height);
+            proposals.push_back(box, best[i], label[i]);
         }
     }
-    objects = detections;
+}
+
+void parse_yolov_detections(
+                                   float* inputs, float confidence_threshold,
+                                   int num_channels, int num_anchors, int num_labels,
+                                   int infer_img_width, int infer_img_height,
+                                   std::vector<yolo::Object>& objects)
+{
+    BoxSet proposals;
+    parse_yolov_detections(inputs, confidence_threshold, num_channels, num_anchors, num_labels,
+                           infer_img_width, infer_img_height, proposals);
+    objects.resize(proposals.size());
+    for (size_t i = 0; i < proposals.size(); i++)
+    {
+        Box2f box = proposals.box(i);
+        objects[i].rect = cv::Rect_<float>(box.x0, box.y0, box.width(), box.height());
+        objects[i].label = proposals.classId[i];
+        objects[i].prob = proposals.score[i];
+    }
 }
 
 
-void detect(const DetectorClassInfo classInfo, ncnn::Net& yoloModel, const cv::Mat& input, std::vector<BoxInfo>& results) {
-    const int target_size = 640;
-    const float prob_threshold = PROB_THRESHOLD;
-    const float nms_threshold = 0.45f;
-    
-    int img_w = input.cols;
-    int img_h = input.rows;
-    
-    // letterbox pad to multiple of MAX_STRIDE
-    int w = img_w;
-    int h = img_h;
+// Size of the resized image inside the letterbox and its scale.
+static float letterbox_size(int img_w, int img_h, int target_size, int& w, int& h) {
+    w = img_w;
+    h = img_h;
     float scale = 1.f;
     if (w > h)
     {
@@ -181,74 +264,202 @@ void detect(const DetectorClassInfo classInfo, ncnn::Net& yoloModel, const cv::M
         h = target_size;
         w = w * scale;
     }
+    return scale;
+}
+
+// Pads the resized RGB image to a multiple of MAX_STRIDE and normalizes it.
+static void letterbox_pad(const ncnn::Mat& in, int target_size, float scale, int img_w, int img_h, Letterbox& lb,
+                          ncnn::Allocator* allocator) {
+    int wpad = (target_size + MAX_STRIDE - 1) / MAX_STRIDE * MAX_STRIDE - in.w;
+    int hpad = (target_size + MAX_STRIDE - 1) / MAX_STRIDE * MAX_STRIDE - in.h;
     
-    ncnn::Mat in = ncnn::Mat::from_pixels_resize(input.data, ncnn::Mat::PIXEL_BGR2RGB, img_w, img_h, w, h);
-    int wpad = (target_size + MAX_STRIDE - 1) / MAX_STRIDE * MAX_STRIDE - w;
-    int hpad = (target_size + MAX_STRIDE - 1) / MAX_STRIDE * MAX_STRIDE - h;
-    
-    ncnn::Mat in_pad;
-    ncnn::copy_make_border(in, in_pad, hpad / 2, hpad - hpad / 2, wpad / 2, wpad - wpad / 2, ncnn::BORDER_CONSTANT, 114.f);
+    ncnn::Option opt;
+    opt.blob_allocator = allocator;
+    ncnn::copy_make_border(in, lb.in_pad, hpad / 2, hpad - hpad / 2, wpad / 2, wpad - wpad / 2, ncnn::BORDER_CONSTANT, 114.f, opt);
     
     const float norm_vals[3] = {1 / 255.f, 1 / 255.f, 1 / 255.f};
-    in_pad.substract_mean_normalize(0, norm_vals);
+    lb.in_pad.substract_mean_normalize(0, norm_vals);
     
-    ncnn::Extractor ex = yoloModel.create_extractor();
+    lb.scale = scale;
+    lb.wpad = wpad;
+    lb.hpad = hpad;
+    lb.img_w = img_w;
+    lb.img_h = img_h;
+}
+
+void letterbox(const cv::Mat& input, int target_size, Letterbox& lb, ncnn::Allocator* allocator) {
+    int img_w = input.cols;
+    int img_h = input.rows;
     
+    // letterbox pad to multiple of MAX_STRIDE
+    int w, h;
+    float scale = letterbox_size(img_w, img_h, target_size, w, h);
     
-    // Input 3 in_pad's result
-    ex.input("in0", in_pad);
+    // The stride lets ROI views (tiles) through without a copy.
+    ncnn::Mat in = ncnn::Mat::from_pixels_resize(input.data, ncnn::Mat::PIXEL_BGR2RGB, img_w, img_h, int(input.step), w, h, allocator);
+    letterbox_pad(in, target_size, scale, img_w, img_h, lb, allocator);
+}
+
+void letterbox(const YuvFrame& input, int target_size, Letterbox& lb, ncnn::Allocator* allocator) {
+    int img_w = input.width;
+    int img_h = input.height;
     
-    std::vector<yolo::Object> objects;
-    std::vector<yolo::Object> proposals;
+    // The planes are resized first and only the small image is converted
+    // to RGB. 4:2:0 needs an even size.
+    int w, h;
+    float scale = letterbox_size(img_w, img_h, target_size, w, h);
+    w &= ~1;
+    h &= ~1;
     
-    // stride 32
+    std::vector<unsigned char> yuv(size_t(w) * h * 3 / 2);
+    const unsigned char* src = input.data.data;
+    if (input.format == YuvFormat::NV12)
     {
-        ncnn::Mat out;
-        ex.extract("out0", out, 0);
-        
-        std::vector<yolo::Object> objects32;
-        parse_yolov_detections(
-                               (float*)out.data, float(prob_threshold),
-                               int(out.h), int(out.w), int(classInfo.numClasses),
-                               int(in_pad.w), int(in_pad.h),
-                               objects32);
-        proposals.insert(proposals.end(), objects32.begin(), objects32.end());
+        ncnn::resize_bilinear_yuv420sp(src, img_w, img_h, yuv.data(), w, h);
+    }
+    else
+    {
+        // I420: resize the three planes, then interleave U and V into NV12.
+        const int cw = w / 2;
+        const int ch = h / 2;
+        const unsigned char* u = src + size_t(img_w) * img_h;
+        const unsigned char* v = u + size_t(img_w / 2) * (img_h / 2);
+        std::vector<unsigned char> uv(size_t(cw) * ch * 2);
+        ncnn::resize_bilinear_c1(src, img_w, img_h, yuv.data(), w, h);
+        ncnn::resize_bilinear_c1(u, img_w / 2, img_h / 2, uv.data(), cw, ch);
+        ncnn::resize_bilinear_c1(v, img_w / 2, img_h / 2, uv.data() + size_t(cw) * ch, cw, ch);
+        unsigned char* dst = yuv.data() + size_t(w) * h;
+        for (int i = 0; i < cw * ch; i++)
+        {
+            dst[2 * i] = uv[i];
+            dst[2 * i + 1] = uv[size_t(cw) * ch + i];
+        }
     }
     
-    qsort_descent_inplace(proposals);
+    std::vector<unsigned char> rgb(size_t(w) * h * 3);
+    ncnn::yuv420sp2rgb_nv12(yuv.data(), w, h, rgb.data());
+    ncnn::Mat in = ncnn::Mat::from_pixels(rgb.data(), ncnn::Mat::PIXEL_RGB, w, h, allocator);
+    letterbox_pad(in, target_size, scale, img_w, img_h, lb, allocator);
+}
+
+void decode_detections(const DetectorClassInfo& classInfo, const ncnn::Mat& out, const Letterbox& lb,
+                       float prob_threshold, float nms_threshold, BoxSet& results) {
+    BoxSet proposals;
+    parse_yolov_detections(
+                           (const float*)out.data, float(prob_threshold),
+                           int(out.h), int(out.w), int(classInfo.numClasses),
+                           int(lb.in_pad.w), int(lb.in_pad.h),
+                           proposals);
+    select_detections(classInfo, proposals, lb, nms_threshold, results);
+}
+
+void select_detections(const DetectorClassInfo& classInfo, BoxSet& proposals, const Letterbox& lb,
+                       float nms_threshold, BoxSet& results) {
+    proposals.sortByScore();
     
     std::vector<int> picked;
-    nms_sorted_bboxes(proposals, picked, nms_threshold);
+    nms_sorted_boxes(proposals, picked, nms_threshold);
     
-    objects.resize(picked.size());
+    for (int i : picked)
+    {
+        if (classInfo.targetLabels.find(proposals.classId[i]) == classInfo.targetLabels.end())
+            continue;
+        
+        // adjust offset to original unpadded
+        Box2f box;
+        box.x0 = (proposals.x0[i] - (lb.wpad / 2)) / lb.scale;
+        box.y0 = (proposals.y0[i] - (lb.hpad / 2)) / lb.scale;
+        box.x1 = (proposals.x1[i] - (lb.wpad / 2)) / lb.scale;
+        box.y1 = (proposals.y1[i] - (lb.hpad / 2)) / lb.scale;
+        
+        // clip
+        box.x0 = std::max(std::min(box.x0, (float)(lb.img_w - 1)), 0.f);
+        box.y0 = std::max(std::min(box.y0, (float)(lb.img_h - 1)), 0.f);
+        box.x1 = std::max(std::min(box.x1, (float)(lb.img_w - 1)), 0.f);
+        box.y1 = std::max(std::min(box.y1, (float)(lb.img_h - 1)), 0.f);
+        
+        results.push_back(box, proposals.score[i], proposals.classId[i]);
+    }
+}
+
+void decode_detections(const DetectorClassInfo& classInfo, const ncnn::Mat& out, const Letterbox& lb,
+                       float prob_threshold, float nms_threshold, std::vector<BoxInfo>& results) {
+    BoxSet boxes;
+    decode_detections(classInfo, out, lb, prob_threshold, nms_threshold, boxes);
+    boxes.appendTo(results);
+}
+
+static ncnn::Extractor create_extractor(const ncnn::Net& yoloModel, const ExtractorAllocators& allocators) {
+    ncnn::Extractor ex = yoloModel.create_extractor();
+    ex.set_blob_allocator(allocators.blob);
+    ex.set_workspace_allocator(allocators.workspace);
+    return ex;
+}
+
+// Inference and decoding for an already preprocessed frame.
+static void detect_letterboxed(const DetectorClassInfo& classInfo, ncnn::Net& yoloModel, const Letterbox& lb, std::vector<BoxInfo>& results,
+                               const ExtractorAllocators& allocators) {
+    static metrics::LatencyHistogram& inferenceLatency = metrics::registry().histogram("inference");
+    static metrics::LatencyHistogram& postprocessLatency = metrics::registry().histogram("postprocess");
+    static metrics::Counter& detectionCount = metrics::registry().counter("detections");
     
-    for (int i = 0; i < picked.size(); i++)
+    // With YoloDecode in the graph the net returns candidate rows, not out0.
+    const bool fused = has_fused_decode(yoloModel);
+    ncnn::Mat out;
     {
-        if (classInfo.targetLabels.find(proposals[picked[i]].label) != classInfo.targetLabels.end()) {
-            objects[i] = proposals[picked[i]];
-            // adjust offset to original unpadded
-            float x0 = (objects[i].rect.x - (wpad / 2)) / scale;
-            float y0 = (objects[i].rect.y - (hpad / 2)) / scale;
-            float x1 = (objects[i].rect.x + objects[i].rect.width - (wpad / 2)) / scale;
-            float y1 = (objects[i].rect.y + objects[i].rect.height - (hpad / 2)) / scale;
-            
-            // clip
-            x0 = std::max(std::min(x0, (float)(img_w - 1)), 0.f);
-            y0 = std::max(std::min(y0, (float)(img_h - 1)), 0.f);
-            x1 = std::max(std::min(x1, (float)(img_w - 1)), 0.f);
-            y1 = std::max(std::min(y1, (float)(img_h - 1)), 0.f);
-            
-            objects[i].rect.x = x0;
-            objects[i].rect.y = y0;
-            objects[i].rect.width = x1 - x0;
-            objects[i].rect.height = y1 - y0;
-            
-            results.push_back(BoxInfo(-1, objects[i].label, objects[i].prob, BBox(x0, y0, x1-x0, y1-y0)));
-        }
+        metrics::ScopedTimer timer(inferenceLatency);
+        ncnn::Extractor ex = create_extractor(yoloModel, allocators);
+        
+        // Input 3 in_pad's result
+        ex.input("in0", lb.in_pad);
+        ex.extract(fused ? DECODE_OUTPUT : "out0", out, 0);
+    }
+    
+    size_t numResults = results.size();
+    {
+        metrics::ScopedTimer timer(postprocessLatency);
+        if (fused)
+            decode_candidates(classInfo, out, lb, NMS_THRESHOLD, results);
+        else
+            decode_detections(classInfo, out, lb, PROB_THRESHOLD, NMS_THRESHOLD, results);
     }
+    detectionCount.add(results.size() - numResults);
+}
+
+void detect(const DetectorClassInfo classInfo, ncnn::Net& yoloModel, const cv::Mat& input, std::vector<BoxInfo>& results,
+            const ExtractorAllocators& allocators) {
+    static metrics::LatencyHistogram& preprocessLatency = metrics::registry().histogram("preprocess");
+    
+    Letterbox lb;
+    {
+        metrics::ScopedTimer timer(preprocessLatency);
+        letterbox(input, TARGET_SIZE, lb, allocators.blob);
+    }
+    detect_letterboxed(classInfo, yoloModel, lb, results, allocators);
+}
+
+void detect(const DetectorClassInfo classInfo, ncnn::Net& yoloModel, const YuvFrame& input, std::vector<BoxInfo>& results,
+            const ExtractorAllocators& allocators) {
+    static metrics::LatencyHistogram& preprocessLatency = metrics::registry().histogram("preprocess");
+    
+    Letterbox lb;
+    {
+        metrics::ScopedTimer timer(preprocessLatency);
+        letterbox(input, TARGET_SIZE, lb, allocators.blob);
+    }
+    detect_letterboxed(classInfo, yoloModel, lb, results, allocators);
 }
 
 
+void warm_up(ncnn::Net& yoloModel, int target_size, const ExtractorAllocators& allocators) {
+    Letterbox lb;
+    letterbox(cv::Mat(target_size, target_size, CV_8UC3, cv::Scalar(114, 114, 114)), target_size, lb, allocators.blob);
+    
+    ncnn::Mat out;
+    ncnn::Extractor ex = create_extractor(yoloModel, allocators);
+    ex.input("in0", lb.in_pad);
+    ex.extract(has_fused_decode(yoloModel) ? DECODE_OUTPUT : "out0", out, 0);
+}
 
 void draw_objects(const cv::Mat& image, const std::vector<Object>& objects, FILE* log_file, int frame_idx)
 {
@@ -275,6 +486,10 @@ void draw_objects(const cv::Mat& image, const std::vector<Object>& objects, FILE
         {139, 125, 96}
     };
     
+    static const TextStyle labelStyle = {cv::FONT_HERSHEY_SIMPLEX, 0.5, 1, 0};
+    OverlayRenderer& renderer = OverlayRenderer::shared();
+    cv::Mat canvas = image;
+    
     int color_index = 0;
     
     for (size_t i = 0; i < objects.size(); i++)
@@ -290,10 +505,10 @@ void draw_objects(const cv::Mat& image, const std::vector<Object>& objects, FILE
         cv::rectangle(image, obj.rect, cc, 2);
         
         char text[256];
-        sprintf(text, "%s %.1f%% (%.0f, %.0f) ", class_names[obj.label], obj.prob * 100, obj.rect.x, obj.rect.y);
+        snprintf(text, sizeof(text), "%s %.1f%% (%.0f, %.0f) ", class_names[obj.label], obj.prob * 100, obj.rect.x, obj.rect.y);
         
         int baseLine = 0;
-        cv::Size label_size = cv::getTextSize(text, cv::FONT_HERSHEY_SIMPLEX, 0.5, 1, &baseLine);
+        cv::Size label_size = renderer.measure(text, labelStyle, &baseLine);
         
         int x = obj.rect.x;
         int y = obj.rect.y - label_size.height - baseLine;
@@ -305,8 +520,7 @@ void draw_objects(const cv::Mat& image, const std::vector<Object>& objects, FILE
         cv::rectangle(image, cv::Rect(cv::Point(x, y), cv::Size(label_size.width, label_size.height + baseLine)),
                       cc, -1);
         
-        cv::putText(image, text, cv::Point(x, y + label_size.height),
-                    cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(255, 255, 255));
+        renderer.drawText(canvas, text, cv::Point(x, y + label_size.height), labelStyle, cv::Scalar(255, 255, 255));
         
     }
     cv::imshow("image", image);
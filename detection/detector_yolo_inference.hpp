@@ -19,8 +19,10 @@
 #include <unordered_set>
 #include <stdio.h>
 #include <cstdio>
+#include "box_set.h"
 #include "boxinfo.h"
 #include "detector_class_info.h"
+#include "yuv_frame.h"
 
 #define MAX_STRIDE 32
 
@@ -28,6 +30,8 @@
 #define HORSE_ID 17
 
 #define PROB_THRESHOLD 0.5
+#define NMS_THRESHOLD 0.45f
+#define TARGET_SIZE 640
 
 static const char* class_names[] = {
     "person", "bicycle", "car", "motorcycle", "airplane", "bus", "train", "truck", "boat", "traffic light",
@@ -51,6 +55,25 @@ struct Object
     float prob;
 };
 
+// Network input built from a frame, plus what is needed to map boxes back.
+struct Letterbox
+{
+    ncnn::Mat in_pad;
+    float scale = 1.f;
+    int wpad = 0;
+    int hpad = 0;
+    int img_w = 0;
+    int img_h = 0;
+};
+
+// Where the network input and the extractor's blobs and scratch space are
+// allocated; null falls back to ncnn's default (plain malloc/free).
+struct ExtractorAllocators
+{
+    ncnn::Allocator* blob = nullptr;
+    ncnn::Allocator* workspace = nullptr;
+};
+
 float intersection_area(const yolo::Object& a, const yolo::Object& b);
 
 void qsort_descent_inplace(std::vector<yolo::Object>& objects, int left, int right);
@@ -59,6 +82,10 @@ void qsort_descent_inplace(std::vector<yolo::Object>& objects);
 
 void nms_sorted_bboxes(const std::vector<yolo::Object>& faceobjects, std::vector<int>& picked, float nms_threshold, bool agnostic = false);
 
+// BoxSet versions, used by decode_detections(); the Object versions above
+// are kept for existing callers.
+void nms_sorted_boxes(const BoxSet& boxes, std::vector<int>& picked, float nms_threshold, bool agnostic = false);
+
 float sigmoid(float x);
 
 float clampf(float d, float min, float max);
@@ -69,9 +96,40 @@ void parse_yolov_detections(
     int infer_img_width, int infer_img_height,
                                    std::vector<yolo::Object>& objects);
 
+void parse_yolov_detections(
+    const float* inputs, float confidence_threshold,
+    int num_channels, int num_anchors, int num_labels,
+    int infer_img_width, int infer_img_height,
+    BoxSet& proposals);
+
+void letterbox(const cv::Mat& input, int target_size, Letterbox& lb, ncnn::Allocator* allocator = nullptr);
+
+void letterbox(const YuvFrame& input, int target_size, Letterbox& lb, ncnn::Allocator* allocator = nullptr);
+
+void decode_detections(const DetectorClassInfo& classInfo, const ncnn::Mat& out, const Letterbox& lb,
+                       float prob_threshold, float nms_threshold, BoxSet& results);
+// The part of decoding after the scan of out0: sorts and suppresses
+// `proposals` (letterbox coordinates), keeps the target labels and maps
+// them back to the frame.
+void select_detections(const DetectorClassInfo& classInfo, BoxSet& proposals, const Letterbox& lb,
+                       float nms_threshold, BoxSet& results);
+void decode_detections(const DetectorClassInfo& classInfo, const ncnn::Mat& out, const Letterbox& lb,
+                       float prob_threshold, float nms_threshold, std::vector<BoxInfo>& results);
+
 void detect(const DetectorClassInfo classInfo,
             ncnn::Net& yoloModel, const cv::Mat& input,
-            std::vector<BoxInfo>& results);
+            std::vector<BoxInfo>& results,
+            const ExtractorAllocators& allocators = ExtractorAllocators());
+void detect(const DetectorClassInfo classInfo,
+            ncnn::Net& yoloModel, const YuvFrame& input,
+            std::vector<BoxInfo>& results,
+            const ExtractorAllocators& allocators = ExtractorAllocators());
+// One inference on a blank frame, outside the metrics. Letterboxing pads
+// every frame to target_size², so this is the only input shape; the first
+// real frame then finds the pipelines, blob sizes and the calling thread's
+// OpenMP team already set up.
+void warm_up(ncnn::Net& yoloModel, int target_size = TARGET_SIZE,
+             const ExtractorAllocators& allocators = ExtractorAllocators());
 void draw_objects(const cv::Mat& image, const std::vector<yolo::Object>& objects, FILE* log_file, int frame_idx);
 }
 
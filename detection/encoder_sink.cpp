@@ -0,0 +1,202 @@
+//
+//  encoder_sink.cpp
+//  Inference
+//
+
+#include "encoder_sink.h"
+
+#include <chrono>
+#include <iostream>
+
+#include "metrics.h"
+
+EncoderSink::EncoderSink(const std::string& path, double fps, cv::Size frameSize,
+                         const EncoderSinkOptions& options)
+    : options(options)
+{
+    this->options.queueSize = std::max(1, options.queueSize);
+
+    if (options.mode == OutputMode::Video) {
+        const std::string& code = options.fourcc.size() == 4 ? options.fourcc : std::string("mp4v");
+        opened = writer.open(path, cv::VideoWriter::fourcc(code[0], code[1], code[2], code[3]), fps, frameSize);
+        if (!opened)
+            std::cerr << "Unable to open video writer: " << path << " (" << code << ")" << std::endl;
+        else if (options.quality >= 0)
+            writer.set(cv::VIDEOWRITER_PROP_QUALITY, options.quality);
+    }
+
+    std::string annotationPath = options.annotationPath;
+    if (annotationPath.empty() && options.mode == OutputMode::AnnotationsOnly)
+        annotationPath = path.substr(0, path.find_last_of('.')) + "." + options.annotationFormat;
+    auto hasExtension = [&annotationPath](const std::string& ext) {
+        return annotationPath.size() >= ext.size() &&
+            annotationPath.compare(annotationPath.size() - ext.size(), ext.size(), ext) == 0;
+    };
+
+    if (hasExtension(".csv")) {
+        annotations.open(annotationPath);
+        if (!annotations.is_open()) {
+            std::cerr << "Unable to open annotation file: " << annotationPath << std::endl;
+            opened = false;
+        } else {
+            annotations << "frame,x,y,width,height,tracked\n";
+            if (options.mode == OutputMode::AnnotationsOnly)
+                opened = true;
+        }
+    } else if (!annotationPath.empty()) {
+        try {
+            if (hasExtension(".ndjson") || hasExtension(".jsonl"))
+                ndjson = std::make_unique<NdjsonWriter>(annotationPath);
+            else
+                trackLog = std::make_unique<TrackLogWriter>(annotationPath, TrackLogMode::Truncate);
+            if (options.mode == OutputMode::AnnotationsOnly)
+                opened = true;
+        } catch (const std::exception& e) {
+            std::cerr << "Unable to open annotation file: " << e.what() << std::endl;
+            opened = false;
+        }
+    }
+
+    thread = std::thread(&EncoderSink::run, this);
+}
+
+EncoderSink::~EncoderSink()
+{
+    close();
+}
+
+OutputMode EncoderSink::parseMode(const std::string& name)
+{
+    return name == "annotations" ? OutputMode::AnnotationsOnly : OutputMode::Video;
+}
+
+void EncoderSink::write(cv::Mat& frame, const TrackRecord& record)
+{
+    static metrics::LatencyHistogram& waitLatency = metrics::registry().histogram("encode_queue_wait");
+    static metrics::Counter& droppedFrames = metrics::registry().counter("frames_dropped_encoder");
+
+    Item item;
+    item.record = record;
+    item.timestampUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    if (needsFrames())
+        item.frame = frame;
+
+    auto t0 = std::chrono::steady_clock::now();
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if ((int)queue.size() >= options.queueSize) {
+            if (options.dropWhenFull) {
+                stats.dropped++;
+                droppedFrames.add();
+                return;
+            }
+            notFull.wait(lock, [this] { return stopping || (int)queue.size() < options.queueSize; });
+        }
+        if (stopping)
+            return;
+
+        queue.push_back(std::move(item));
+        stats.maxQueued = std::max(stats.maxQueued, queue.size());
+        stats.maxHeldBytes = std::max(stats.maxHeldBytes, heldBytes());
+        if (needsFrames()) {
+            frame.release();
+            if (!spareFrames.empty()) {
+                frame = std::move(spareFrames.back());
+                spareFrames.pop_back();
+            }
+        }
+        auto waited = std::chrono::steady_clock::now() - t0;
+        stats.blockedMs += std::chrono::duration<double, std::milli>(waited).count();
+        waitLatency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count());
+    }
+    notEmpty.notify_one();
+}
+
+void EncoderSink::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping)
+            return;
+        stopping = true;
+    }
+    notEmpty.notify_all();
+    notFull.notify_all();
+    thread.join();
+
+    writer.release();
+    trackLog.reset();
+    ndjson.reset();
+    if (annotations.is_open())
+        annotations.close();
+}
+
+EncoderSinkStats EncoderSink::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+// Called with the mutex held.
+std::size_t EncoderSink::heldBytes() const
+{
+    std::size_t bytes = 0;
+    for (const Item& item : queue)
+        bytes += item.frame.total() * item.frame.elemSize();
+    for (const cv::Mat& frame : spareFrames)
+        bytes += frame.total() * frame.elemSize();
+    return bytes;
+}
+
+void EncoderSink::run()
+{
+    static metrics::LatencyHistogram& encodeLatency = metrics::registry().histogram("encode");
+
+    while (true) {
+        Item item;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            notEmpty.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty())
+                return;
+            item = std::move(queue.front());
+            queue.pop_front();
+        }
+        notFull.notify_one();
+
+        auto t0 = std::chrono::steady_clock::now();
+        if (!item.frame.empty() && writer.isOpened()) {
+            metrics::ScopedTimer timer(encodeLatency);
+            writer.write(item.frame);
+        }
+        if (trackLog || ndjson) {
+            // One target per stream: track 0, score 1 while tracked, 0 when lost.
+            TrackLogRecord r;
+            r.frameIndex = std::uint32_t(item.record.frameIndex);
+            r.timestampUs = item.timestampUs;
+            r.score = item.record.tracked ? 1.f : 0.f;
+            r.x = float(item.record.box.x);
+            r.y = float(item.record.box.y);
+            r.width = float(item.record.box.width);
+            r.height = float(item.record.box.height);
+            if (trackLog) trackLog->append(r);
+            if (ndjson) ndjson->write(r);
+        }
+        if (annotations.is_open()) {
+            const cv::Rect& box = item.record.box;
+            annotations << item.record.frameIndex << ',' << box.x << ',' << box.y << ','
+                        << box.width << ',' << box.height << ',' << int(item.record.tracked) << '\n';
+        }
+        auto t1 = std::chrono::steady_clock::now();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.frames++;
+        if (trackLog)
+            stats.annotationsDropped = trackLog->getDroppedCount();
+        stats.encodeMs += std::chrono::duration<double, std::milli>(t1 - t0).count();
+        // Hand the buffer back so the decoder does not allocate a new one.
+        if (!item.frame.empty() && (int)spareFrames.size() <= options.queueSize)
+            spareFrames.push_back(std::move(item.frame));
+    }
+}
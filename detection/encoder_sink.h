@@ -0,0 +1,113 @@
+//
+//  encoder_sink.h
+//  Inference
+//
+//  Output side of a stream. Frames and their track result are handed to a
+//  bounded queue and encoded on the sink's own thread, so the tracking loop
+//  only pays for the hand-off. In annotation-only mode no video is written
+//  at all, only the track results: a binary TrackLog by default, NDJSON for
+//  .ndjson/.jsonl paths, or CSV lines for .csv.
+//
+
+#ifndef encoder_sink_h
+#define encoder_sink_h
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "ndjson_results.h"
+#include "track_log.h"
+
+enum class OutputMode {
+    Video,              // encoded video, plus annotations if annotationPath is set
+    AnnotationsOnly     // track results only, frames are never encoded
+};
+
+struct EncoderSinkOptions {
+    OutputMode mode = OutputMode::Video;
+    std::string fourcc = "mp4v";    // e.g. "avc1", "MJPG"
+    double quality = -1.0;          // VIDEOWRITER_PROP_QUALITY 0..100, < 0 keeps the codec default
+    int queueSize = 8;              // frames waiting for the encoder
+    bool dropWhenFull = false;      // drop instead of blocking the producer
+    std::string annotationPath;     // .trk (TrackLog), .ndjson or .csv; derived from the video path in AnnotationsOnly mode; rewritten each run
+    std::string annotationFormat = "trk";   // extension of the derived path
+};
+
+// What a stream reports for one frame.
+struct TrackRecord {
+    int frameIndex = 0;
+    cv::Rect box;
+    bool tracked = false;
+};
+
+struct EncoderSinkStats {
+    std::size_t frames = 0;         // frames written (or annotated)
+    std::size_t dropped = 0;
+    std::size_t annotationsDropped = 0; // track log records out of frame order
+    std::size_t maxQueued = 0;
+    std::size_t maxHeldBytes = 0;   // frame buffers held at once, queued and spare
+    double encodeMs = 0.0;          // accumulated on the sink thread
+    double blockedMs = 0.0;         // accumulated producer wait on a full queue
+};
+
+class EncoderSink {
+public:
+    EncoderSink(const std::string& path, double fps, cv::Size frameSize,
+                const EncoderSinkOptions& options = EncoderSinkOptions());
+    ~EncoderSink();
+
+    EncoderSink(const EncoderSink&) = delete;
+    EncoderSink& operator=(const EncoderSink&) = delete;
+
+    bool isOpened() const { return opened; }
+    bool needsFrames() const { return options.mode == OutputMode::Video; }
+
+    // Takes over `frame`'s buffer, so the caller must not touch its pixels
+    // afterwards; `frame` is handed a spare buffer of an earlier frame (or
+    // left empty) for the next decode. The frame is ignored in
+    // AnnotationsOnly mode.
+    void write(cv::Mat& frame, const TrackRecord& record);
+
+    // Flushes the queue and closes the outputs; also done by the destructor.
+    void close();
+
+    EncoderSinkStats getStats() const;
+
+    static OutputMode parseMode(const std::string& name);
+
+private:
+    struct Item {
+        cv::Mat frame;
+        TrackRecord record;
+        std::int64_t timestampUs = 0;
+    };
+
+    void run();
+    std::size_t heldBytes() const;
+
+    EncoderSinkOptions options;
+    cv::VideoWriter writer;
+    std::ofstream annotations;
+    std::unique_ptr<TrackLogWriter> trackLog;
+    std::unique_ptr<NdjsonWriter> ndjson;
+    bool opened = false;
+
+    mutable std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::deque<Item> queue;
+    std::vector<cv::Mat> spareFrames;
+    bool stopping = false;
+    EncoderSinkStats stats;
+
+    std::thread thread;
+};
+
+#endif /* encoder_sink_h */
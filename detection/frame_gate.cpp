@@ -0,0 +1,80 @@
+//
+//  frame_gate.cpp
+//  Inference
+//
+
+#include "frame_gate.h"
+
+#include <cstdlib>
+
+FrameGate::FrameGate(const FrameGateOptions& options) : options(options)
+{
+}
+
+void FrameGate::computeSignature(const cv::Mat& frame, int gridWidth, int gridHeight, std::vector<uint8_t>& signature)
+{
+    signature.resize(size_t(gridWidth) * gridHeight);
+    const int channels = frame.channels();
+    const int maxX = std::max(0, frame.cols - 2);
+    const int maxY = std::max(0, frame.rows - 2);
+
+    for (int gy = 0; gy < gridHeight; gy++) {
+        const int y = std::min(maxY, (2 * gy + 1) * frame.rows / (2 * gridHeight));
+        const uint8_t* row0 = frame.ptr<uint8_t>(y);
+        const uint8_t* row1 = frame.ptr<uint8_t>(std::min(y + 1, frame.rows - 1));
+        uint8_t* out = &signature[size_t(gy) * gridWidth];
+
+        for (int gx = 0; gx < gridWidth; gx++) {
+            const int x = std::min(maxX, (2 * gx + 1) * frame.cols / (2 * gridWidth));
+            const int x1 = std::min(x + 1, frame.cols - 1);
+            int sum;
+            if (channels == 1) {
+                sum = row0[x] + row0[x1] + row1[x] + row1[x1];
+            } else {
+                // BT.601 luma, 8-bit fixed point: (29 B + 150 G + 77 R) >> 8
+                const uint8_t* p[4] = {row0 + x * channels, row0 + x1 * channels, row1 + x * channels, row1 + x1 * channels};
+                sum = 0;
+                for (const uint8_t* px : p)
+                    sum += (29 * px[0] + 150 * px[1] + 77 * px[2]) >> 8;
+            }
+            out[gx] = uint8_t(sum >> 2);
+        }
+    }
+}
+
+double FrameGate::meanAbsDiff(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b)
+{
+    if (a.empty() || a.size() != b.size())
+        return 255.0;
+    unsigned int sum = 0;
+    for (size_t i = 0; i < a.size(); i++)
+        sum += std::abs(int(a[i]) - int(b[i]));
+    return double(sum) / a.size();
+}
+
+bool FrameGate::update(const cv::Mat& frame)
+{
+    previous.swap(current);
+    computeSignature(frame, options.gridWidth, options.gridHeight, current);
+
+    frameDiff = previous.empty() ? 0.0 : meanAbsDiff(current, previous);
+    sceneCut = frameDiff > options.sceneCutThreshold;
+    return sceneCut;
+}
+
+bool FrameGate::shouldSkipDetection()
+{
+    if (reference.empty() || sceneCut || staticSkips >= options.maxStaticSkips)
+        return false;
+    if (meanAbsDiff(current, reference) > options.staticThreshold)
+        return false;
+
+    staticSkips++;
+    return true;
+}
+
+void FrameGate::markDetection()
+{
+    reference = current;
+    staticSkips = 0;
+}
@@ -0,0 +1,61 @@
+//
+//  frame_gate.h
+//  Inference
+//
+//  Cheap frame signature used to gate detection. A coarse grid of 2x2 luma
+//  samples (64x36 by default) is read straight from the frame, so the cost
+//  does not depend on the resolution (a few microseconds even at 4K). The
+//  signature answers two questions:
+//    - has the picture changed since the last detection? If not, the
+//      detection round can be skipped and its results reused;
+//    - is this a hard cut from the previous frame? Then detection must run
+//      now and the tracker has to be re-anchored.
+//
+
+#ifndef frame_gate_h
+#define frame_gate_h
+
+#include <cstdint>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+struct FrameGateOptions {
+    int gridWidth = 64;
+    int gridHeight = 36;
+    double staticThreshold = 1.5;     // mean abs luma diff to the last detected frame
+    double sceneCutThreshold = 40.0;  // mean abs luma diff to the previous frame
+    int maxStaticSkips = 6;           // detection rounds skipped in a row at most
+};
+
+class FrameGate {
+public:
+    explicit FrameGate(const FrameGateOptions& options = FrameGateOptions());
+
+    // Samples the frame (8-bit BGR or single-channel luma) and compares it
+    // with the previous one. Returns true on a scene cut.
+    bool update(const cv::Mat& frame);
+
+    // Call on a detection round: true if the picture is unchanged since the
+    // last detection, in which case the round counts as avoided.
+    bool shouldSkipDetection();
+
+    // The current frame becomes the reference for shouldSkipDetection().
+    void markDetection();
+
+    bool isSceneCut() const { return sceneCut; }
+    double getFrameDiff() const { return frameDiff; }
+
+    static void computeSignature(const cv::Mat& frame, int gridWidth, int gridHeight, std::vector<uint8_t>& signature);
+    static double meanAbsDiff(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b);
+
+private:
+    FrameGateOptions options;
+    std::vector<uint8_t> current;
+    std::vector<uint8_t> previous;
+    std::vector<uint8_t> reference;
+    bool sceneCut = false;
+    double frameDiff = 0.0;
+    int staticSkips = 0;
+};
+
+#endif /* frame_gate_h */
@@ -0,0 +1,71 @@
+//
+//  inference_allocator.cpp
+//  Inference
+//
+
+#include "inference_allocator.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "metrics.h"
+
+// ---- POOL ---- //
+CountingPoolAllocator::~CountingPoolAllocator()
+{
+    if (!live.empty())
+        std::cerr << "CountingPoolAllocator: " << live.size() << " blocks still in use at destruction\n";
+    for (const auto& block : freeBlocks)
+        ncnn::fastFree(block.second);
+    for (const auto& block : live)
+        ncnn::fastFree(block.first);
+}
+
+// Any free block large enough is reused, as in ncnn's benchncnn: the pool
+// then settles on one block per live blob instead of growing whenever a
+// smaller request would waste part of a large block.
+void* CountingPoolAllocator::fastMalloc(size_t size)
+{
+    static metrics::Counter& poolGrowth = metrics::registry().counter("inference_pool_system_allocations");
+
+    std::unique_lock<std::mutex> lock(mutex);
+    stats.allocations++;
+    stats.inUseBytes += size;
+    stats.peakBytes = std::max(stats.peakBytes, stats.inUseBytes);
+
+    auto it = freeBlocks.lower_bound(size);
+    if (it != freeBlocks.end()) {
+        void* ptr = it->second;
+        live[ptr] = {it->first, size};
+        freeBlocks.erase(it);
+        return ptr;
+    }
+    stats.systemAllocations++;
+    lock.unlock();
+
+    poolGrowth.add();
+    void* ptr = ncnn::fastMalloc(size);
+    lock.lock();
+    live[ptr] = {size, size};
+    return ptr;
+}
+
+void CountingPoolAllocator::fastFree(void* ptr)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = live.find(ptr);
+    if (it == live.end()) {
+        // Not from this pool; ncnn::Allocator implementations free it anyway.
+        ncnn::fastFree(ptr);
+        return;
+    }
+    stats.inUseBytes -= it->second.size;
+    freeBlocks.emplace(it->second.capacity, ptr);
+    live.erase(it);
+}
+
+AllocatorStats CountingPoolAllocator::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
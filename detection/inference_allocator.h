@@ -0,0 +1,81 @@
+//
+//  inference_allocator.h
+//  Inference
+//
+//  Per-worker ncnn allocators. Without them every extractor mallocs and
+//  frees its intermediate blobs on each inference; a pool keeps the blocks
+//  of the previous frame and hands them out again, so once a worker has
+//  seen its input shape, inference stops calling into the system
+//  allocator. The pool behaves like ncnn's PoolAllocator with a size
+//  compare ratio of 0 and no size drop, but makes the ncnn::fastMalloc
+//  calls itself, so it can count exactly how often it had to grow, along
+//  with its high-water mark.
+//
+
+#ifndef inference_allocator_h
+#define inference_allocator_h
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include "allocator.h"
+
+struct AllocatorStats {
+    std::size_t allocations = 0;        // fastMalloc calls
+    std::size_t systemAllocations = 0;  // calls no free block could serve, passed to ncnn::fastMalloc
+    std::size_t inUseBytes = 0;
+    std::size_t peakBytes = 0;          // high-water mark of inUseBytes
+};
+
+// A request takes the smallest free block large enough for it; only when
+// there is none is a new block allocated. Blocks go back to the system when
+// the pool is destroyed. Locked, since ncnn may free blobs from its OpenMP
+// threads; the lock is taken a few dozen times per inference and never
+// contended (one worker per pool).
+class CountingPoolAllocator : public ncnn::Allocator {
+public:
+    CountingPoolAllocator() = default;
+    ~CountingPoolAllocator() override;
+
+    CountingPoolAllocator(const CountingPoolAllocator&) = delete;
+    CountingPoolAllocator& operator=(const CountingPoolAllocator&) = delete;
+
+    void* fastMalloc(size_t size) override;
+    void fastFree(void* ptr) override;
+
+    AllocatorStats getStats() const;
+
+private:
+    struct Block {
+        std::size_t capacity;
+        std::size_t size;   // requested
+    };
+
+    mutable std::mutex mutex;
+    AllocatorStats stats;
+    std::multimap<std::size_t, void*> freeBlocks;  // by capacity
+    std::unordered_map<void*, Block> live;
+};
+
+// The blob and workspace allocators of one inference worker. Must outlive
+// every ncnn::Mat allocated through them.
+class WorkerAllocators {
+public:
+    WorkerAllocators() = default;
+
+    WorkerAllocators(const WorkerAllocators&) = delete;
+    WorkerAllocators& operator=(const WorkerAllocators&) = delete;
+
+    ncnn::Allocator* blob() { return &blobPool; }
+    ncnn::Allocator* workspace() { return &workspacePool; }
+
+    AllocatorStats getBlobStats() const { return blobPool.getStats(); }
+    AllocatorStats getWorkspaceStats() const { return workspacePool.getStats(); }
+
+private:
+    CountingPoolAllocator blobPool;
+    CountingPoolAllocator workspacePool;
+};
+
+#endif /* inference_allocator_h */
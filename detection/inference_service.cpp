@@ -0,0 +1,518 @@
+//
+//  inference_service.cpp
+//  Inference
+//
+
+#include "inference_service.h"
+
+#include <iomanip>
+#include <stdexcept>
+
+#include "memory_profile.h"
+#include "metrics.h"
+#include "thread_budget.h"
+#include "yolo_decode_layer.h"
+
+namespace yolo {
+
+InferenceService::InferenceService(const std::string& paramPath, const std::string& binPath,
+                                   const DetectorClassInfo& classInfo,
+                                   const InferenceServiceOptions& options)
+    : classInfo(classInfo), options(options), created(std::chrono::steady_clock::now())
+{
+    this->options.numWorkers = std::max(1, options.numWorkers);
+    this->options.numThreads = std::max(this->options.numWorkers, options.numThreads);
+
+    const std::size_t residentBefore = MemoryReport::processResidentBytes();
+    configureModel(yoloModel);
+    if (!loadModel(yoloModel, paramPath, binPath, yoloWeights))
+        throw std::runtime_error("Unable to load the detection model " + paramPath);
+
+    if (!options.lightParamPath.empty()) {
+        configureModel(lightModel);
+        lightModelLoaded = loadModel(lightModel, options.lightParamPath, options.lightBinPath, lightWeights);
+        if (!lightModelLoaded)
+            std::cout << "Cascade light model failed to load, running the main model only.\n";
+    }
+    startup.loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - created).count();
+    const std::size_t residentAfter = MemoryReport::processResidentBytes();
+    startup.modelBytes = residentAfter > residentBefore ? residentAfter - residentBefore : 0;
+
+    for (int i = 0; i < this->options.numWorkers; i++)
+        workerAllocators.push_back(std::make_unique<WorkerAllocators>());
+    for (int i = 0; i < this->options.numWorkers; i++)
+        workers.emplace_back(&InferenceService::workerLoop, this, i);
+
+    if (this->options.warmupRuns > 0 && !this->options.warmupInBackground) {
+        std::unique_lock<std::mutex> lock(statsMutex);
+        warmupCond.wait(lock, [this] { return warmedWorkers == this->options.numWorkers; });
+    }
+}
+
+InferenceService::~InferenceService()
+{
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueCond.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+}
+
+int InferenceService::registerStream(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+    InferenceStreamStats stats;
+    stats.name = name;
+    streamStats.push_back(stats);
+    return int(streamStats.size() - 1);
+}
+
+std::future<std::vector<BoxInfo>> InferenceService::submit(int streamId, const cv::Mat& frame)
+{
+    Request request;
+    request.streamId = streamId;
+    request.frame = frame;
+    return enqueue(std::move(request));
+}
+
+std::future<std::vector<BoxInfo>> InferenceService::submit(int streamId, const YuvFrame& frame)
+{
+    Request request;
+    request.streamId = streamId;
+    request.yuv = frame;
+    return enqueue(std::move(request));
+}
+
+std::future<std::vector<BoxInfo>> InferenceService::submit(int streamId, const cv::Mat& frame, const CascadeHint& hint)
+{
+    Request request;
+    request.streamId = streamId;
+    request.frame = frame;
+    request.cascade = true;
+    request.hint = hint;
+    return enqueue(std::move(request));
+}
+
+std::future<std::vector<BoxInfo>> InferenceService::submit(int streamId, const YuvFrame& frame, const CascadeHint& hint)
+{
+    Request request;
+    request.streamId = streamId;
+    request.yuv = frame;
+    request.cascade = true;
+    request.hint = hint;
+    return enqueue(std::move(request));
+}
+
+void InferenceService::submit(int streamId, const cv::Mat& frame, const CascadeHint& hint, DetectionCallback done)
+{
+    Request request;
+    request.streamId = streamId;
+    request.frame = frame;
+    request.cascade = true;
+    request.hint = hint;
+    request.done = std::move(done);
+    enqueue(std::move(request));
+}
+
+std::future<std::vector<BoxInfo>> InferenceService::enqueue(Request request)
+{
+    checkStream(request.streamId);
+    request.enqueued = std::chrono::steady_clock::now();
+    std::future<std::vector<BoxInfo>> result = request.promise.get_future();
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        queue.push_back(std::move(request));
+        // Counted before a worker wakes up, so this includes requests that
+        // are only queued for the time a free worker takes to pick them up.
+        std::lock_guard<std::mutex> statsLock(statsMutex);
+        maxQueued = std::max(maxQueued, queue.size());
+    }
+    queueCond.notify_one();
+    return result;
+}
+
+void InferenceService::detect(int streamId, const cv::Mat& frame, std::vector<BoxInfo>& results)
+{
+    std::vector<BoxInfo> detections = submit(streamId, frame).get();
+    results.insert(results.end(), detections.begin(), detections.end());
+}
+
+void InferenceService::detect(int streamId, const YuvFrame& frame, std::vector<BoxInfo>& results)
+{
+    std::vector<BoxInfo> detections = submit(streamId, frame).get();
+    results.insert(results.end(), detections.begin(), detections.end());
+}
+
+void InferenceService::detect(int streamId, const cv::Mat& frame, const CascadeHint& hint, std::vector<BoxInfo>& results)
+{
+    std::vector<BoxInfo> detections = submit(streamId, frame, hint).get();
+    results.insert(results.end(), detections.begin(), detections.end());
+}
+
+void InferenceService::detect(int streamId, const YuvFrame& frame, const CascadeHint& hint, std::vector<BoxInfo>& results)
+{
+    std::vector<BoxInfo> detections = submit(streamId, frame, hint).get();
+    results.insert(results.end(), detections.begin(), detections.end());
+}
+
+void InferenceService::detectTiled(int streamId, const cv::Mat& frame, const TileLayout& layout, std::vector<BoxInfo>& results)
+{
+    static metrics::Counter& tiledRounds = metrics::registry().counter("tiled_rounds");
+    static metrics::Counter& tileCount = metrics::registry().counter("tiles");
+
+    cv::Mat scaled = frame;
+    if (layout.scale > 0.f && layout.scale != 1.f) {
+        cv::Size size(std::max(1, cvRound(frame.cols * layout.scale)), std::max(1, cvRound(frame.rows * layout.scale)));
+        cv::resize(frame, scaled, size, 0, 0, layout.scale < 1.f ? cv::INTER_AREA : cv::INTER_LINEAR);
+    }
+    const std::vector<cv::Rect> tiles = tile_grid(scaled.size(), layout);
+    tiledRounds.add();
+    tileCount.add(tiles.size());
+
+    // Tiles are ROI views of `scaled`; each request holds a reference to it.
+    std::vector<std::future<std::vector<BoxInfo>>> pending;
+    pending.reserve(tiles.size() + 1);
+    if (layout.fullFrame)
+        pending.push_back(submit(streamId, frame));
+    for (const cv::Rect& tile : tiles)
+        pending.push_back(submit(streamId, scaled(tile)));
+
+    TileMerger merger(frame.size());
+    std::size_t next = 0;
+    if (layout.fullFrame)
+        merger.add(pending[next++].get());
+    for (const cv::Rect& tile : tiles)
+        merger.add(pending[next++].get(), tile, scaled.size());
+    merger.merge(results);
+}
+
+// Tiles are cut from the planes as compact 4:2:0 frames, so each request
+// converts just its tile to RGB after the letterbox resize and no full-size
+// BGR frame is made.
+void InferenceService::detectTiled(int streamId, const YuvFrame& frame, const TileLayout& layout, std::vector<BoxInfo>& results)
+{
+    static metrics::Counter& tiledRounds = metrics::registry().counter("tiled_rounds");
+    static metrics::Counter& tileCount = metrics::registry().counter("tiles");
+
+    YuvFrame scaled = frame;
+    if (layout.scale > 0.f && layout.scale != 1.f) {
+        cv::Size size(std::max(2, cvRound(frame.width * layout.scale)), std::max(2, cvRound(frame.height * layout.scale)));
+        frame.resize(size, scaled, layout.scale < 1.f ? cv::INTER_AREA : cv::INTER_LINEAR);
+    }
+    std::vector<cv::Rect> tiles = tile_grid(scaled.size(), layout);
+    tiledRounds.add();
+    tileCount.add(tiles.size());
+
+    std::vector<std::future<std::vector<BoxInfo>>> pending;
+    pending.reserve(tiles.size() + 1);
+    if (layout.fullFrame)
+        pending.push_back(submit(streamId, frame));
+    for (cv::Rect& tile : tiles) {
+        YuvFrame piece;
+        tile = scaled.crop(tile, piece);
+        pending.push_back(submit(streamId, piece));
+    }
+
+    TileMerger merger(frame.size());
+    std::size_t next = 0;
+    if (layout.fullFrame)
+        merger.add(pending[next++].get());
+    for (const cv::Rect& tile : tiles)
+        merger.add(pending[next++].get(), tile, scaled.size());
+    merger.merge(results);
+}
+
+void InferenceService::configureModel(ncnn::Net& model) const
+{
+    // Every extractor inherits this, so the service never uses more than
+    // numThreads cores in total.
+    model.opt.num_threads = options.numThreads / options.numWorkers;
+    if (!options.lowMemory)
+        return;
+    // Winograd F(6,3) turns each 3x3 kernel into 8x8 transformed weights;
+    // the sgemm path keeps them close to their stored size.
+    model.opt.lightmode = true;
+    model.opt.use_fp16_storage = true;
+    model.opt.use_fp16_packed = true;
+    model.opt.use_winograd_convolution = false;
+}
+
+bool InferenceService::loadParam(ncnn::Net& model, const std::string& paramPath)
+{
+    if (options.fusedDecode) {
+        yolo::DecodeLayerParams decode;
+        decode.numLabels = classInfo.numClasses;
+        if (yolo::load_param_with_decode(model, paramPath, decode) == 0)
+            return true;
+        std::cout << "Unable to append the decode layer to " << paramPath << ", decoding on the host.\n";
+        model.clear();
+    }
+    return model.load_param(paramPath.c_str()) == 0;
+}
+
+bool InferenceService::loadModel(ncnn::Net& model, const std::string& paramPath, const std::string& binPath, MappedFile& weights)
+{
+    if (!loadParam(model, paramPath))
+        return false;
+    if (!options.mapWeights)
+        return model.load_model(binPath.c_str()) == 0;
+
+    // fp32 weights are referenced from the mapping rather than copied; the
+    // layers that repack theirs at load time only read it once.
+    if (!weights.open(binPath)) {
+        std::cout << "Unable to map " << binPath << ", loading it instead.\n";
+        return model.load_model(binPath.c_str()) == 0;
+    }
+    return model.load_model(weights.getData()) == weights.getSize();
+}
+
+// Runs on each worker before its first request: the OpenMP team ncnn uses
+// belongs to the calling thread, so every worker warms up its own.
+void InferenceService::warmUp(const yolo::ExtractorAllocators& allocators)
+{
+    static metrics::LatencyHistogram& warmupLatency = metrics::registry().histogram("warmup");
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < options.warmupRuns; i++) {
+        metrics::ScopedTimer timer(warmupLatency);
+        yolo::warm_up(yoloModel, TARGET_SIZE, allocators);
+        if (lightModelLoaded)
+            yolo::warm_up(lightModel, TARGET_SIZE, allocators);
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+    {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        startup.warmupMs = std::max(startup.warmupMs, ms);
+        warmedWorkers++;
+    }
+    warmupCond.notify_all();
+}
+
+void InferenceService::workerLoop(int index)
+{
+    static metrics::Counter& failures = metrics::registry().counter("inference_failures");
+
+    // ncnn's OpenMP threads are created by this thread and inherit the mask.
+    if (!options.cpuAffinity.empty())
+        ThreadBudget::pinCurrentThread(options.cpuAffinity);
+    // The detection and decode regions outside ncnn get the same team size.
+    ThreadBudget::limitOpenMP(options.numThreads / options.numWorkers);
+
+    yolo::ExtractorAllocators allocators;
+    allocators.blob = workerAllocators[index]->blob();
+    allocators.workspace = workerAllocators[index]->workspace();
+    if (options.warmupRuns > 0)
+        warmUp(allocators);
+
+    while (true) {
+        // One request at a time: a worker that is free takes the oldest
+        // request right away, and the others stay with whoever is idle.
+        Request request;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueCond.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty())
+                return;
+            request = std::move(queue.front());
+            queue.pop_front();
+        }
+
+        auto t0 = std::chrono::steady_clock::now();
+        std::vector<BoxInfo> results;
+        try {
+            if (request.cascade && lightModelLoaded)
+                runCascade(request, allocators, results);
+            else
+                run(request, yoloModel, allocators, results);
+        } catch (...) {
+            failures.add();
+            if (request.done)
+                request.done({});
+            else
+                request.promise.set_exception(std::current_exception());
+            continue;
+        }
+        auto t1 = std::chrono::steady_clock::now();
+
+        {
+            std::lock_guard<std::mutex> lock(statsMutex);
+            InferenceStreamStats& stats = streamStats[request.streamId];
+            stats.requests++;
+            stats.detections += results.size();
+            stats.queueMs += std::chrono::duration<double, std::milli>(t0 - request.enqueued).count();
+            stats.inferenceMs += std::chrono::duration<double, std::milli>(t1 - t0).count();
+            if (startup.firstDetectionMs == 0.0) {
+                startup.firstDetectionMs = std::chrono::duration<double, std::milli>(t1 - created).count();
+                startup.firstInferenceMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+            }
+        }
+        if (request.done)
+            request.done(std::move(results));
+        else
+            request.promise.set_value(std::move(results));
+    }
+}
+
+void InferenceService::run(const Request& request, ncnn::Net& model, const yolo::ExtractorAllocators& allocators,
+                           std::vector<BoxInfo>& results)
+{
+    auto t0 = std::chrono::steady_clock::now();
+    if (!request.yuv.empty())
+        yolo::detect(classInfo, model, request.yuv, results, allocators);
+    else
+        yolo::detect(classInfo, model, request.frame, results, allocators);
+    if (&model != &yoloModel)
+        return;
+
+    // A running mean over the last ~64 runs, the baseline for the time the
+    // cascade saves.
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    std::lock_guard<std::mutex> lock(statsMutex);
+    fullModelRuns++;
+    fullModelMs += (ms - fullModelMs) / double(std::min<std::size_t>(fullModelRuns, 64));
+}
+
+void InferenceService::runCascade(const Request& request, const yolo::ExtractorAllocators& allocators, std::vector<BoxInfo>& results)
+{
+    static metrics::LatencyHistogram& lightLatency = metrics::registry().histogram("inference_light");
+    static metrics::Counter& rounds = metrics::registry().counter("cascade_rounds");
+    static metrics::Counter& escalations = metrics::registry().counter("cascade_escalations");
+
+    // A lost target escalates whatever the light model finds, so it is
+    // not run at all.
+    Escalation reason = cascade_escalation(request.hint);
+    double lightMs = 0.0;
+    if (reason == Escalation::None) {
+        auto t0 = std::chrono::steady_clock::now();
+        {
+            metrics::ScopedTimer timer(lightLatency);
+            run(request, lightModel, allocators, results);
+        }
+        lightMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        reason = cascade_escalation(results, request.hint, options.cascade);
+    }
+    rounds.add();
+    if (reason != Escalation::None) {
+        escalations.add();
+        results.clear();
+        run(request, yoloModel, allocators, results);
+    }
+
+    std::lock_guard<std::mutex> lock(statsMutex);
+    cascadeStats.rounds++;
+    cascadeStats.lightMs += lightMs;
+    switch (reason) {
+        case Escalation::None:
+            if (fullModelRuns > 0)
+                cascadeStats.savedMs += fullModelMs - lightMs;
+            return;
+        case Escalation::Recovery: cascadeStats.recovery++; break;
+        case Escalation::Disagreement: cascadeStats.disagreement++; break;
+        case Escalation::LowScore: cascadeStats.lowScore++; break;
+    }
+    cascadeStats.escalations++;
+    cascadeStats.savedMs -= lightMs;
+}
+
+InferenceStreamStats InferenceService::getStreamStats(int streamId) const
+{
+    checkStream(streamId);
+    std::lock_guard<std::mutex> lock(statsMutex);
+    return streamStats[streamId];
+}
+
+void InferenceService::checkStream(int streamId) const
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+    if (streamId < 0 || streamId >= int(streamStats.size()))
+        throw std::out_of_range("Unknown inference stream id " + std::to_string(streamId));
+}
+
+std::vector<InferenceStreamStats> InferenceService::getAllStreamStats() const
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+    return streamStats;
+}
+
+std::size_t InferenceService::getMaxQueued() const
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+    return maxQueued;
+}
+
+CascadeStats InferenceService::getCascadeStats() const
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+    return cascadeStats;
+}
+
+StartupStats InferenceService::getStartupStats() const
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+    return startup;
+}
+
+std::vector<WorkerAllocatorStats> InferenceService::getAllocatorStats() const
+{
+    std::vector<WorkerAllocatorStats> stats;
+    for (const auto& allocators : workerAllocators)
+        stats.push_back({allocators->getBlobStats(), allocators->getWorkspaceStats()});
+    return stats;
+}
+
+void InferenceService::printReport(std::ostream& os) const
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+
+    InferenceStreamStats total;
+    os << std::fixed << std::setprecision(2);
+    os << "[inference] workers=" << options.numWorkers
+       << " threads=" << options.numThreads << "\n";
+    for (const auto& stats : streamStats) {
+        double n = std::max<std::size_t>(stats.requests, 1);
+        os << "  " << stats.name
+           << ": requests=" << stats.requests
+           << " detections=" << stats.detections
+           << " avgQueueMs=" << stats.queueMs / n
+           << " avgInferMs=" << stats.inferenceMs / n << "\n";
+        total.requests += stats.requests;
+        total.detections += stats.detections;
+        total.queueMs += stats.queueMs;
+        total.inferenceMs += stats.inferenceMs;
+    }
+    double n = std::max<std::size_t>(total.requests, 1);
+    os << "  total: requests=" << total.requests
+       << " maxQueued=" << maxQueued
+       << " avgQueueMs=" << total.queueMs / n
+       << " avgInferMs=" << total.inferenceMs / n << "\n";
+    os << "  startup: loadMs=" << startup.loadMs
+       << " warmupMs=" << startup.warmupMs
+       << " firstDetectionMs=" << startup.firstDetectionMs
+       << " firstInferMs=" << startup.firstInferenceMs << "\n";
+    for (std::size_t i = 0; i < workerAllocators.size(); i++) {
+        const AllocatorStats blob = workerAllocators[i]->getBlobStats();
+        const AllocatorStats workspace = workerAllocators[i]->getWorkspaceStats();
+        os << "  worker " << i
+           << ": blobPeakMB=" << blob.peakBytes / 1048576.0
+           << " workspacePeakMB=" << workspace.peakBytes / 1048576.0
+           << " allocations=" << blob.allocations + workspace.allocations
+           << " systemAllocations=" << blob.systemAllocations + workspace.systemAllocations << "\n";
+    }
+    if (lightModelLoaded) {
+        const CascadeStats& cascade = cascadeStats;
+        os << "  cascade: rounds=" << cascade.rounds
+           << " escalations=" << cascade.escalations
+           << " rate=" << cascade.escalationRate()
+           << " (recovery=" << cascade.recovery
+           << " disagreement=" << cascade.disagreement
+           << " lowScore=" << cascade.lowScore << ")"
+           << " avgLightMs=" << cascade.lightMs / std::max<std::size_t>(cascade.rounds, 1)
+           << " avgFullMs=" << fullModelMs
+           << " savedMs=" << cascade.savedMs << "\n";
+    }
+}
+
+}
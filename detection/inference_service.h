@@ -0,0 +1,183 @@
+//
+//  inference_service.h
+//  Inference
+//
+//  One shared YOLO model serving detection requests from many streams.
+//  Each request goes to the next free one of a fixed number of worker
+//  threads and only waits in the queue while every worker is busy. The
+//  graph has no batch dimension, so holding requests back to group them
+//  would only add latency. Tiled detection submits every tile as its own
+//  request, so the tiles of one frame run on all free workers at once.
+//  With a light model configured, requests carrying a CascadeHint run it
+//  first and only escalate to the main model when the hint calls for it.
+//  Every worker warms the models up before it takes its first request, so
+//  the first frame does not pay for cold pipelines and thread start-up,
+//  and runs its extractors on its own pooled blob and workspace allocators.
+//  Both graphs are loaded with YoloDecode behind their output, so
+//  thresholding and box decoding happen inside the net.
+//
+
+#ifndef inference_service_h
+#define inference_service_h
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "detector_cascade.h"
+#include "detector_yolo_inference.hpp"
+#include "inference_allocator.h"
+#include "mapped_file.h"
+#include "tiled_detection.h"
+
+namespace yolo {
+
+struct InferenceServiceOptions {
+    int numThreads = 4;     // total CPU threads given to inference
+    int numWorkers = 1;     // concurrent extractors, each gets numThreads / numWorkers
+    std::string lightParamPath;     // cascade first stage; empty disables the cascade
+    std::string lightBinPath;
+    CascadeOptions cascade;
+    std::vector<int> cpuAffinity;   // budget cores the workers (and their ncnn threads) are pinned to
+    int warmupRuns = 1;             // blank inferences per worker and model before serving, 0 skips warm-up
+    bool warmupInBackground = false;    // return from the constructor while the workers warm up
+    bool mapWeights = false;        // use the .bin files in place from a memory map instead of copying them
+    bool lowMemory = false;         // fp16 weights and blobs, no winograd kernels (see MemoryProfile)
+    bool fusedDecode = true;        // append YoloDecode to the graphs, so only candidate rows leave the net
+};
+
+struct WorkerAllocatorStats {
+    AllocatorStats blob;
+    AllocatorStats workspace;
+};
+
+struct StartupStats {
+    double loadMs = 0.0;            // param and weight loading, both models
+    std::size_t modelBytes = 0;     // resident growth over the loading
+    double warmupMs = 0.0;          // slowest worker's warm-up
+    double firstDetectionMs = 0.0;  // construction to the first finished request, 0 until then
+    double firstInferenceMs = 0.0;  // the first request's own run time
+};
+
+struct InferenceStreamStats {
+    std::string name;
+    std::size_t requests = 0;
+    std::size_t detections = 0;
+    double queueMs = 0.0;      // accumulated time spent waiting for a free worker
+    double inferenceMs = 0.0;  // accumulated time spent in detect()
+};
+
+class InferenceService {
+public:
+    // Throws std::runtime_error if the main model cannot be loaded; a light
+    // model that fails to load only disables the cascade.
+    InferenceService(const std::string& paramPath, const std::string& binPath,
+                     const DetectorClassInfo& classInfo,
+                     const InferenceServiceOptions& options = InferenceServiceOptions());
+    ~InferenceService();
+
+    InferenceService(const InferenceService&) = delete;
+    InferenceService& operator=(const InferenceService&) = delete;
+
+    // Returns the id to pass to submit()/detect(). Requests with any other
+    // id throw std::out_of_range.
+    int registerStream(const std::string& name);
+
+    // The frame is shared, not copied: it must stay untouched until the
+    // future is ready.
+    std::future<std::vector<BoxInfo>> submit(int streamId, const cv::Mat& frame);
+    std::future<std::vector<BoxInfo>> submit(int streamId, const YuvFrame& frame);
+
+    // Cascaded requests: the light model first, the main model on escalation;
+    // a recovering hint goes straight to the main model. Without a light model these are the same as the plain overloads.
+    std::future<std::vector<BoxInfo>> submit(int streamId, const cv::Mat& frame, const CascadeHint& hint);
+    std::future<std::vector<BoxInfo>> submit(int streamId, const YuvFrame& frame, const CascadeHint& hint);
+
+    // Called on the inference worker with the request's detections (empty if
+    // it failed), so it should only hand them on, e.g. post a task to an
+    // executor. The caller never waits for inference.
+    using DetectionCallback = std::function<void(std::vector<BoxInfo>)>;
+    void submit(int streamId, const cv::Mat& frame, const CascadeHint& hint, DetectionCallback done);
+
+    void detect(int streamId, const cv::Mat& frame, std::vector<BoxInfo>& results);
+    void detect(int streamId, const YuvFrame& frame, std::vector<BoxInfo>& results);
+    void detect(int streamId, const cv::Mat& frame, const CascadeHint& hint, std::vector<BoxInfo>& results);
+    void detect(int streamId, const YuvFrame& frame, const CascadeHint& hint, std::vector<BoxInfo>& results);
+
+    // Sliced inference over the tiles of `layout`, merged across tiles.
+    void detectTiled(int streamId, const cv::Mat& frame, const TileLayout& layout, std::vector<BoxInfo>& results);
+    void detectTiled(int streamId, const YuvFrame& frame, const TileLayout& layout, std::vector<BoxInfo>& results);
+
+    InferenceStreamStats getStreamStats(int streamId) const;
+    std::vector<InferenceStreamStats> getAllStreamStats() const;
+    // Most requests that were waiting for a worker at once.
+    std::size_t getMaxQueued() const;
+    bool hasCascade() const { return lightModelLoaded; }
+    CascadeStats getCascadeStats() const;
+    StartupStats getStartupStats() const;
+    std::vector<WorkerAllocatorStats> getAllocatorStats() const;
+
+    void printReport(std::ostream& os) const;
+
+private:
+    struct Request {
+        int streamId;
+        cv::Mat frame;
+        YuvFrame yuv;       // used instead of frame when not empty
+        bool cascade = false;
+        CascadeHint hint;
+        std::promise<std::vector<BoxInfo>> promise;
+        DetectionCallback done;     // used instead of promise when set
+        std::chrono::steady_clock::time_point enqueued;
+    };
+
+    std::future<std::vector<BoxInfo>> enqueue(Request request);
+    void checkStream(int streamId) const;
+    void configureModel(ncnn::Net& model) const;
+    bool loadParam(ncnn::Net& model, const std::string& paramPath);
+    bool loadModel(ncnn::Net& model, const std::string& paramPath, const std::string& binPath, MappedFile& weights);
+    void warmUp(const yolo::ExtractorAllocators& allocators);
+    void workerLoop(int index);
+    void run(const Request& request, ncnn::Net& model, const yolo::ExtractorAllocators& allocators,
+             std::vector<BoxInfo>& results);
+    void runCascade(const Request& request, const yolo::ExtractorAllocators& allocators, std::vector<BoxInfo>& results);
+
+    // Declared before the nets, which may reference them until destroyed.
+    MappedFile yoloWeights;
+    MappedFile lightWeights;
+    ncnn::Net yoloModel;
+    ncnn::Net lightModel;
+    bool lightModelLoaded = false;
+    DetectorClassInfo classInfo;
+    InferenceServiceOptions options;
+
+    mutable std::mutex queueMutex;
+    std::condition_variable queueCond;
+    std::deque<Request> queue;
+    bool stopping = false;
+
+    mutable std::mutex statsMutex;
+    std::vector<InferenceStreamStats> streamStats;
+    std::size_t maxQueued = 0;
+    CascadeStats cascadeStats;
+    double fullModelMs = 0.0;   // running mean of the main model's latency
+    std::size_t fullModelRuns = 0;
+    std::chrono::steady_clock::time_point created;
+    StartupStats startup;
+    int warmedWorkers = 0;
+    std::condition_variable warmupCond;
+
+    std::vector<std::unique_ptr<WorkerAllocators>> workerAllocators;
+    std::vector<std::thread> workers;
+};
+
+}
+
+#endif /* inference_service_h */
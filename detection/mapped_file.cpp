@@ -0,0 +1,53 @@
+//
+//  mapped_file.cpp
+//  Inference
+//
+
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+    void* mapped = ::mmap(nullptr, std::size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+        return false;
+
+    data = static_cast<const unsigned char*>(mapped);
+    size = std::size_t(st.st_size);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (data)
+        ::munmap(const_cast<unsigned char*>(data), size);
+    data = nullptr;
+    size = 0;
+}
+
+void MappedFile::adviseSequential() const
+{
+    if (data)
+        ::madvise(const_cast<unsigned char*>(data), size, MADV_SEQUENTIAL);
+}
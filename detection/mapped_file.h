@@ -0,0 +1,41 @@
+//
+//  mapped_file.h
+//  Inference
+//
+//  Read-only memory map of a whole file. Pages are read on first touch and
+//  stay in the page cache across runs, so large inputs (model weights, raw
+//  video) are used in place instead of being copied into the heap.
+//
+
+#ifndef mapped_file_h
+#define mapped_file_h
+
+#include <cstddef>
+#include <string>
+
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // False if the file cannot be opened or mapped, or is empty. A mapped
+    // file is unmapped first.
+    bool open(const std::string& path);
+    void close();
+
+    // Tells the kernel the file will be read front to back.
+    void adviseSequential() const;
+
+    bool isOpen() const { return data != nullptr; }
+    const unsigned char* getData() const { return data; }
+    std::size_t getSize() const { return size; }
+
+private:
+    const unsigned char* data = nullptr;
+    std::size_t size = 0;
+};
+
+#endif /* mapped_file_h */
@@ -0,0 +1,91 @@
+//
+//  memory_profile.cpp
+//  Inference
+//
+
+#include "memory_profile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+#include <unistd.h>
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#endif
+
+MemoryProfile MemoryProfile::low()
+{
+    MemoryProfile profile;
+    profile.lowMemory = true;
+    profile.encoderQueueSize = 2;
+    return profile;
+}
+
+void MemoryProfile::apply(yolo::InferenceServiceOptions& inference, EncoderSinkOptions& output) const
+{
+    if (lowMemory) {
+        inference.lowMemory = true;
+        inference.mapWeights = true;
+    }
+    output.queueSize = std::min(output.queueSize, encoderQueueSize);
+}
+
+// ---- REPORT ---- //
+void MemoryReport::addShared(const yolo::InferenceService& service)
+{
+    modelBytes = service.getStartupStats().modelBytes;
+    inferenceBytes = 0;
+    for (const yolo::WorkerAllocatorStats& worker : service.getAllocatorStats())
+        inferenceBytes += worker.blob.peakBytes + worker.workspace.peakBytes;
+    residentBytes = processResidentBytes();
+}
+
+void MemoryReport::print(std::ostream& os) const
+{
+    const double MB = 1048576.0;
+    std::size_t streamBytes = 0;
+    for (const StreamMemory& stream : streams)
+        streamBytes += stream.total();
+    const std::size_t shared = modelBytes + inferenceBytes;
+
+    os << std::fixed << std::setprecision(1);
+    os << "[memory] residentMB=" << residentBytes / MB
+       << " modelMB=" << modelBytes / MB
+       << " inferenceMB=" << inferenceBytes / MB
+       << " streamsMB=" << streamBytes / MB << "\n";
+    for (const StreamMemory& stream : streams) {
+        os << "  " << stream.name
+           << ": frameMB=" << stream.frameBytes / MB
+           << " trackerMB=" << stream.trackerBytes / MB
+           << " encoderMB=" << stream.encoderBytes / MB
+           << " totalMB=" << stream.total() / MB << "\n";
+    }
+    // What the accounting does not see (codec state, OpenCV and ncnn
+    // internals) is charged to the streams evenly for the capacity figure.
+    if (!streams.empty() && residentBytes > shared) {
+        os << "  perStreamMB=" << (residentBytes - shared) / MB / streams.size()
+           << " (resident minus shared, over " << streams.size() << " streams)\n";
+    }
+}
+
+std::size_t MemoryReport::processResidentBytes()
+{
+#if defined(__linux__)
+    // statm: total and resident size, in pages.
+    unsigned long long totalPages = 0, residentPages = 0;
+    if (FILE* statm = std::fopen("/proc/self/statm", "r")) {
+        if (std::fscanf(statm, "%llu %llu", &totalPages, &residentPages) != 2)
+            residentPages = 0;
+        std::fclose(statm);
+    }
+    return std::size_t(residentPages) * std::size_t(sysconf(_SC_PAGESIZE));
+#elif defined(__APPLE__)
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS)
+        return 0;
+    return std::size_t(info.resident_size);
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,61 @@
+//
+//  memory_profile.h
+//  Inference
+//
+//  Memory settings for running many streams on one box, and the per-stream
+//  accounting that makes the stream capacity predictable. The low-memory
+//  profile stores the network in fp16 without winograd kernels (their
+//  transformed 3x3 weights are several times the raw ones), maps the
+//  weight file instead of copying it and keeps two frames in each encoder
+//  queue. It leaves CSRT at full resolution: its model is already capped by
+//  the template size, and a scaled frame would add memory rather than save
+//  it (see TrackerManager). The model itself is always shared:
+//  InferenceService holds one net for every stream.
+//
+
+#ifndef memory_profile_h
+#define memory_profile_h
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "encoder_sink.h"
+#include "inference_service.h"
+
+struct MemoryProfile {
+    bool lowMemory = false;
+    double trackerScale = 1.0;      // frame scale CSRT runs at
+    int encoderQueueSize = 8;       // frames waiting for the encoder, per stream
+
+    static MemoryProfile low();
+
+    void apply(yolo::InferenceServiceOptions& inference, EncoderSinkOptions& output) const;
+};
+
+// Bytes one stream holds, by component.
+struct StreamMemory {
+    std::string name;
+    std::size_t frameBytes = 0;     // decoded frame and BGR canvas
+    std::size_t trackerBytes = 0;   // CSRT input frame and filter state (estimated)
+    std::size_t encoderBytes = 0;   // encoder queue and spare buffers, at their peak
+
+    std::size_t total() const { return frameBytes + trackerBytes + encoderBytes; }
+};
+
+struct MemoryReport {
+    std::size_t modelBytes = 0;     // resident growth while the models loaded
+    std::size_t inferenceBytes = 0; // allocator pool peaks, all workers
+    std::size_t residentBytes = 0;  // whole process, when the report was taken
+    std::vector<StreamMemory> streams;
+
+    // Fills the shared part from the service and the process.
+    void addShared(const yolo::InferenceService& service);
+    void print(std::ostream& os) const;
+
+    // Resident set size of the process, 0 where unknown.
+    static std::size_t processResidentBytes();
+};
+
+#endif /* memory_profile_h */
@@ -0,0 +1,230 @@
+//
+//  metrics.cpp
+//  Inference
+//
+
+#include "metrics.h"
+
+#include <bit>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+namespace metrics {
+
+namespace {
+const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+const char* quantileNames[] = {"p50", "p90", "p99", "p999"};
+}
+
+// ---- HISTOGRAM ---- //
+int LatencyHistogram::bucketIndex(std::uint64_t ns)
+{
+    if (ns < SUB_BUCKETS)
+        return int(ns);
+    int exponent = std::bit_width(ns) - 1;
+    if (exponent > MAX_EXPONENT)
+        return BUCKET_COUNT - 1;
+    int sub = int((ns >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+    return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+std::uint64_t LatencyHistogram::bucketUpperBound(int index)
+{
+    if (index < SUB_BUCKETS)
+        return std::uint64_t(index);
+    int exponent = index / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+    int sub = index % SUB_BUCKETS;
+    int shift = exponent - SUB_BUCKET_BITS;
+    return ((std::uint64_t(SUB_BUCKETS + sub) << shift) + (std::uint64_t(1) << shift)) - 1;
+}
+
+void LatencyHistogram::record(std::int64_t ns)
+{
+    std::uint64_t value = ns > 0 ? std::uint64_t(ns) : 0;
+    buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    sumNs.fetch_add(value, std::memory_order_relaxed);
+
+    std::uint64_t prevMax = maxNs.load(std::memory_order_relaxed);
+    while (value > prevMax && !maxNs.compare_exchange_weak(prevMax, value, std::memory_order_relaxed)) {
+    }
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const
+{
+    Snapshot snap;
+    snap.buckets.resize(BUCKET_COUNT);
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        snap.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+        snap.count += snap.buckets[i];
+    }
+    // The count is the sum of the buckets read above, so percentiles stay
+    // consistent with them.
+    snap.sumNs = sumNs.load(std::memory_order_relaxed);
+    snap.maxNs = maxNs.load(std::memory_order_relaxed);
+    return snap;
+}
+
+void LatencyHistogram::reset()
+{
+    for (auto& bucket : buckets)
+        bucket.store(0, std::memory_order_relaxed);
+    sumNs.store(0, std::memory_order_relaxed);
+    maxNs.store(0, std::memory_order_relaxed);
+}
+
+std::uint64_t LatencyHistogram::Snapshot::percentileNs(double q) const
+{
+    if (count == 0)
+        return 0;
+    std::uint64_t rank = std::uint64_t(q * double(count - 1)) + 1;
+    std::uint64_t seen = 0;
+    for (int i = 0; i < int(buckets.size()); i++) {
+        seen += buckets[i];
+        if (seen >= rank)
+            return std::min(bucketUpperBound(i), maxNs);
+    }
+    return maxNs;
+}
+
+// ---- REGISTRY ---- //
+LatencyHistogram& MetricsRegistry::histogram(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& slot = histograms[name];
+    if (!slot)
+        slot = std::make_unique<LatencyHistogram>();
+    return *slot;
+}
+
+Counter& MetricsRegistry::counter(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& slot = counters[name];
+    if (!slot)
+        slot = std::make_unique<Counter>();
+    return *slot;
+}
+
+void MetricsRegistry::reset()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& entry : histograms)
+        entry.second->reset();
+    for (auto& entry : counters)
+        entry.second->reset();
+}
+
+void MetricsRegistry::writeJson(std::ostream& os) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+
+    os << "{\"timestamp_ms\":" << std::chrono::duration_cast<std::chrono::milliseconds>(now).count();
+    os << ",\"histograms\":{";
+    bool first = true;
+    for (const auto& entry : histograms) {
+        LatencyHistogram::Snapshot snap = entry.second->snapshot();
+        os << (first ? "" : ",") << "\"" << entry.first << "\":{"
+           << "\"count\":" << snap.count
+           << ",\"mean_ns\":" << std::uint64_t(snap.meanNs());
+        for (int i = 0; i < 4; i++)
+            os << ",\"" << quantileNames[i] << "_ns\":" << snap.percentileNs(quantiles[i]);
+        os << ",\"max_ns\":" << snap.maxNs << "}";
+        first = false;
+    }
+    os << "},\"counters\":{";
+    first = true;
+    for (const auto& entry : counters) {
+        os << (first ? "" : ",") << "\"" << entry.first << "\":" << entry.second->get();
+        first = false;
+    }
+    os << "}}\n";
+}
+
+void MetricsRegistry::writePrometheus(std::ostream& os) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ios_base::fmtflags flags = os.flags();
+    os << std::setprecision(9);
+
+    if (!histograms.empty())
+        os << "# TYPE ohtrack_stage_latency_seconds summary\n";
+    for (const auto& entry : histograms) {
+        LatencyHistogram::Snapshot snap = entry.second->snapshot();
+        const std::string label = "stage=\"" + entry.first + "\"";
+        for (double q : quantiles)
+            os << "ohtrack_stage_latency_seconds{" << label << ",quantile=\"" << q << "\"} "
+               << snap.percentileNs(q) / 1e9 << "\n";
+        os << "ohtrack_stage_latency_seconds_sum{" << label << "} " << snap.sumNs / 1e9 << "\n";
+        os << "ohtrack_stage_latency_seconds_count{" << label << "} " << snap.count << "\n";
+    }
+    for (const auto& entry : counters) {
+        os << "# TYPE ohtrack_" << entry.first << "_total counter\n";
+        os << "ohtrack_" << entry.first << "_total " << entry.second->get() << "\n";
+    }
+    os.flags(flags);
+}
+
+MetricsRegistry& registry()
+{
+    static MetricsRegistry instance;
+    return instance;
+}
+
+// ---- REPORTER ---- //
+MetricsReporter::MetricsReporter(MetricsRegistry& registry, const std::string& path, Format format,
+                                 std::chrono::milliseconds interval)
+    : metricsRegistry(registry), path(path), format(format), interval(interval)
+{
+    thread = std::thread(&MetricsReporter::run, this);
+}
+
+MetricsReporter::~MetricsReporter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cond.notify_all();
+    thread.join();
+    writeSnapshot();
+}
+
+MetricsReporter::Format MetricsReporter::formatForPath(const std::string& path)
+{
+    const std::string ext = ".prom";
+    if (path.size() >= ext.size() && path.compare(path.size() - ext.size(), ext.size(), ext) == 0)
+        return Format::Prometheus;
+    return Format::Json;
+}
+
+bool MetricsReporter::writeSnapshot()
+{
+    const std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream file(tmpPath);
+        if (!file.is_open()) {
+            std::cerr << "Unable to write metrics to " << tmpPath << std::endl;
+            return false;
+        }
+        if (format == Format::Prometheus)
+            metricsRegistry.writePrometheus(file);
+        else
+            metricsRegistry.writeJson(file);
+    }
+    return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+void MetricsReporter::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!cond.wait_for(lock, interval, [this] { return stopping; })) {
+        lock.unlock();
+        writeSnapshot();
+        lock.lock();
+    }
+}
+
+}
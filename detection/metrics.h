@@ -0,0 +1,143 @@
+//
+//  metrics.h
+//  Inference
+//
+//  Process-wide latency histograms and counters.
+//
+//  Recording is lock-free: look a metric up once (a function-local static
+//  reference is the usual pattern) and call record()/add() on it. The
+//  registry lock is only taken to create metrics and to take snapshots.
+//
+
+#ifndef metrics_h
+#define metrics_h
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace metrics {
+
+// HDR-style log-linear histogram over nanoseconds: values below 16 ns are
+// exact, above that every power of two is split into 16 sub-buckets, so the
+// relative error stays under 6.25% from 1 ns up to ~2000 s.
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BUCKET_BITS = 4;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr int MAX_EXPONENT = 40;
+    static constexpr int BUCKET_COUNT = (MAX_EXPONENT - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+
+    struct Snapshot {
+        std::uint64_t count = 0;
+        std::uint64_t sumNs = 0;
+        std::uint64_t maxNs = 0;
+        std::vector<std::uint64_t> buckets;
+
+        double meanNs() const { return count ? double(sumNs) / count : 0.0; }
+        std::uint64_t percentileNs(double q) const;
+    };
+
+    void record(std::int64_t ns);
+    Snapshot snapshot() const;
+    void reset();
+
+    static int bucketIndex(std::uint64_t ns);
+    static std::uint64_t bucketUpperBound(int index);
+
+private:
+    std::array<std::atomic<std::uint64_t>, BUCKET_COUNT> buckets{};
+    std::atomic<std::uint64_t> sumNs{0};
+    std::atomic<std::uint64_t> maxNs{0};
+};
+
+class Counter {
+public:
+    void add(std::uint64_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+    std::uint64_t get() const { return value.load(std::memory_order_relaxed); }
+    void reset() { value.store(0, std::memory_order_relaxed); }
+
+private:
+    std::atomic<std::uint64_t> value{0};
+};
+
+class ScopedTimer {
+public:
+    explicit ScopedTimer(LatencyHistogram& histogram)
+        : histogram(histogram), start(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() {
+        histogram.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    LatencyHistogram& histogram;
+    std::chrono::steady_clock::time_point start;
+};
+
+class MetricsRegistry {
+public:
+    // Returned references stay valid for the lifetime of the registry.
+    LatencyHistogram& histogram(const std::string& name);
+    Counter& counter(const std::string& name);
+
+    void writeJson(std::ostream& os) const;
+    void writePrometheus(std::ostream& os) const;
+    void reset();
+
+private:
+    mutable std::mutex mutex;
+    std::map<std::string, std::unique_ptr<LatencyHistogram>> histograms;
+    std::map<std::string, std::unique_ptr<Counter>> counters;
+};
+
+MetricsRegistry& registry();
+
+// Periodically writes a registry snapshot to a file (written to a temporary
+// file and renamed, so readers never see a partial snapshot). A final
+// snapshot is written on destruction.
+class MetricsReporter {
+public:
+    enum class Format { Json, Prometheus };
+
+    MetricsReporter(MetricsRegistry& registry, const std::string& path, Format format,
+                    std::chrono::milliseconds interval = std::chrono::seconds(5));
+    ~MetricsReporter();
+
+    MetricsReporter(const MetricsReporter&) = delete;
+    MetricsReporter& operator=(const MetricsReporter&) = delete;
+
+    bool writeSnapshot();
+
+    // ".prom" selects the Prometheus text format, anything else JSON.
+    static Format formatForPath(const std::string& path);
+
+private:
+    void run();
+
+    MetricsRegistry& metricsRegistry;
+    std::string path;
+    Format format;
+    std::chrono::milliseconds interval;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool stopping = false;
+    std::thread thread;
+};
+
+}
+
+#endif /* metrics_h */
@@ -0,0 +1,351 @@
+//
+//  ndjson_results.cpp
+//  Inference
+//
+
+#include "ndjson_results.h"
+
+#include <charconv>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+
+namespace {
+
+// ---- FORMATTING ---- //
+template <typename T>
+void appendNumber(std::vector<char>& out, T value)
+{
+    char buf[32];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value);
+    out.insert(out.end(), buf, result.ptr);
+}
+
+void appendLiteral(std::vector<char>& out, std::string_view text)
+{
+    out.insert(out.end(), text.begin(), text.end());
+}
+
+// ---- PARSING ---- //
+void skipSpace(const char*& p, const char* end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+        p++;
+}
+
+bool skipString(const char*& p, const char* end)
+{
+    for (p++; p < end; p++) {
+        if (*p == '\\')
+            p++;
+        else if (*p == '"') {
+            p++;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool skipValue(const char*& p, const char* end)
+{
+    if (p < end && *p == '"')
+        return skipString(p, end);
+    int depth = 0;
+    while (p < end) {
+        char c = *p;
+        if (c == '"') {
+            if (!skipString(p, end))
+                return false;
+            continue;
+        }
+        if (c == '{' || c == '[')
+            depth++;
+        else if (c == '}' || c == ']') {
+            if (depth == 0)
+                return true;
+            depth--;
+        } else if (c == ',' && depth == 0)
+            return true;
+        p++;
+    }
+    return depth == 0;
+}
+
+template <typename T>
+bool parseNumber(const char*& p, const char* end, T& value)
+{
+    auto result = std::from_chars(p, end, value);
+    if (result.ec != std::errc())
+        return false;
+    p = result.ptr;
+    return true;
+}
+
+// Floating-point from_chars is missing from libc++ before LLVM 20 (Apple
+// toolchains), so floats go through strtof on a bounded, terminated copy
+// of the number's characters.
+bool parseNumber(const char*& p, const char* end, float& value)
+{
+    char buf[64];
+    std::size_t n = 0;
+    while (p + n < end && n < sizeof(buf) - 1 && p[n] != '\0' && std::strchr("+-.0123456789eE", p[n]))
+        n++;
+    std::memcpy(buf, p, n);
+    buf[n] = '\0';
+    char* stop = nullptr;
+    errno = 0;
+    value = std::strtof(buf, &stop);
+    if (stop == buf || errno == ERANGE)
+        return false;
+    p += stop - buf;
+    return true;
+}
+
+bool parseObject(const char*& p, const char* end, TrackLogRecord& r, bool bbox, bool& hasFrame)
+{
+    if (p == end || *p != '{')
+        return false;
+    p++;
+    while (true) {
+        skipSpace(p, end);
+        if (p == end)
+            return false;
+        if (*p == '}') {
+            p++;
+            return true;
+        }
+        if (*p == ',') {
+            p++;
+            continue;
+        }
+        if (*p != '"')
+            return false;
+
+        const char* keyBegin = p + 1;
+        if (!skipString(p, end))
+            return false;
+        std::string_view key(keyBegin, p - 1 - keyBegin);
+        skipSpace(p, end);
+        if (p == end || *p != ':')
+            return false;
+        p++;
+        skipSpace(p, end);
+
+        bool ok = true;
+        if (!bbox && key == "bbox" && p < end && *p == '{') {
+            ok = parseObject(p, end, r, true, hasFrame);
+        } else if (bbox && key == "x") {
+            ok = parseNumber(p, end, r.x);
+        } else if (bbox && key == "y") {
+            ok = parseNumber(p, end, r.y);
+        } else if (bbox && key == "width") {
+            ok = parseNumber(p, end, r.width);
+        } else if (bbox && key == "height") {
+            ok = parseNumber(p, end, r.height);
+        } else if (!bbox && key == "frame") {
+            ok = hasFrame = parseNumber(p, end, r.frameIndex);
+        } else if (!bbox && key == "timestamp_us") {
+            ok = parseNumber(p, end, r.timestampUs);
+        } else if (!bbox && key == "track") {
+            ok = parseNumber(p, end, r.trackId);
+        } else if (!bbox && key == "class") {
+            ok = parseNumber(p, end, r.classId);
+        } else if (!bbox && key == "score") {
+            ok = parseNumber(p, end, r.score);
+        } else {
+            ok = skipValue(p, end);
+        }
+        if (!ok)
+            return false;
+    }
+}
+
+}
+
+// ---- WRITER ---- //
+NdjsonWriter::NdjsonWriter(const std::string& path, std::size_t blockSize)
+    : path(path), blockSize(std::max<std::size_t>(blockSize, 4096))
+{
+    file = std::fopen(path.c_str(), "wb");
+    if (!file)
+        throw std::runtime_error("Unable to open file: " + path);
+    active.reserve(this->blockSize + 256);
+    writing.reserve(this->blockSize + 256);
+    thread = std::thread(&NdjsonWriter::run, this);
+}
+
+NdjsonWriter::~NdjsonWriter()
+{
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cond.notify_all();
+    thread.join();
+    std::fclose(file);
+}
+
+void NdjsonWriter::write(const TrackLogRecord& r)
+{
+    appendLiteral(active, "{\"frame\":");
+    appendNumber(active, r.frameIndex);
+    appendLiteral(active, ",\"timestamp_us\":");
+    appendNumber(active, r.timestampUs);
+    appendLiteral(active, ",\"track\":");
+    appendNumber(active, r.trackId);
+    appendLiteral(active, ",\"class\":");
+    appendNumber(active, r.classId);
+    appendLiteral(active, ",\"score\":");
+    appendNumber(active, r.score);
+    appendLiteral(active, ",\"bbox\":{\"x\":");
+    appendNumber(active, r.x);
+    appendLiteral(active, ",\"y\":");
+    appendNumber(active, r.y);
+    appendLiteral(active, ",\"width\":");
+    appendNumber(active, r.width);
+    appendLiteral(active, ",\"height\":");
+    appendNumber(active, r.height);
+    appendLiteral(active, "}}\n");
+
+    if (active.size() >= blockSize) {
+        std::unique_lock<std::mutex> lock(mutex);
+        submit(lock);
+    }
+}
+
+// Hands the active buffer to the writer thread once it is done with the
+// previous one.
+void NdjsonWriter::submit(std::unique_lock<std::mutex>& lock)
+{
+    cond.wait(lock, [this] { return !pending; });
+    if (active.empty())
+        return;
+    std::swap(active, writing);
+    pending = true;
+    cond.notify_all();
+}
+
+void NdjsonWriter::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    submit(lock);
+    cond.wait(lock, [this] { return !pending; });
+    if (std::fflush(file) != 0)
+        reportError(errno);
+}
+
+bool NdjsonWriter::good() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return !failed;
+}
+
+// Called with the mutex held; only the first error is printed.
+void NdjsonWriter::reportError(int error)
+{
+    if (!failed)
+        std::cerr << "Writing " << path << " failed: " << std::strerror(error) << "\n";
+    failed = true;
+}
+
+std::size_t NdjsonWriter::getBytesWritten() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return bytesWritten;
+}
+
+void NdjsonWriter::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        cond.wait(lock, [this] { return pending || stopping; });
+        if (!pending)
+            return;
+
+        lock.unlock();
+        const std::size_t written = std::fwrite(writing.data(), 1, writing.size(), file);
+        const int error = errno;
+        lock.lock();
+
+        bytesWritten += written;
+        if (written < writing.size())
+            reportError(error);
+        writing.clear();
+        pending = false;
+        cond.notify_all();
+    }
+}
+
+// ---- READER ---- //
+NdjsonReader::NdjsonReader(const std::string& path, std::size_t bufferSize)
+    : buffer(std::max<std::size_t>(bufferSize, 256))
+{
+    file = std::fopen(path.c_str(), "rb");
+    if (!file)
+        throw std::runtime_error("Unable to open file: " + path);
+}
+
+NdjsonReader::~NdjsonReader()
+{
+    std::fclose(file);
+}
+
+bool NdjsonReader::nextLine(const char*& begin, const char*& end)
+{
+    while (true) {
+        const char* data = buffer.data();
+        const void* newline = std::memchr(data + start, '\n', filled - start);
+        if (newline) {
+            begin = data + start;
+            end = static_cast<const char*>(newline);
+            start = end - data + 1;
+            return true;
+        }
+        if (eof) {
+            if (start == filled)
+                return false;
+            begin = data + start;
+            end = data + filled;
+            start = filled;
+            return true;
+        }
+
+        // Keep the partial line and refill behind it; grow for very long lines.
+        std::memmove(buffer.data(), data + start, filled - start);
+        filled -= start;
+        start = 0;
+        if (filled == buffer.size())
+            buffer.resize(buffer.size() * 2);
+        std::size_t n = std::fread(buffer.data() + filled, 1, buffer.size() - filled, file);
+        filled += n;
+        if (n == 0)
+            eof = true;
+    }
+}
+
+bool NdjsonReader::next(TrackLogRecord& record)
+{
+    const char* begin;
+    const char* end;
+    while (nextLine(begin, end)) {
+        skipSpace(begin, end);
+        if (begin == end)
+            continue;
+        if (parseLine(begin, end, record))
+            return true;
+        skippedLines++;
+    }
+    return false;
+}
+
+bool NdjsonReader::parseLine(const char* begin, const char* end, TrackLogRecord& record)
+{
+    record = TrackLogRecord();
+    bool hasFrame = false;
+    skipSpace(begin, end);
+    return parseObject(begin, end, record, false, hasFrame) && hasFrame;
+}
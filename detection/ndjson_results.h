@@ -0,0 +1,97 @@
+//
+//  ndjson_results.h
+//  Inference
+//
+//  Per-frame results as newline-delimited JSON, one object per box:
+//    {"frame":12,"timestamp_us":...,"track":0,"class":0,"score":0.93,
+//     "bbox":{"x":410,"y":220,"width":96,"height":80}}
+//  ("bbox" uses the BoundingBoxSaver field names).
+//
+//  The writer formats straight into a reusable buffer with std::to_chars,
+//  without building a json DOM, and hands full blocks to a background
+//  thread for the fwrite. The reader parses line by line from a fixed-size
+//  read buffer, so files of any length stream through constant memory.
+//
+
+#ifndef ndjson_results_h
+#define ndjson_results_h
+
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "track_log.h"
+
+class NdjsonWriter {
+public:
+    // Throws if the file cannot be created.
+    explicit NdjsonWriter(const std::string& path, std::size_t blockSize = 1 << 20);
+    ~NdjsonWriter();
+
+    NdjsonWriter(const NdjsonWriter&) = delete;
+    NdjsonWriter& operator=(const NdjsonWriter&) = delete;
+
+    void write(const TrackLogRecord& record);
+
+    // Writes everything buffered so far and waits until it is in the file.
+    void flush();
+
+    // Bytes that reached the file; short writes are not counted.
+    std::size_t getBytesWritten() const;
+    // False once a write or flush has failed (e.g. a full disk); the first
+    // failure is also printed.
+    bool good() const;
+
+private:
+    void submit(std::unique_lock<std::mutex>& lock);
+    void reportError(int error);
+    void run();
+
+    std::string path;
+    FILE* file = nullptr;
+    std::size_t blockSize;
+    std::vector<char> active;   // filled by write()
+    std::vector<char> writing;  // owned by the writer thread while pending
+
+    mutable std::mutex mutex;
+    std::condition_variable cond;
+    bool pending = false;
+    bool stopping = false;
+    bool failed = false;
+    std::size_t bytesWritten = 0;
+
+    std::thread thread;
+};
+
+class NdjsonReader {
+public:
+    // Throws if the file cannot be opened.
+    explicit NdjsonReader(const std::string& path, std::size_t bufferSize = 1 << 16);
+    ~NdjsonReader();
+
+    NdjsonReader(const NdjsonReader&) = delete;
+    NdjsonReader& operator=(const NdjsonReader&) = delete;
+
+    // Reads the next record; lines that do not parse are skipped and counted.
+    bool next(TrackLogRecord& record);
+
+    std::size_t getSkippedLines() const { return skippedLines; }
+
+    // Parses one line (without the newline). Unknown keys are ignored.
+    static bool parseLine(const char* begin, const char* end, TrackLogRecord& record);
+
+private:
+    bool nextLine(const char*& begin, const char*& end);
+
+    FILE* file = nullptr;
+    std::vector<char> buffer;
+    std::size_t start = 0;      // first unread byte in buffer
+    std::size_t filled = 0;     // bytes of buffer holding data
+    bool eof = false;
+    std::size_t skippedLines = 0;
+};
+
+#endif /* ndjson_results_h */
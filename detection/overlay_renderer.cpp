@@ -0,0 +1,201 @@
+//
+//  overlay_renderer.cpp
+//  Inference
+//
+
+#include "overlay_renderer.h"
+
+#include <algorithm>
+#include <cmath>
+
+OverlayRenderer& OverlayRenderer::shared()
+{
+    static OverlayRenderer renderer;
+    return renderer;
+}
+
+OverlayRenderer::OverlayRenderer(std::size_t maxLabels) : maxLabels(std::max<std::size_t>(maxLabels, 1))
+{
+}
+
+int OverlayRenderer::glyphIndex(char c)
+{
+    int index = static_cast<unsigned char>(c) - firstGlyph;
+    return (index >= 0 && index < glyphCount) ? index : '?' - firstGlyph;
+}
+
+// ---- ATLAS ---- //
+void OverlayRenderer::rasterize(Style& s)
+{
+    const TextStyle& style = s.style;
+    int baseline = 0;
+    s.emptyWidth = cv::getTextSize("", style.fontFace, style.fontScale, style.thickness, &baseline).width;
+    s.ascent = cv::getTextSize("Ay", style.fontFace, style.fontScale, style.thickness, &baseline).height;
+    s.descent = baseline;
+    s.pad = std::max(style.thickness, style.outline) + 2;
+    s.cellHeight = s.ascent + s.descent + 2 * s.pad;
+
+    // Hershey advances are fractional; measuring a run of ten glyphs keeps
+    // the rounding of getTextSize out of the per-glyph value.
+    int atlasWidth = 0;
+    for (int i = 0; i < glyphCount; i++) {
+        std::string run(10, char(firstGlyph + i));
+        int width = cv::getTextSize(run, style.fontFace, style.fontScale, style.thickness, &baseline).width;
+        s.advance[i] = float(width - s.emptyWidth) / 10.f;
+        s.cellX[i] = atlasWidth;
+        s.cellWidth[i] = int(std::ceil(s.advance[i])) + 2 * s.pad;
+        atlasWidth += s.cellWidth[i];
+    }
+
+    s.fillAtlas = cv::Mat::zeros(s.cellHeight, atlasWidth, CV_8UC1);
+    if (style.outline > 0)
+        s.outlineAtlas = cv::Mat::zeros(s.cellHeight, atlasWidth, CV_8UC1);
+    for (int i = 0; i < glyphCount; i++) {
+        const cv::Rect cell(s.cellX[i], 0, s.cellWidth[i], s.cellHeight);
+        const std::string glyph(1, char(firstGlyph + i));
+        const cv::Point origin(s.pad, s.pad + s.ascent);
+        cv::Mat fill = s.fillAtlas(cell);
+        cv::putText(fill, glyph, origin, style.fontFace, style.fontScale, cv::Scalar(255), style.thickness, cv::LINE_AA);
+        if (style.outline > 0) {
+            cv::Mat outline = s.outlineAtlas(cell);
+            cv::putText(outline, glyph, origin, style.fontFace, style.fontScale, cv::Scalar(255), style.outline, cv::LINE_AA);
+        }
+    }
+}
+
+OverlayRenderer::Style& OverlayRenderer::getStyle(const TextStyle& style)
+{
+    const std::array<std::int64_t, 4> key = {style.fontFace, std::llround(style.fontScale * 1000.0), style.thickness, style.outline};
+    std::unique_ptr<Style>& entry = styles[key];
+    if (!entry) {
+        entry = std::make_unique<Style>();
+        entry->style = style;
+        rasterize(*entry);
+    }
+    return *entry;
+}
+
+// ---- LABELS ---- //
+void OverlayRenderer::compose(const Style& s, const cv::Mat& atlas, std::string_view text, cv::Mat& label)
+{
+    float total = 0.f;
+    for (char c : text)
+        total += s.advance[glyphIndex(c)];
+    label = cv::Mat::zeros(s.cellHeight, int(std::ceil(total)) + 2 * s.pad + 2, CV_8UC1);
+
+    float pen = 0.f;
+    for (char c : text) {
+        const int i = glyphIndex(c);
+        const int x = int(std::lround(pen));
+        for (int row = 0; row < s.cellHeight; row++) {
+            const uint8_t* src = atlas.ptr<uint8_t>(row) + s.cellX[i];
+            uint8_t* dst = label.ptr<uint8_t>(row) + x;
+            for (int k = 0; k < s.cellWidth[i]; k++)
+                dst[k] = std::max(dst[k], src[k]);
+        }
+        pen += s.advance[i];
+    }
+}
+
+std::shared_ptr<const OverlayRenderer::Label> OverlayRenderer::getLabel(Style& s, std::string_view text)
+{
+    auto found = s.labels.find(text);
+    if (found != s.labels.end())
+        return found->second;
+
+    // Changing text (counters, coordinates) would otherwise grow the cache
+    // without bound; labels still being blitted stay alive through their
+    // shared_ptr.
+    if (s.labels.size() >= maxLabels)
+        s.labels.clear();
+
+    auto label = std::make_shared<Label>();
+    compose(s, s.fillAtlas, text, label->fill);
+    if (!s.outlineAtlas.empty())
+        compose(s, s.outlineAtlas, text, label->outline);
+    composedLabels++;
+    s.labels.emplace(std::string(text), label);
+    return label;
+}
+
+// ---- DRAWING ---- //
+void OverlayRenderer::blend(cv::Mat& image, const cv::Mat& alpha, cv::Point topLeft, const cv::Scalar& color)
+{
+    const cv::Rect area = cv::Rect(topLeft, alpha.size()) & cv::Rect(0, 0, image.cols, image.rows);
+    if (area.width <= 0 || area.height <= 0)
+        return;
+
+    const int channels = image.channels();
+    int value[4];
+    for (int c = 0; c < channels; c++)
+        value[c] = std::clamp(int(std::lround(color[c])), 0, 255);
+
+    for (int y = area.y; y < area.y + area.height; y++) {
+        const uint8_t* a = alpha.ptr<uint8_t>(y - topLeft.y) + (area.x - topLeft.x);
+        uint8_t* p = image.ptr<uint8_t>(y) + area.x * channels;
+        for (int x = 0; x < area.width; x++, p += channels) {
+            const int w = a[x];
+            if (w == 0)
+                continue;
+            for (int c = 0; c < channels; c++)
+                p[c] = uint8_t((p[c] * (255 - w) + value[c] * w + 127) / 255);
+        }
+    }
+}
+
+cv::Size OverlayRenderer::measure(std::string_view text, const TextStyle& style, int* baseline)
+{
+    const Style* s;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        s = &getStyle(style);
+    }
+    float total = 0.f;
+    for (char c : text)
+        total += s->advance[glyphIndex(c)];
+    if (baseline)
+        *baseline = s->descent;
+    return cv::Size(int(std::lround(total)) + s->emptyWidth, s->ascent);
+}
+
+void OverlayRenderer::drawText(cv::Mat& image, std::string_view text, cv::Point origin, const TextStyle& style,
+                               const cv::Scalar& color, const cv::Scalar& outlineColor)
+{
+    if (image.empty() || text.empty())
+        return;
+    if (image.depth() != CV_8U || image.channels() > 4) {
+        const std::string copy(text);
+        if (style.outline > 0)
+            cv::putText(image, copy, origin, style.fontFace, style.fontScale, outlineColor, style.outline);
+        cv::putText(image, copy, origin, style.fontFace, style.fontScale, color, style.thickness);
+        return;
+    }
+
+    const Style* s;
+    std::shared_ptr<const Label> label;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Style& entry = getStyle(style);
+        label = getLabel(entry, text);
+        s = &entry;
+    }
+    const cv::Point topLeft(origin.x - s->pad, origin.y - s->ascent - s->pad);
+    if (!label->outline.empty())
+        blend(image, label->outline, topLeft, outlineColor);
+    blend(image, label->fill, topLeft, color);
+}
+
+std::size_t OverlayRenderer::getCachedLabels() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::size_t count = 0;
+    for (const auto& entry : styles)
+        count += entry.second->labels.size();
+    return count;
+}
+
+std::size_t OverlayRenderer::getComposedLabels() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return composedLabels;
+}
@@ -0,0 +1,100 @@
+//
+//  overlay_renderer.h
+//  Inference
+//
+//  Text overlay without per-frame Hershey rasterization. The printable ASCII
+//  glyphs of a style are drawn once with cv::putText into an 8-bit alpha
+//  atlas; a label is composed from the atlas the first time its text is
+//  seen and kept in a cache, so a label that did not change since the last
+//  frame (class names, "fps: ", a counter that stayed put) is only an
+//  alpha blit. Measuring text reads the cached glyph advances instead of
+//  calling cv::getTextSize.
+//
+//  Positions follow cv::putText: the origin is the left end of the baseline.
+//
+
+#ifndef overlay_renderer_h
+#define overlay_renderer_h
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <opencv2/opencv.hpp>
+
+struct TextStyle {
+    int fontFace = cv::FONT_HERSHEY_SIMPLEX;
+    double fontScale = 1.0;
+    int thickness = 1;
+    int outline = 0;    // thickness of an outline drawn underneath the text, 0 for none
+};
+
+class OverlayRenderer {
+public:
+    // Renderer shared by all drawing code; safe to use from several threads.
+    static OverlayRenderer& shared();
+
+    explicit OverlayRenderer(std::size_t maxLabels = 512);
+
+    OverlayRenderer(const OverlayRenderer&) = delete;
+    OverlayRenderer& operator=(const OverlayRenderer&) = delete;
+
+    // Same result as cv::getTextSize (to within a pixel of rounding).
+    cv::Size measure(std::string_view text, const TextStyle& style, int* baseline = nullptr);
+
+    // Blends the text into an 8-bit image. Other depths fall back to
+    // cv::putText.
+    void drawText(cv::Mat& image, std::string_view text, cv::Point origin, const TextStyle& style,
+                  const cv::Scalar& color, const cv::Scalar& outlineColor = cv::Scalar(0, 0, 0));
+
+    std::size_t getCachedLabels() const;
+    std::size_t getComposedLabels() const;  // cache misses so far
+
+private:
+    static const int firstGlyph = 32;
+    static const int glyphCount = 95;       // ' ' .. '~'
+
+    struct Label {
+        cv::Mat fill;       // CV_8UC1 alpha
+        cv::Mat outline;    // empty without an outline
+    };
+
+    struct StringHash {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view text) const { return std::hash<std::string_view>()(text); }
+    };
+
+    struct Style {
+        TextStyle style;
+        int ascent = 0;         // cv::getTextSize height
+        int descent = 0;        // cv::getTextSize baseline
+        int emptyWidth = 0;     // cv::getTextSize width of ""
+        int pad = 0;            // margin around a glyph for stroke width and anti-aliasing
+        int cellHeight = 0;
+        std::array<float, glyphCount> advance{};
+        std::array<int, glyphCount> cellX{};
+        std::array<int, glyphCount> cellWidth{};
+        cv::Mat fillAtlas;
+        cv::Mat outlineAtlas;
+        std::unordered_map<std::string, std::shared_ptr<const Label>, StringHash, std::equal_to<>> labels;
+    };
+
+    Style& getStyle(const TextStyle& style);
+    std::shared_ptr<const Label> getLabel(Style& style, std::string_view text);
+    static void rasterize(Style& style);
+    static void compose(const Style& style, const cv::Mat& atlas, std::string_view text, cv::Mat& label);
+    static void blend(cv::Mat& image, const cv::Mat& alpha, cv::Point topLeft, const cv::Scalar& color);
+    static int glyphIndex(char c);
+
+    std::size_t maxLabels;
+    mutable std::mutex mutex;
+    std::map<std::array<std::int64_t, 4>, std::unique_ptr<Style>> styles;
+    std::size_t composedLabels = 0;
+};
+
+#endif /* overlay_renderer_h */
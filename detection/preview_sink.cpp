@@ -0,0 +1,104 @@
+//
+//  preview_sink.cpp
+//  Inference
+//
+
+#include "preview_sink.h"
+
+#include "metrics.h"
+
+PreviewSink::PreviewSink(const PreviewSinkOptions& options)
+    : options(options),
+      period(options.refreshHz > 0
+                 ? std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / options.refreshHz))
+                 : std::chrono::steady_clock::duration::zero()),
+      nextDue(std::chrono::steady_clock::now())
+{
+    cv::namedWindow(options.windowName, cv::WINDOW_AUTOSIZE);
+    thread = std::thread(&PreviewSink::run, this);
+}
+
+PreviewSink::~PreviewSink()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cond.notify_all();
+    thread.join();
+    cv::destroyWindow(options.windowName);
+}
+
+cv::Size PreviewSink::fitSize(cv::Size frame, cv::Size maxSize)
+{
+    if (maxSize.width <= 0 || maxSize.height <= 0 ||
+        (frame.width <= maxSize.width && frame.height <= maxSize.height))
+        return frame;
+    const double scale = std::min(double(maxSize.width) / frame.width, double(maxSize.height) / frame.height);
+    return cv::Size(std::max(1, int(frame.width * scale)), std::max(1, int(frame.height * scale)));
+}
+
+bool PreviewSink::show(const cv::Mat& frame)
+{
+    static metrics::LatencyHistogram& displayLatency = metrics::registry().histogram("preview_display");
+
+    const auto now = std::chrono::steady_clock::now();
+    stats.offered++;
+    if (frame.empty() || now < nextDue)
+        return false;
+    nextDue = now + period;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        source = frame;
+        pending = true;
+    }
+    cond.notify_all();
+
+    // The helper downsamples this frame meanwhile.
+    if (!ready.empty()) {
+        metrics::ScopedTimer timer(displayLatency);
+        cv::imshow(options.windowName, ready);
+        stats.shown++;
+    }
+    const int key = cv::waitKey(1);
+    if (key == 'q' || key == 27)
+        quit = true;
+
+    // The caller reuses `frame` for the next read, so let go of it here.
+    std::unique_lock<std::mutex> lock(mutex);
+    cond.wait(lock, [this] { return !pending; });
+    source.release();
+    std::swap(scaled, ready);
+    stats.taken++;
+    return true;
+}
+
+PreviewSinkStats PreviewSink::getStats() const
+{
+    return stats;
+}
+
+void PreviewSink::run()
+{
+    static metrics::LatencyHistogram& scaleLatency = metrics::registry().histogram("preview_scale");
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        cond.wait(lock, [this] { return pending || stopping; });
+        if (stopping)
+            break;
+        lock.unlock();
+        {
+            metrics::ScopedTimer timer(scaleLatency);
+            const cv::Size size = fitSize(source.size(), options.maxSize);
+            if (size == source.size())
+                source.copyTo(scaled);
+            else
+                cv::resize(source, scaled, size, 0, 0, cv::INTER_AREA);
+        }
+        lock.lock();
+        pending = false;
+        cond.notify_all();
+    }
+}
@@ -0,0 +1,84 @@
+//
+//  preview_sink.h
+//  Inference
+//
+//  Live preview window. The tracking loop offers every frame; a frame is
+//  only taken when the next refresh is due. HighGUI is not thread-safe
+//  (Cocoa and Qt need the main thread), so the window, imshow and the
+//  waitKey event pump stay on the caller's thread. Only the downsampling
+//  to the window size runs on a helper thread, overlapped with showing the
+//  previous frame and the 1 ms waitKey, so a frame reaches the window one
+//  refresh after it was taken.
+//
+//  Create, show() and destroy the sink on the thread that owns the other
+//  HighGUI windows (e.g. ROI selection), normally the main thread.
+//
+#ifndef preview_sink_h
+#define preview_sink_h
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <opencv2/opencv.hpp>
+
+struct PreviewSinkOptions {
+    std::string windowName = "YOLOv11 Detection";
+    cv::Size maxSize = cv::Size(1280, 720);     // frames are shrunk to fit, never enlarged
+    double refreshHz = 30.0;                    // <= 0 offers every frame
+};
+
+struct PreviewSinkStats {
+    std::size_t offered = 0;        // frames passed to show()
+    std::size_t taken = 0;          // frames downsampled for the window
+    std::size_t shown = 0;
+};
+
+class PreviewSink {
+public:
+    explicit PreviewSink(const PreviewSinkOptions& options = PreviewSinkOptions());
+    ~PreviewSink();
+
+    PreviewSink(const PreviewSink&) = delete;
+    PreviewSink& operator=(const PreviewSink&) = delete;
+
+    // True when show() would take the next frame; lets the caller skip
+    // drawing frames the preview would drop anyway.
+    bool isDue() const { return std::chrono::steady_clock::now() >= nextDue; }
+
+    // If a refresh is due, shows the frame taken last time and takes a
+    // downsampled copy of this one. Returns true if the frame was taken;
+    // `frame` is not referenced after the call.
+    bool show(const cv::Mat& frame);
+
+    // 'q' or Esc was pressed in the preview window.
+    bool quitRequested() const { return quit; }
+
+    PreviewSinkStats getStats() const;
+
+    static cv::Size fitSize(cv::Size frame, cv::Size maxSize);
+
+private:
+    void run();
+
+    PreviewSinkOptions options;
+    std::chrono::steady_clock::duration period;
+    std::chrono::steady_clock::time_point nextDue;
+    cv::Mat ready;      // downsampled last refresh, shown on the next one
+    bool quit = false;
+    PreviewSinkStats stats;
+
+    // Hand-off to the helper thread: `source` and `scaled` belong to it
+    // while `pending` is set.
+    std::mutex mutex;
+    std::condition_variable cond;
+    cv::Mat source;
+    cv::Mat scaled;
+    bool pending = false;
+    bool stopping = false;
+
+    std::thread thread;
+};
+
+#endif /* preview_sink_h */
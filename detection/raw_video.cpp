@@ -0,0 +1,297 @@
+//
+//  raw_video.cpp
+//  Inference
+//
+
+#include "raw_video.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+// Longest y4m header line accepted; real ones are well under 100 bytes.
+static const std::size_t Y4M_MAX_LINE = 1024;
+
+// ---- FORMAT ---- //
+std::size_t RawVideoInfo::frameBytes() const
+{
+    const std::size_t pixels = std::size_t(width) * std::size_t(height);
+    return format == RawPixelFormat::BGR24 ? pixels * 3 : pixels * 3 / 2;
+}
+
+static bool parsePixelFormat(const std::string& name, RawPixelFormat& format)
+{
+    if (name == "bgr24")
+        format = RawPixelFormat::BGR24;
+    else if (name == "nv12")
+        format = RawPixelFormat::NV12;
+    else if (name == "yuv420p" || name == "i420")
+        format = RawPixelFormat::I420;
+    else
+        return false;
+    return true;
+}
+
+// 4:2:0 frames need even dimensions for the half-resolution chroma planes.
+static bool validSize(const RawVideoInfo& info)
+{
+    if (info.width <= 0 || info.height <= 0)
+        return false;
+    return !info.isYuv() || (info.width % 2 == 0 && info.height % 2 == 0);
+}
+
+bool RawVideoInfo::parse(const std::string& spec, RawVideoInfo& info)
+{
+    RawVideoInfo parsed;
+    if (std::sscanf(spec.c_str(), "%dx%d", &parsed.width, &parsed.height) != 2)
+        return false;
+
+    std::size_t colon = spec.find(':');
+    if (colon != std::string::npos) {
+        std::size_t next = spec.find(':', colon + 1);
+        if (!parsePixelFormat(spec.substr(colon + 1, next - colon - 1), parsed.format))
+            return false;
+        if (next != std::string::npos)
+            parsed.fps = std::atof(spec.c_str() + next + 1);
+    }
+    if (!validSize(parsed) || parsed.fps <= 0)
+        return false;
+    info = parsed;
+    return true;
+}
+
+// "YUV4MPEG2 W<w> H<h> F<num>:<den> [I..] [A..] [C<colorspace>] [X..]".
+// Only the 4:2:0 colour spaces are accepted; they are all stored as I420.
+static bool parseY4mHeader(const std::string& line, RawVideoInfo& info)
+{
+    std::istringstream in(line);
+    std::string token;
+    if (!(in >> token) || token != "YUV4MPEG2")
+        return false;
+
+    RawVideoInfo parsed;
+    parsed.format = RawPixelFormat::I420;
+    while (in >> token) {
+        const char* value = token.c_str() + 1;
+        switch (token[0]) {
+        case 'W':
+            parsed.width = std::atoi(value);
+            break;
+        case 'H':
+            parsed.height = std::atoi(value);
+            break;
+        case 'F': {
+            int num = 0, den = 0;
+            if (std::sscanf(value, "%d:%d", &num, &den) == 2 && num > 0 && den > 0)
+                parsed.fps = double(num) / den;
+            break;
+        }
+        case 'C':
+            // 8-bit only: C420p10 and the like are 16 bits per sample.
+            if (std::strcmp(value, "420") != 0 && std::strcmp(value, "420jpeg") != 0 &&
+                std::strcmp(value, "420paldv") != 0 && std::strcmp(value, "420mpeg2") != 0) {
+                std::cerr << "Unsupported y4m colour space " << value << ", only 4:2:0 is read\n";
+                return false;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    if (!validSize(parsed))
+        return false;
+    info = parsed;
+    return true;
+}
+
+// ---- SOURCE ---- //
+bool RawVideoSource::read(cv::Mat& frame)
+{
+    if (isYuv())
+        return false;
+    const unsigned char* data = next();
+    if (!data)
+        return false;
+    frame = cv::Mat(info.height, info.width, CV_8UC3, const_cast<unsigned char*>(data));
+    return true;
+}
+
+bool RawVideoSource::read(YuvFrame& frame)
+{
+    if (!isYuv())
+        return false;
+    const unsigned char* data = next();
+    if (!data)
+        return false;
+    frame.data = cv::Mat(info.height * 3 / 2, info.width, CV_8UC1, const_cast<unsigned char*>(data));
+    frame.format = info.format == RawPixelFormat::NV12 ? YuvFormat::NV12 : YuvFormat::I420;
+    frame.width = info.width;
+    frame.height = info.height;
+    return true;
+}
+
+// ---- MAPPED FILE ---- //
+bool MappedVideoReader::open(const std::string& path)
+{
+    y4m = false;
+    offset = dataOffset = 0;
+    if (!file.open(path))
+        return false;
+
+    const char* data = reinterpret_cast<const char*>(file.getData());
+    const std::size_t limit = std::min(file.getSize(), Y4M_MAX_LINE);
+    const char* end = static_cast<const char*>(std::memchr(data, '\n', limit));
+    if (!end || !parseY4mHeader(std::string(data, end), info)) {
+        std::cerr << path << " is not a 4:2:0 y4m file\n";
+        file.close();
+        return false;
+    }
+    y4m = true;
+    offset = dataOffset = std::size_t(end - data) + 1;
+    file.adviseSequential();
+    return true;
+}
+
+bool MappedVideoReader::open(const std::string& path, const RawVideoInfo& rawInfo)
+{
+    y4m = false;
+    offset = dataOffset = 0;
+    if (!validSize(rawInfo) || !file.open(path))
+        return false;
+    info = rawInfo;
+    if (file.getSize() % info.frameBytes() != 0)
+        std::cerr << path << " does not hold a whole number of " << info.width << "x" << info.height
+                  << " frames, ignoring the trailing bytes\n";
+    file.adviseSequential();
+    return true;
+}
+
+std::size_t MappedVideoReader::getFrameCount() const
+{
+    if (!file.isOpen())
+        return 0;
+    const std::size_t stride = info.frameBytes() + (y4m ? std::strlen("FRAME\n") : 0);
+    return (file.getSize() - dataOffset) / stride;
+}
+
+const unsigned char* MappedVideoReader::next()
+{
+    const unsigned char* data = file.getData();
+    const std::size_t size = file.getSize();
+    std::size_t start = offset;
+    if (y4m) {
+        // Each frame is "FRAME[ <params>]\n" followed by the planes.
+        if (size - offset < 6 || std::memcmp(data + offset, "FRAME", 5) != 0)
+            return nullptr;
+        const std::size_t limit = std::min(size - offset, Y4M_MAX_LINE);
+        const void* end = std::memchr(data + offset, '\n', limit);
+        if (!end)
+            return nullptr;
+        start = std::size_t(static_cast<const unsigned char*>(end) - data) + 1;
+    }
+    if (!data || size - start < info.frameBytes())
+        return nullptr;
+    offset = start + info.frameBytes();
+    return data + start;
+}
+
+// ---- PIPE ---- //
+bool PipeVideoReader::open()
+{
+    std::string header;
+    if (!readLine(header) || !parseY4mHeader(header, info)) {
+        std::cerr << "Input pipe does not start with a 4:2:0 y4m header\n";
+        return false;
+    }
+    y4m = true;
+    buffer.resize(info.frameBytes());
+    return true;
+}
+
+bool PipeVideoReader::open(const RawVideoInfo& rawInfo)
+{
+    if (!validSize(rawInfo))
+        return false;
+    info = rawInfo;
+    y4m = false;
+    buffer.resize(info.frameBytes());
+    return true;
+}
+
+const unsigned char* PipeVideoReader::next()
+{
+    if (buffer.empty())
+        return nullptr;
+    if (y4m) {
+        std::string line;
+        if (!readLine(line) || line.compare(0, 5, "FRAME") != 0)
+            return nullptr;
+    }
+    return readExactly(buffer.data(), buffer.size()) ? buffer.data() : nullptr;
+}
+
+// A pipe hands out at most its capacity (64 KiB on Linux) per read.
+bool PipeVideoReader::readExactly(unsigned char* dst, std::size_t size)
+{
+    while (size > 0) {
+        ssize_t n = ::read(fd, dst, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        dst += n;
+        size -= std::size_t(n);
+    }
+    return true;
+}
+
+// Byte by byte, so nothing past the newline is consumed; only header lines
+// go through here.
+bool PipeVideoReader::readLine(std::string& line)
+{
+    line.clear();
+    unsigned char c = 0;
+    while (line.size() < Y4M_MAX_LINE) {
+        if (!readExactly(&c, 1))
+            return false;
+        if (c == '\n')
+            return true;
+        line.push_back(char(c));
+    }
+    return false;
+}
+
+// ---- OPEN ---- //
+static bool hasExtension(const std::string& path, const std::string& extension)
+{
+    return path.size() >= extension.size() &&
+           path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+std::unique_ptr<RawVideoSource> openRawVideo(const std::string& path, const RawVideoInfo* rawInfo)
+{
+    if (path == "-") {
+        auto pipe = std::make_unique<PipeVideoReader>(STDIN_FILENO);
+        if (rawInfo ? pipe->open(*rawInfo) : pipe->open())
+            return pipe;
+        return nullptr;
+    }
+    if (hasExtension(path, ".y4m")) {
+        auto reader = std::make_unique<MappedVideoReader>();
+        if (reader->open(path))
+            return reader;
+        return nullptr;
+    }
+    if (rawInfo && (hasExtension(path, ".yuv") || hasExtension(path, ".raw"))) {
+        auto reader = std::make_unique<MappedVideoReader>();
+        if (reader->open(path, *rawInfo))
+            return reader;
+        std::cerr << "Cannot map " << path << " as rawvideo\n";
+    }
+    return nullptr;
+}
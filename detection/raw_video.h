@@ -0,0 +1,115 @@
+//
+//  raw_video.h
+//  Inference
+//
+//  Already decoded video: YUV4MPEG2 (.y4m) and headerless rawvideo files,
+//  read through a memory map, and rawvideo or y4m piped into stdin (e.g.
+//  `ffmpeg -i in.mp4 -f rawvideo -pix_fmt nv12 - | det_demo - out.mp4`).
+//  Frames come out as cv::Mat / YuvFrame headers over the mapping or the
+//  read buffer, never copied, so a run measures tracking and detection
+//  without the codec, and the decode can happen once, or on another box.
+//
+
+#ifndef raw_video_h
+#define raw_video_h
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "mapped_file.h"
+#include "yuv_frame.h"
+
+enum class RawPixelFormat {
+    BGR24,  // ffmpeg bgr24, packed
+    NV12,   // ffmpeg nv12
+    I420    // ffmpeg yuv420p, and y4m's C420 variants
+};
+
+struct RawVideoInfo {
+    int width = 0;
+    int height = 0;
+    double fps = 30.0;
+    RawPixelFormat format = RawPixelFormat::NV12;
+
+    bool isYuv() const { return format != RawPixelFormat::BGR24; }
+    std::size_t frameBytes() const;
+
+    // "<width>x<height>[:<pix_fmt>[:<fps>]]", pix_fmt as ffmpeg names it
+    // (bgr24, nv12, yuv420p). False if the size or pix_fmt is not understood.
+    static bool parse(const std::string& spec, RawVideoInfo& info);
+};
+
+// Frames are views of the source's own buffer: valid until the next read()
+// and read-only (the mapping is not writable). Draw on a copy.
+class RawVideoSource {
+public:
+    virtual ~RawVideoSource() = default;
+
+    // BGR24 sources only.
+    bool read(cv::Mat& frame);
+    // NV12 and I420 sources only.
+    bool read(YuvFrame& frame);
+
+    const RawVideoInfo& getInfo() const { return info; }
+    bool isYuv() const { return info.isYuv(); }
+    double getFps() const { return info.fps; }
+    cv::Size getSize() const { return cv::Size(info.width, info.height); }
+
+protected:
+    // The next frame's frameBytes() bytes, null at the end of the input.
+    virtual const unsigned char* next() = 0;
+
+    RawVideoInfo info;
+};
+
+// A .y4m file, or a headerless file of back-to-back frames described by
+// `info`. The whole file is mapped and read front to back.
+class MappedVideoReader : public RawVideoSource {
+public:
+    bool open(const std::string& path);
+    bool open(const std::string& path, const RawVideoInfo& rawInfo);
+
+    // Frames in the file; y4m frame headers may vary in length, so for y4m
+    // this assumes the plain "FRAME\n" ffmpeg writes.
+    std::size_t getFrameCount() const;
+
+protected:
+    const unsigned char* next() override;
+
+private:
+    MappedFile file;
+    bool y4m = false;
+    std::size_t offset = 0;     // start of the next frame (its FRAME line for y4m)
+    std::size_t dataOffset = 0; // end of the stream header
+};
+
+// Frames from a pipe, read straight into one frame buffer. Without `info`
+// the stream must start with a y4m header.
+class PipeVideoReader : public RawVideoSource {
+public:
+    explicit PipeVideoReader(int fd = 0) : fd(fd) {}
+
+    bool open();
+    bool open(const RawVideoInfo& rawInfo);
+
+protected:
+    const unsigned char* next() override;
+
+private:
+    bool readExactly(unsigned char* dst, std::size_t size);
+    bool readLine(std::string& line);
+
+    int fd;
+    bool y4m = false;
+    std::vector<unsigned char> buffer;
+};
+
+// The raw reader for `path`, or null when it should go through
+// cv::VideoCapture: "-" is stdin, .y4m files are mapped, and .yuv/.raw
+// files are mapped as rawvideo when `rawInfo` describes them.
+std::unique_ptr<RawVideoSource> openRawVideo(const std::string& path, const RawVideoInfo* rawInfo = nullptr);
+
+#endif /* raw_video_h */
@@ -0,0 +1,126 @@
+//
+//  spatial_grid.cpp
+//  Inference
+//
+
+#include "spatial_grid.h"
+
+#include <algorithm>
+#include <cmath>
+
+void SpatialGrid::clear()
+{
+    cols = rows = 0;
+    cellStart.clear();
+    entries.clear();
+    x0.clear();
+    y0.clear();
+    x1.clear();
+    y1.clear();
+    visited.clear();
+    epoch = 0;
+}
+
+void SpatialGrid::build(const BoxSet& boxes, float cellSize)
+{
+    clear();
+    const std::size_t n = boxes.size();
+    if (n == 0)
+        return;
+
+    x0 = boxes.x0;
+    y0 = boxes.y0;
+    x1 = boxes.x1;
+    y1 = boxes.y1;
+    visited.assign(n, 0);
+
+    float minX = x0[0], minY = y0[0], maxX = x1[0], maxY = y1[0];
+    float extent = 0.f;
+    for (std::size_t i = 0; i < n; i++) {
+        minX = std::min(minX, x0[i]);
+        minY = std::min(minY, y0[i]);
+        maxX = std::max(maxX, x1[i]);
+        maxY = std::max(maxY, y1[i]);
+        extent += std::max(x1[i] - x0[i], y1[i] - y0[i]);
+    }
+    cell = cellSize > 0.f ? cellSize : std::max(1.f, extent / float(n));
+
+    // Keep the table within a few cells per box; a handful of huge boxes
+    // would otherwise ask for a fine grid over the whole frame.
+    const double maxCells = std::max<double>(64.0, 4.0 * double(n));
+    const double area = double(std::max(1.f, maxX - minX)) * double(std::max(1.f, maxY - minY));
+    if (area / (double(cell) * cell) > maxCells)
+        cell = float(std::sqrt(area / maxCells));
+
+    originX = minX;
+    originY = minY;
+    cols = int((maxX - minX) / cell) + 1;
+    rows = int((maxY - minY) / cell) + 1;
+
+    // Counting sort: cellStart[c + 1] first counts cell c, then the prefix
+    // sum turns the counts into offsets.
+    cellStart.assign(std::size_t(cols) * rows + 1, 0);
+    for (std::size_t i = 0; i < n; i++) {
+        const int c0 = column(x0[i]), c1 = column(x1[i]);
+        const int r0 = row(y0[i]), r1 = row(y1[i]);
+        for (int r = r0; r <= r1; r++)
+            for (int c = c0; c <= c1; c++)
+                cellStart[std::size_t(r) * cols + c + 1]++;
+    }
+    for (std::size_t c = 1; c < cellStart.size(); c++)
+        cellStart[c] += cellStart[c - 1];
+
+    entries.resize(cellStart.back());
+    std::vector<int> fill(cellStart.begin(), cellStart.end() - 1);
+    for (std::size_t i = 0; i < n; i++) {
+        const int c0 = column(x0[i]), c1 = column(x1[i]);
+        const int r0 = row(y0[i]), r1 = row(y1[i]);
+        for (int r = r0; r <= r1; r++)
+            for (int c = c0; c <= c1; c++)
+                entries[fill[std::size_t(r) * cols + c]++] = int(i);
+    }
+}
+
+int SpatialGrid::column(float x) const
+{
+    return std::clamp(int(std::floor((x - originX) / cell)), 0, cols - 1);
+}
+
+int SpatialGrid::row(float y) const
+{
+    return std::clamp(int(std::floor((y - originY) / cell)), 0, rows - 1);
+}
+
+void SpatialGrid::query(const Box2f& box, float margin, std::vector<int>& out) const
+{
+    out.clear();
+    if (x0.empty())
+        return;
+
+    const float qx0 = box.x0 - margin, qy0 = box.y0 - margin;
+    const float qx1 = box.x1 + margin, qy1 = box.y1 + margin;
+    if (qx1 < originX || qy1 < originY || qx0 > originX + cols * cell || qy0 > originY + rows * cell)
+        return;
+
+    if (++epoch == 0) {
+        std::fill(visited.begin(), visited.end(), 0);
+        epoch = 1;
+    }
+
+    const int c0 = column(qx0), c1 = column(qx1);
+    const int r0 = row(qy0), r1 = row(qy1);
+    for (int r = r0; r <= r1; r++) {
+        for (int c = c0; c <= c1; c++) {
+            const std::size_t cellIndex = std::size_t(r) * cols + c;
+            for (int k = cellStart[cellIndex]; k < cellStart[cellIndex + 1]; k++) {
+                const int i = entries[k];
+                if (visited[i] == epoch)
+                    continue;
+                visited[i] = epoch;
+                if (x0[i] <= qx1 && x1[i] >= qx0 && y0[i] <= qy1 && y1[i] >= qy0)
+                    out.push_back(i);
+            }
+        }
+    }
+    std::sort(out.begin(), out.end());
+}
@@ -0,0 +1,68 @@
+//
+//  spatial_grid.h
+//  Inference
+//
+//  Uniform-grid spatial hash over frame coordinates, rebuilt per frame from
+//  a BoxSet in O(n): a counting pass sizes each cell, a second pass fills a
+//  flat entry array, and a box spanning several cells is listed in each.
+//  A query returns the boxes overlapping (or within a margin of) a box by
+//  visiting only the cells it covers, so NMS and association skip pairs
+//  that cannot overlap instead of testing all of them.
+//
+
+#ifndef spatial_grid_h
+#define spatial_grid_h
+
+#include <cstdint>
+#include <vector>
+
+#include "box_set.h"
+
+class SpatialGrid {
+public:
+    // A cellSize of 0 picks the mean box extent, so a typical box covers
+    // one to four cells.
+    void build(const BoxSet& boxes, float cellSize = 0.f);
+    void clear();
+
+    std::size_t size() const { return x0.size(); }
+    float getCellSize() const { return cell; }
+
+    // Indices of the boxes touching `box` grown by `margin` on each side,
+    // ascending. Not thread safe: queries share a visited mark per box.
+    void query(const Box2f& box, float margin, std::vector<int>& out) const;
+
+    // Raw cell walk for hot loops: calls visit(cellEntries, count) for each
+    // cell under `box`. Entries within a cell are ascending, but a box
+    // spanning several cells shows up once per cell, and entries are not
+    // filtered against `box`.
+    template <typename Visit>
+    void forEachCell(const Box2f& box, Visit&& visit) const {
+        if (x0.empty())
+            return;
+        const int c0 = column(box.x0), c1 = column(box.x1);
+        const int r0 = row(box.y0), r1 = row(box.y1);
+        for (int r = r0; r <= r1; r++)
+            for (int c = c0; c <= c1; c++) {
+                const std::size_t cellIndex = std::size_t(r) * cols + c;
+                visit(entries.data() + cellStart[cellIndex], cellStart[cellIndex + 1] - cellStart[cellIndex]);
+            }
+    }
+
+private:
+    int column(float x) const;
+    int row(float y) const;
+
+    float cell = 1.f;
+    float originX = 0.f;
+    float originY = 0.f;
+    int cols = 0;
+    int rows = 0;
+    std::vector<int> cellStart;     // cols * rows + 1 offsets into entries
+    std::vector<int> entries;
+    std::vector<float> x0, y0, x1, y1;
+    mutable std::vector<std::uint32_t> visited;
+    mutable std::uint32_t epoch = 0;
+};
+
+#endif /* spatial_grid_h */
@@ -0,0 +1,280 @@
+//
+//  thread_budget.cpp
+//  Inference
+//
+
+#include "thread_budget.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <opencv2/opencv.hpp>
+
+#include <sys/resource.h>
+#if defined(__linux__)
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#include "metrics.h"
+
+namespace {
+
+// CPUs the process may run on, captured before any thread is pinned, so
+// core i of a budget is the i-th allowed CPU (taskset and cgroup limits
+// are respected).
+const std::vector<int>& allowedCpus()
+{
+    static const std::vector<int> cpus = [] {
+        std::vector<int> cpus;
+#if defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+                if (CPU_ISSET(cpu, &set))
+                    cpus.push_back(cpu);
+        }
+#endif
+        if (cpus.empty()) {
+            const int n = std::max(1, int(std::thread::hardware_concurrency()));
+            for (int cpu = 0; cpu < n; cpu++)
+                cpus.push_back(cpu);
+        }
+        return cpus;
+    }();
+    return cpus;
+}
+
+std::ostream& operator<<(std::ostream& os, const CoreRange& range)
+{
+    if (range.count <= 0)
+        return os << "-";
+    return os << range.first << "-" << range.first + range.count - 1;
+}
+
+}
+
+std::vector<int> CoreRange::cores() const
+{
+    std::vector<int> cores;
+    for (int i = 0; i < count; i++)
+        cores.push_back(first + i);
+    return cores;
+}
+
+// ---- PLAN ---- //
+ThreadBudget ThreadBudget::plan(const ThreadBudgetOptions& options)
+{
+    ThreadBudget budget;
+    budget.cores = options.cores > 0 ? std::min(options.cores, onlineCores()) : onlineCores();
+    budget.streams = std::max(1, options.streams);
+    budget.pinThreads = options.pinThreads;
+
+    // Small machines cannot spare a core for threads that are mostly asleep.
+    const int reserved = std::min(std::max(options.reservedCores, 0), budget.cores / 4);
+    const int available = budget.cores - reserved;
+    budget.appCores = {0, reserved};
+
+    if (budget.streams == 1) {
+        // Detection is synchronous here, so tracking and OpenCV run in the
+        // gaps between inference rounds on the same cores.
+        budget.inferenceCores = {reserved, available};
+        budget.trackingCores = budget.inferenceCores;
+        budget.inferenceWorkers = 1;
+        budget.inferenceThreads = available;
+        budget.trackingWorkers = 0;
+        budget.opencvThreads = available;
+        budget.openmpThreads = available;
+        budget.trackingOpenmpThreads = available;
+        return budget;
+    }
+
+    int inference = available;
+    if (available >= 2) {
+        const float share = std::min(std::max(options.inferenceShare, 0.f), 1.f);
+        inference = std::min(std::max(int(std::lround(available * share)), 1), available - 1);
+        budget.inferenceCores = {reserved, inference};
+        budget.trackingCores = {reserved + inference, available - inference};
+    } else {
+        budget.inferenceCores = {reserved, available};
+        budget.trackingCores = budget.inferenceCores;
+    }
+
+    budget.inferenceWorkers = std::min(std::max(options.maxInferenceWorkers, 1), inference);
+    budget.inferenceThreads = inference;
+    // More workers than streams would only idle, since a stream's tasks run in order.
+    budget.trackingWorkers = std::min(budget.trackingCores.count, budget.streams);
+    // Streams already keep every tracking core busy; a parallel_for inside
+    // one of them would only compete with the others.
+    budget.opencvThreads = 1;
+    budget.openmpThreads = inference / budget.inferenceWorkers;
+    budget.trackingOpenmpThreads = 1;
+    return budget;
+}
+
+void ThreadBudget::apply() const
+{
+    cv::setNumThreads(opencvThreads);
+    limitOpenMP(openmpThreads);
+}
+
+void ThreadBudget::limitOpenMP(int threads)
+{
+#if defined(_OPENMP)
+    if (threads <= 0)
+        return;
+    // ncnn sets its own team size per layer; this covers other parallel
+    // regions, and one active level keeps the recursive sections in
+    // qsort_descent_inplace from spawning nested teams.
+    omp_set_num_threads(threads);
+    omp_set_max_active_levels(1);
+#else
+    (void)threads;
+#endif
+}
+
+std::vector<int> ThreadBudget::affinity(const CoreRange& range) const
+{
+    if (!pinThreads)
+        return {};
+    return range.cores();
+}
+
+void ThreadBudget::print(std::ostream& os) const
+{
+    os << "[threads] cores=" << cores
+       << " streams=" << streams
+       << " app=" << appCores
+       << " inference=" << inferenceCores << " (" << inferenceWorkers << "x" << inferenceThreads / inferenceWorkers << ")"
+       << " tracking=" << trackingCores << " (" << (trackingWorkers ? trackingWorkers : 1) << ")"
+       << " opencv=" << opencvThreads
+       << " openmp=" << openmpThreads << "/" << trackingOpenmpThreads
+       << " pinned=" << (pinThreads ? "yes" : "no") << "\n";
+}
+
+bool ThreadBudget::pinCurrentThread(const std::vector<int>& cores)
+{
+#if defined(__linux__)
+    const std::vector<int>& cpus = allowedCpus();
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    int pinned = 0;
+    for (int core : cores) {
+        if (core < 0 || core >= int(cpus.size()) || cpus[core] >= CPU_SETSIZE)
+            continue;
+        CPU_SET(cpus[core], &set);
+        pinned++;
+    }
+    return pinned > 0 && pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    // macOS only takes affinity hints, not core sets.
+    (void)cores;
+    return false;
+#endif
+}
+
+int ThreadBudget::onlineCores()
+{
+    return int(allowedCpus().size());
+}
+
+// ---- CONTENTION ---- //
+ContentionMonitor::ContentionMonitor(const ThreadBudget& budget, std::chrono::milliseconds interval)
+    : budget(budget), interval(interval), start(sample()), last(start)
+{
+    thread = std::thread(&ContentionMonitor::run, this);
+}
+
+ContentionMonitor::~ContentionMonitor()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cond.notify_all();
+    thread.join();
+}
+
+ContentionMonitor::Sample ContentionMonitor::sample()
+{
+    Sample sample;
+    sample.time = std::chrono::steady_clock::now();
+
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        sample.cpuMs = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3
+            + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e3;
+        sample.involuntarySwitches = std::uint64_t(usage.ru_nivcsw);
+    }
+
+#if defined(__linux__)
+    // schedstat: time on the CPU, time runnable in the run queue, timeslices.
+    if (DIR* tasks = opendir("/proc/self/task")) {
+        while (dirent* entry = readdir(tasks)) {
+            if (entry->d_name[0] == '.')
+                continue;
+            std::ifstream schedstat(std::string("/proc/self/task/") + entry->d_name + "/schedstat");
+            unsigned long long runNs = 0, waitNs = 0;
+            if (schedstat >> runNs >> waitNs)
+                sample.runQueueWaitMs += waitNs / 1e6;
+        }
+        closedir(tasks);
+    }
+#endif
+    return sample;
+}
+
+void ContentionMonitor::record(const Sample& now)
+{
+    static metrics::Counter& runQueueWait = metrics::registry().counter("cpu_runqueue_wait_us");
+    static metrics::Counter& involuntary = metrics::registry().counter("cpu_involuntary_switches");
+
+    // Threads that exited since the last sample take their wait time with
+    // them, so the summed wait can shrink.
+    const double waitMs = std::max(0.0, now.runQueueWaitMs - last.runQueueWaitMs);
+    const std::uint64_t switches = now.involuntarySwitches - last.involuntarySwitches;
+    runQueueWait.add(std::uint64_t(waitMs * 1e3));
+    involuntary.add(switches);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.wallMs = std::chrono::duration<double, std::milli>(now.time - start.time).count();
+    stats.cpuMs = now.cpuMs - start.cpuMs;
+    stats.runQueueWaitMs += waitMs;
+    stats.involuntarySwitches += switches;
+    last = now;
+}
+
+void ContentionMonitor::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        cond.wait_for(lock, interval, [this] { return stopping; });
+        lock.unlock();
+        record(sample());
+        lock.lock();
+    }
+}
+
+ContentionStats ContentionMonitor::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void ContentionMonitor::printReport(std::ostream& os) const
+{
+    const ContentionStats stats = getStats();
+    os << std::fixed << std::setprecision(2);
+    os << "[cpu] budget=" << budget.cores
+       << " used=" << stats.coresUsed()
+       << " runQueueWaitMs=" << stats.runQueueWaitMs
+       << " waitPerCpuMs=" << stats.waitRatio()
+       << " involuntarySwitches=" << stats.involuntarySwitches << "\n";
+}
@@ -0,0 +1,132 @@
+//
+//  thread_budget.h
+//  Inference
+//
+//  One CPU budget for every thread pool in the process. ncnn (through
+//  OpenMP), OpenCV's parallel_for, the tracking executor and the app's own
+//  decode/encode/preview threads each size themselves to the whole machine
+//  by default, so together they oversubscribe it. ThreadBudget splits the
+//  cores between them once at startup: the reserved cores go to the app
+//  threads, the rest to inference and tracking. With pinning on, inference
+//  and executor workers are bound to their core ranges (Linux only).
+//  ContentionMonitor samples how long runnable threads waited for a core,
+//  which is what an oversubscribed budget shows up as.
+//
+
+#ifndef thread_budget_h
+#define thread_budget_h
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+struct CoreRange {
+    int first = 0;
+    int count = 0;
+
+    std::vector<int> cores() const;
+};
+
+struct ThreadBudgetOptions {
+    int cores = 0;              // 0: every online core
+    int streams = 1;
+    int reservedCores = 1;      // main, decode, encode and preview threads
+    float inferenceShare = 0.5f;    // of the unreserved cores, when streams run tracking in parallel
+    int maxInferenceWorkers = 2;
+    bool pinThreads = false;
+};
+
+// Thread counts and core ranges per subsystem. With a single stream the
+// tracker and the detector take turns on the same cores, so they share
+// them; with several streams they run side by side and split them.
+struct ThreadBudget {
+    int cores = 1;
+    int streams = 1;
+    bool pinThreads = false;
+
+    CoreRange appCores;
+    CoreRange inferenceCores;
+    CoreRange trackingCores;
+
+    int inferenceWorkers = 1;
+    int inferenceThreads = 1;   // ncnn threads over all inference workers
+    int trackingWorkers = 1;    // WorkStealingExecutor workers; 0 tracks on the main thread
+    int opencvThreads = 1;      // cv::setNumThreads
+    int openmpThreads = 1;      // OpenMP team size on the main thread and each inference worker
+    int trackingOpenmpThreads = 1;  // OpenMP team size on each tracking worker
+
+    static ThreadBudget plan(const ThreadBudgetOptions& options);
+
+    // Sets the process-wide OpenCV thread count and the calling thread's
+    // OpenMP team size. Inference and executor threads are sized (and
+    // pinned) through their own options.
+    void apply() const;
+
+    // Cores to pin a subsystem to, empty when pinning is off.
+    std::vector<int> affinity(const CoreRange& range) const;
+
+    void print(std::ostream& os) const;
+
+    // Binds the calling thread to `cores`; false where affinity is not
+    // supported or `cores` is empty.
+    static bool pinCurrentThread(const std::vector<int>& cores);
+    // OpenMP keeps the team size and nesting per thread, so every pool
+    // calls this on each of its threads; threads <= 0 leaves them alone.
+    static void limitOpenMP(int threads);
+    static int onlineCores();
+};
+
+struct ContentionStats {
+    double wallMs = 0.0;
+    double cpuMs = 0.0;             // process user + system time
+    double runQueueWaitMs = 0.0;    // runnable but waiting for a core, summed over threads (Linux)
+    std::uint64_t involuntarySwitches = 0;
+
+    // Cores busy on average, and time spent waiting per millisecond of CPU.
+    double coresUsed() const { return wallMs > 0 ? cpuMs / wallMs : 0.0; }
+    double waitRatio() const { return cpuMs > 0 ? runQueueWaitMs / cpuMs : 0.0; }
+};
+
+// Samples the process every `interval` on a background thread and adds the
+// deltas to the cpu_runqueue_wait_us / cpu_involuntary_switches counters.
+class ContentionMonitor {
+public:
+    explicit ContentionMonitor(const ThreadBudget& budget,
+                               std::chrono::milliseconds interval = std::chrono::milliseconds(1000));
+    ~ContentionMonitor();
+
+    ContentionMonitor(const ContentionMonitor&) = delete;
+    ContentionMonitor& operator=(const ContentionMonitor&) = delete;
+
+    ContentionStats getStats() const;
+    void printReport(std::ostream& os) const;
+
+private:
+    struct Sample {
+        std::chrono::steady_clock::time_point time;
+        double cpuMs = 0.0;
+        double runQueueWaitMs = 0.0;
+        std::uint64_t involuntarySwitches = 0;
+    };
+
+    static Sample sample();
+    void record(const Sample& now);
+    void run();
+
+    ThreadBudget budget;
+    std::chrono::milliseconds interval;
+    Sample start;
+    Sample last;
+
+    mutable std::mutex mutex;
+    std::condition_variable cond;
+    ContentionStats stats;
+    bool stopping = false;
+    std::thread thread;
+};
+
+#endif /* thread_budget_h */
@@ -0,0 +1,190 @@
+//
+//  tiled_detection.cpp
+//  Inference
+//
+
+#include "tiled_detection.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include "box_geometry.h"
+#include "metrics.h"
+#include "spatial_grid.h"
+
+namespace yolo {
+
+// Tile origins along one axis: a stride apart, the last one flush with the end.
+static std::vector<int> tile_origins(int length, int tile, int stride)
+{
+    if (length <= tile)
+        return {0};
+    std::vector<int> origins;
+    for (int x = 0; x + tile < length; x += stride)
+        origins.push_back(x);
+    origins.push_back(length - tile);
+    return origins;
+}
+
+std::vector<cv::Rect> tile_grid(cv::Size size, const TileLayout& layout)
+{
+    std::vector<cv::Rect> tiles;
+    if (size.width <= 0 || size.height <= 0)
+        return tiles;
+
+    const int tile = std::max(MAX_STRIDE, layout.tileSize);
+    const float overlap = std::min(std::max(layout.overlap, 0.f), 0.9f);
+    const int stride = std::max(1, int(tile * (1.f - overlap)));
+    const int tileW = std::min(tile, size.width);
+    const int tileH = std::min(tile, size.height);
+
+    for (int y : tile_origins(size.height, tile, stride))
+        for (int x : tile_origins(size.width, tile, stride))
+            tiles.emplace_back(x, y, tileW, tileH);
+    return tiles;
+}
+
+// ---- MERGE ---- //
+TileMerger::TileMerger(cv::Size frameSize, const TileMergeOptions& options)
+    : frameSize(frameSize), options(options)
+{
+}
+
+void TileMerger::add(const std::vector<BoxInfo>& tileBoxes, const cv::Rect& tile, cv::Size scaledSize)
+{
+    const float sx = float(frameSize.width) / scaledSize.width;
+    const float sy = float(frameSize.height) / scaledSize.height;
+    const float margin = options.edgeMargin;
+
+    // Only edges shared with another tile cut objects; the frame border does not.
+    const bool innerLeft = tile.x > 0;
+    const bool innerTop = tile.y > 0;
+    const bool innerRight = tile.x + tile.width < scaledSize.width;
+    const bool innerBottom = tile.y + tile.height < scaledSize.height;
+
+    for (const BoxInfo& info : tileBoxes) {
+        const Box2f local = Box2f::fromBBox(info.getBox());
+        // The decoder clips to the last pixel, so the far edges are width - 1.
+        const bool touches = (innerLeft && local.x0 <= margin)
+            || (innerTop && local.y0 <= margin)
+            || (innerRight && local.x1 >= tile.width - 1 - margin)
+            || (innerBottom && local.y1 >= tile.height - 1 - margin);
+
+        Box2f box;
+        box.x0 = (tile.x + local.x0) * sx;
+        box.y0 = (tile.y + local.y0) * sy;
+        box.x1 = (tile.x + local.x1) * sx;
+        box.y1 = (tile.y + local.y1) * sy;
+        boxes.push_back(box, info.getConfidence(), info.getClassId());
+        cut.push_back(touches);
+    }
+}
+
+void TileMerger::add(const std::vector<BoxInfo>& frameBoxes)
+{
+    for (const BoxInfo& info : frameBoxes) {
+        boxes.push_back(info);
+        cut.push_back(0);
+    }
+}
+
+// Greedy, highest score first: a lower-scored box of the same class is
+// dropped when it overlaps the kept box past the NMS threshold. When either
+// box was cut by a tile edge it is fused into the kept box (box union)
+// instead, as it also is when the smaller of the two lies mostly inside
+// the other.
+void TileMerger::merge(std::vector<BoxInfo>& results)
+{
+    static metrics::LatencyHistogram& mergeLatency = metrics::registry().histogram("tile_merge");
+    static metrics::Counter& fusedBoxes = metrics::registry().counter("tile_boxes_fused");
+    metrics::ScopedTimer timer(mergeLatency);
+
+    const int n = int(boxes.size());
+    std::vector<int> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [this](int a, int b) { return boxes.score[a] > boxes.score[b]; });
+    boxes.select(order);
+    std::vector<char> sortedCut(n);
+    for (int i = 0; i < n; i++)
+        sortedCut[i] = cut[order[i]];
+    cut.swap(sortedCut);
+
+    SpatialGrid grid;
+    grid.build(boxes);
+    std::vector<char> consumed(n, 0);
+    std::vector<int> near;
+
+    for (int i = 0; i < n; i++) {
+        if (consumed[i])
+            continue;
+        Box2f kept = boxes.box(i);
+        bool keptCut = cut[i];
+
+        // A fused box can reach boxes the previous query did not cover
+        // (an object cut by several tile edges), so query again until the
+        // kept box stops growing.
+        bool grown = true;
+        while (grown) {
+            grown = false;
+            grid.query(kept, 0.f, near);
+            for (int j : near) {
+                if (j <= i || consumed[j] || boxes.classId[j] != boxes.classId[i])
+                    continue;
+                const Box2f other = boxes.box(j);
+                const bool duplicate = geometry::iou(kept, other) > options.nmsThreshold;
+                const bool split = (keptCut || cut[j]) &&
+                    (duplicate || std::max(geometry::overlap(kept, other), geometry::overlap(other, kept)) > options.fuseThreshold);
+                if (split) {
+                    // A cut box is only part of the object, so even a duplicate
+                    // extends the kept box instead of being dropped.
+                    grown = grown || other.x0 < kept.x0 || other.y0 < kept.y0 || other.x1 > kept.x1 || other.y1 > kept.y1;
+                    kept.x0 = std::min(kept.x0, other.x0);
+                    kept.y0 = std::min(kept.y0, other.y0);
+                    kept.x1 = std::max(kept.x1, other.x1);
+                    kept.y1 = std::max(kept.y1, other.y1);
+                    keptCut = keptCut && cut[j];
+                    consumed[j] = 1;
+                    fusedBoxes.add();
+                } else if (duplicate) {
+                    consumed[j] = 1;
+                }
+            }
+        }
+
+        kept.x1 = std::min(kept.x1, float(frameSize.width - 1));
+        kept.y1 = std::min(kept.y1, float(frameSize.height - 1));
+        results.push_back(BoxInfo(-1, boxes.classId[i], boxes.score[i], kept.toBBox()));
+    }
+
+    boxes.clear();
+    cut.clear();
+}
+
+// ---- POLICY ---- //
+bool TilingPolicy::useTiles(const cv::Rect& target, cv::Size frameSize) const
+{
+    switch (mode) {
+        case TilingMode::Off:
+            return false;
+        case TilingMode::Always:
+            return true;
+        case TilingMode::Adaptive:
+            break;
+    }
+    if (target.empty())
+        return true;
+    const float fit = float(TARGET_SIZE) / std::max(frameSize.width, frameSize.height);
+    return std::min(target.width, target.height) * fit < minTargetPixels;
+}
+
+TilingMode TilingPolicy::parseMode(const std::string& name)
+{
+    if (name == "always" || name == "1")
+        return TilingMode::Always;
+    if (name == "adaptive")
+        return TilingMode::Adaptive;
+    return TilingMode::Off;
+}
+
+}
@@ -0,0 +1,84 @@
+//
+//  tiled_detection.h
+//  Inference
+//
+//  Sliced inference for high-resolution frames. Letterboxing a 4K frame to
+//  the 640 px network input leaves distant objects a few pixels tall, so
+//  the frame (optionally rescaled first) is cut into overlapping tiles that
+//  are each detected at close to native resolution. TileMerger maps the
+//  tile results back to frame coordinates and merges them: a cross-tile
+//  NMS drops duplicates from the overlap bands, and boxes cut by an inner
+//  tile edge are fused with their continuation in the neighbouring tile.
+//  TilingPolicy decides per detection round whether to tile at all.
+//
+
+#ifndef tiled_detection_h
+#define tiled_detection_h
+
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "box_set.h"
+#include "detector_yolo_inference.hpp"
+
+namespace yolo {
+
+struct TileLayout {
+    int tileSize = 640;         // tile side, in pixels of the scaled frame
+    float overlap = 0.2f;       // fraction of tileSize shared by neighbouring tiles
+    float scale = 1.f;          // frame scale before tiling: 1 is native, 0.5 halves it
+    bool fullFrame = true;      // also detect on the whole frame, for objects larger than a tile
+};
+
+// Tiles covering a frame of `size` (already scaled), in its pixels. Edge
+// tiles are shifted inwards rather than shrunk, so every tile is full size
+// when the frame is at least one tile large.
+std::vector<cv::Rect> tile_grid(cv::Size size, const TileLayout& layout);
+
+struct TileMergeOptions {
+    float nmsThreshold = NMS_THRESHOLD; // IoU above which the lower-scored box is dropped
+    float fuseThreshold = 0.5f;         // intersection over the smaller box for fusing cut boxes
+    float edgeMargin = 3.f;             // px from an inner tile edge that count as cut
+};
+
+class TileMerger {
+public:
+    explicit TileMerger(cv::Size frameSize, const TileMergeOptions& options = TileMergeOptions());
+
+    // `boxes` are in the pixels of `tile`, itself a region of the frame
+    // resized to `scaledSize`.
+    void add(const std::vector<BoxInfo>& boxes, const cv::Rect& tile, cv::Size scaledSize);
+    // Full-frame detections, already in frame coordinates.
+    void add(const std::vector<BoxInfo>& boxes);
+
+    std::size_t size() const { return boxes.size(); }
+
+    // Appends the merged boxes, highest score first, and resets the merger.
+    void merge(std::vector<BoxInfo>& results);
+
+private:
+    cv::Size frameSize;
+    TileMergeOptions options;
+    BoxSet boxes;
+    std::vector<char> cut;      // box touches an inner tile edge
+};
+
+enum class TilingMode { Off, Always, Adaptive };
+
+// Adaptive runs the full frame alone while the target is large enough at
+// network resolution, and switches to tiles when it shrinks below
+// minTargetPixels or no target is known.
+struct TilingPolicy {
+    TilingMode mode = TilingMode::Off;
+    TileLayout layout;
+    float minTargetPixels = 24.f;   // target's shorter side after letterboxing to TARGET_SIZE
+
+    bool useTiles(const cv::Rect& target, cv::Size frameSize) const;
+
+    static TilingMode parseMode(const std::string& name);
+};
+
+}
+
+#endif /* tiled_detection_h */
@@ -0,0 +1,396 @@
+//
+//  track_log.cpp
+//  Inference
+//
+
+#include "track_log.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <nlohmann/json.hpp>
+
+namespace {
+
+const std::uint32_t FILE_MAGIC = 0x4c54484f;   // "OHTL"
+const std::uint32_t BLOCK_MAGIC = 0x4b4c4254;  // "TBLK"
+const std::uint16_t FORMAT_VERSION = 1;
+
+struct FileHeader {
+    std::uint32_t magic;
+    std::uint16_t version;
+    std::uint16_t unused;           // 0; older files hold sizeof(TrackLogRecord), which nothing reads
+    std::uint32_t recordsPerBlock;
+    std::uint32_t reserved;
+};
+
+struct BlockHeader {
+    std::uint32_t magic;
+    std::uint32_t count;
+    std::uint32_t payloadBytes;
+    std::uint32_t firstFrame;
+    std::uint32_t lastFrame;
+    std::uint32_t checksum;
+    std::int64_t firstTimestamp;
+};
+
+static_assert(sizeof(FileHeader) == 16, "unexpected padding in FileHeader");
+static_assert(sizeof(BlockHeader) == 32, "unexpected padding in BlockHeader");
+
+// FNV-1a
+std::uint32_t checksum(const std::uint8_t* data, std::size_t size)
+{
+    std::uint32_t hash = 2166136261u;
+    for (std::size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void putVarint(std::vector<std::uint8_t>& out, std::uint64_t value)
+{
+    while (value >= 0x80) {
+        out.push_back(std::uint8_t(value) | 0x80);
+        value >>= 7;
+    }
+    out.push_back(std::uint8_t(value));
+}
+
+bool getVarint(const std::uint8_t*& p, const std::uint8_t* end, std::uint64_t& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        std::uint8_t byte = *p++;
+        value |= std::uint64_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+std::uint64_t zigzag(std::int64_t v) { return (std::uint64_t(v) << 1) ^ std::uint64_t(v >> 63); }
+std::int64_t unzigzag(std::uint64_t v) { return std::int64_t(v >> 1) ^ -std::int64_t(v & 1); }
+
+std::uint32_t floatBits(float f)
+{
+    std::uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+float bitsFloat(std::uint32_t bits)
+{
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// Walks the block headers; returns the end of the last intact block.
+std::size_t scanBlocks(const std::uint8_t* data, std::size_t size, std::vector<BlockHeader>* headers, std::vector<std::size_t>* offsets)
+{
+    std::size_t offset = sizeof(FileHeader);
+    while (offset + sizeof(BlockHeader) <= size) {
+        BlockHeader header;
+        std::memcpy(&header, data + offset, sizeof(header));
+        std::size_t payload = offset + sizeof(BlockHeader);
+        if (header.magic != BLOCK_MAGIC || header.payloadBytes > size - payload ||
+            checksum(data + payload, header.payloadBytes) != header.checksum)
+            break;
+        if (headers) headers->push_back(header);
+        if (offsets) offsets->push_back(payload);
+        offset = payload + header.payloadBytes;
+    }
+    return offset;
+}
+
+}
+
+// ---- WRITER ---- //
+TrackLogWriter::TrackLogWriter(const std::string& path, TrackLogMode mode, int recordsPerBlock)
+    : recordsPerBlock(std::max(1, recordsPerBlock))
+{
+    std::error_code error;
+    std::uintmax_t existing = 0;
+    if (mode == TrackLogMode::Append && std::filesystem::exists(path, error))
+        existing = std::filesystem::file_size(path, error);
+
+    if (existing > 0) {
+        // Keep what is intact and cut off a block torn by a crash.
+        std::ifstream in(path, std::ios::binary);
+        std::vector<std::uint8_t> contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        FileHeader header;
+        if (contents.size() < sizeof(header))
+            throw std::runtime_error("Not a track log: " + path);
+        std::memcpy(&header, contents.data(), sizeof(header));
+        if (header.magic != FILE_MAGIC || header.version != FORMAT_VERSION)
+            throw std::runtime_error("Not a track log: " + path);
+
+        std::vector<BlockHeader> headers;
+        std::size_t end = scanBlocks(contents.data(), contents.size(), &headers, nullptr);
+        if (end < contents.size())
+            std::filesystem::resize_file(path, end);
+        if (!headers.empty())
+            lastFrame = headers.back().lastFrame;
+        bytesWritten = end;
+    }
+
+    file = std::fopen(path.c_str(), existing > 0 ? "ab" : "wb");
+    if (!file)
+        throw std::runtime_error("Unable to open file: " + path);
+
+    if (existing == 0) {
+        FileHeader header = {FILE_MAGIC, FORMAT_VERSION, 0, std::uint32_t(this->recordsPerBlock), 0};
+        std::fwrite(&header, sizeof(header), 1, file);
+        bytesWritten = sizeof(header);
+    }
+    pending.reserve(this->recordsPerBlock);
+}
+
+TrackLogWriter::~TrackLogWriter()
+{
+    flush();
+    if (file)
+        std::fclose(file);
+}
+
+void TrackLogWriter::append(const TrackLogRecord& record)
+{
+    if (record.frameIndex < lastFrame) {
+        droppedCount++;
+        return;
+    }
+    lastFrame = record.frameIndex;
+    pending.push_back(record);
+    recordCount++;
+    if ((int)pending.size() >= recordsPerBlock)
+        flush();
+}
+
+void TrackLogWriter::flush()
+{
+    if (pending.empty() || !file)
+        return;
+
+    payload.clear();
+    TrackLogRecord prev;
+    prev.frameIndex = pending.front().frameIndex;
+    prev.timestampUs = pending.front().timestampUs;
+    for (const TrackLogRecord& r : pending) {
+        putVarint(payload, r.frameIndex - prev.frameIndex);
+        putVarint(payload, zigzag(r.timestampUs - prev.timestampUs));
+        putVarint(payload, zigzag(std::int64_t(r.trackId) - prev.trackId));
+        putVarint(payload, zigzag(std::int64_t(r.classId) - prev.classId));
+        putVarint(payload, floatBits(r.score) ^ floatBits(prev.score));
+        putVarint(payload, floatBits(r.x) ^ floatBits(prev.x));
+        putVarint(payload, floatBits(r.y) ^ floatBits(prev.y));
+        putVarint(payload, floatBits(r.width) ^ floatBits(prev.width));
+        putVarint(payload, floatBits(r.height) ^ floatBits(prev.height));
+        prev = r;
+    }
+
+    BlockHeader header;
+    header.magic = BLOCK_MAGIC;
+    header.count = std::uint32_t(pending.size());
+    header.payloadBytes = std::uint32_t(payload.size());
+    header.firstFrame = pending.front().frameIndex;
+    header.lastFrame = pending.back().frameIndex;
+    header.checksum = checksum(payload.data(), payload.size());
+    header.firstTimestamp = pending.front().timestampUs;
+
+    std::fwrite(&header, sizeof(header), 1, file);
+    std::fwrite(payload.data(), 1, payload.size(), file);
+    std::fflush(file);
+    bytesWritten += sizeof(header) + payload.size();
+    pending.clear();
+}
+
+// ---- READER ---- //
+TrackLogReader::TrackLogReader(const std::string& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Unable to open file: " + path);
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || std::size_t(st.st_size) < sizeof(FileHeader)) {
+        ::close(fd);
+        throw std::runtime_error("Not a track log: " + path);
+    }
+    size = std::size_t(st.st_size);
+    void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+        throw std::runtime_error("Unable to map file: " + path);
+    data = static_cast<const std::uint8_t*>(mapped);
+
+    FileHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != FILE_MAGIC || header.version != FORMAT_VERSION) {
+        ::munmap(const_cast<std::uint8_t*>(data), size);
+        throw std::runtime_error("Not a track log: " + path);
+    }
+
+    std::vector<BlockHeader> headers;
+    std::vector<std::size_t> offsets;
+    if (scanBlocks(data, size, &headers, &offsets) < size)
+        std::cerr << "Track log " << path << " ends in a damaged block, ignored\n";
+
+    blocks.reserve(headers.size());
+    for (std::size_t i = 0; i < headers.size(); i++) {
+        blocks.push_back({offsets[i], headers[i].count, headers[i].payloadBytes,
+                          headers[i].firstFrame, headers[i].lastFrame, headers[i].firstTimestamp});
+        recordCount += headers[i].count;
+    }
+}
+
+TrackLogReader::~TrackLogReader()
+{
+    if (data)
+        ::munmap(const_cast<std::uint8_t*>(data), size);
+}
+
+void TrackLogReader::decodeBlock(const BlockInfo& block, std::vector<TrackLogRecord>& records) const
+{
+    const std::uint8_t* p = data + block.offset;
+    const std::uint8_t* end = p + block.payloadBytes;
+
+    TrackLogRecord prev;
+    prev.frameIndex = block.firstFrame;
+    prev.timestampUs = block.firstTimestamp;
+    std::uint64_t v[9];
+    for (std::uint32_t i = 0; i < block.count; i++) {
+        for (std::uint64_t& field : v) {
+            if (!getVarint(p, end, field))
+                return;
+        }
+        TrackLogRecord r;
+        r.frameIndex = prev.frameIndex + std::uint32_t(v[0]);
+        r.timestampUs = prev.timestampUs + unzigzag(v[1]);
+        r.trackId = std::int32_t(prev.trackId + unzigzag(v[2]));
+        r.classId = std::int32_t(prev.classId + unzigzag(v[3]));
+        r.score = bitsFloat(floatBits(prev.score) ^ std::uint32_t(v[4]));
+        r.x = bitsFloat(floatBits(prev.x) ^ std::uint32_t(v[5]));
+        r.y = bitsFloat(floatBits(prev.y) ^ std::uint32_t(v[6]));
+        r.width = bitsFloat(floatBits(prev.width) ^ std::uint32_t(v[7]));
+        r.height = bitsFloat(floatBits(prev.height) ^ std::uint32_t(v[8]));
+        records.push_back(r);
+        prev = r;
+    }
+}
+
+std::vector<TrackLogRecord> TrackLogReader::readFrame(std::uint32_t frameIndex) const
+{
+    std::vector<TrackLogRecord> result;
+    // A frame's records can straddle a block boundary.
+    auto it = std::lower_bound(blocks.begin(), blocks.end(), frameIndex,
+                               [](const BlockInfo& block, std::uint32_t frame) { return block.lastFrame < frame; });
+    std::vector<TrackLogRecord> records;
+    for (; it != blocks.end() && it->firstFrame <= frameIndex; ++it) {
+        records.clear();
+        decodeBlock(*it, records);
+        for (const TrackLogRecord& r : records) {
+            if (r.frameIndex == frameIndex)
+                result.push_back(r);
+        }
+    }
+    return result;
+}
+
+std::vector<TrackLogRecord> TrackLogReader::readBlock(std::size_t index) const
+{
+    std::vector<TrackLogRecord> records;
+    if (index < blocks.size())
+        decodeBlock(blocks[index], records);
+    return records;
+}
+
+std::vector<TrackLogRecord> TrackLogReader::readAll() const
+{
+    std::vector<TrackLogRecord> records;
+    records.reserve(recordCount);
+    for (const BlockInfo& block : blocks)
+        decodeBlock(block, records);
+    return records;
+}
+
+// ---- JSON CONVERSION ---- //
+std::size_t exportTrackLogJson(const TrackLogReader& reader, const std::string& dir, std::int32_t trackId)
+{
+    std::filesystem::create_directories(dir);
+    std::size_t converted = 0;
+    for (const TrackLogRecord& r : reader.readAll()) {
+        if (r.trackId != trackId)
+            continue;
+
+        nlohmann::json j;
+        j["image_path"] = "frame_" + std::to_string(r.frameIndex);
+        j["bbox"] = {
+            {"x", int(r.x)},
+            {"y", int(r.y)},
+            {"width", int(r.width)},
+            {"height", int(r.height)}
+        };
+        std::time_t timestamp = std::time_t(r.timestampUs / 1000000);
+        j["timestamp"] = std::ctime(&timestamp);
+
+        const std::string filename = (std::filesystem::path(dir) / (std::to_string(r.frameIndex) + ".json")).string();
+        std::ofstream file(filename);
+        if (!file.is_open())
+            throw std::runtime_error("Unable to open file: " + filename);
+        file << std::setw(4) << j << std::endl;
+        converted++;
+    }
+    return converted;
+}
+
+std::size_t importTrackLogJson(const std::string& dir, TrackLogWriter& writer, std::int32_t trackId)
+{
+    std::map<std::uint32_t, std::filesystem::path> files;
+    for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+        if (entry.path().extension() != ".json") continue;
+        const std::string stem = entry.path().stem().string();
+        if (stem.empty() || !std::all_of(stem.begin(), stem.end(), ::isdigit)) continue;
+        files[std::uint32_t(std::stoul(stem))] = entry.path();
+    }
+
+    const std::size_t before = writer.getRecordCount();
+    for (const auto& file : files) {
+        std::ifstream in(file.second);
+        if (!in.is_open())
+            throw std::runtime_error("Unable to open file: " + file.second.string());
+        nlohmann::json j;
+        in >> j;
+
+        TrackLogRecord r;
+        r.frameIndex = file.first;
+        r.trackId = trackId;
+        r.score = 1.f;
+        r.x = j["bbox"]["x"];
+        r.y = j["bbox"]["y"];
+        r.width = j["bbox"]["width"];
+        r.height = j["bbox"]["height"];
+        if (j.contains("timestamp") && j["timestamp"].is_string()) {
+            std::tm tm = {};
+            std::istringstream timestamp(j["timestamp"].get<std::string>());
+            timestamp >> std::get_time(&tm, "%a %b %d %H:%M:%S %Y");
+            if (!timestamp.fail()) {
+                tm.tm_isdst = -1;
+                r.timestampUs = std::int64_t(std::mktime(&tm)) * 1000000;
+            }
+        }
+        writer.append(r);
+    }
+    return writer.getRecordCount() - before;
+}
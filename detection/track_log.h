@@ -0,0 +1,125 @@
+//
+//  track_log.h
+//  Inference
+//
+//  Append-only binary log of per-frame track results, replacing one JSON
+//  file per box (BoundingBoxSaver) for long or many-stream runs.
+//
+//  Layout (little-endian):
+//    file header   "OHTL", format version, records per block
+//    block header  record count, payload size, frame range, first
+//                  timestamp, payload checksum
+//    payload       the block's records, each delta-encoded against the
+//                  previous one: varints for frame/timestamp/id deltas and
+//                  for the XOR of the float bits (score and box), so a
+//                  steady track costs a few bytes per record instead of 40.
+//
+//  Every block decodes on its own, so the reader only has to walk the block
+//  headers to find a frame and decodes a single block per lookup. A block
+//  cut short by a crash is ignored.
+//
+
+#ifndef track_log_h
+#define track_log_h
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+struct TrackLogRecord {
+    std::uint32_t frameIndex = 0;
+    std::int64_t timestampUs = 0;   // microseconds since the epoch
+    std::int32_t trackId = 0;
+    std::int32_t classId = 0;
+    float score = 0.f;
+    float x = 0.f;
+    float y = 0.f;
+    float width = 0.f;
+    float height = 0.f;
+};
+
+enum class TrackLogMode {
+    Append,     // continue a track log already at the path
+    Truncate    // start a new one, replacing whatever the path holds
+};
+
+class TrackLogWriter {
+public:
+    // Throws on I/O errors, and when appending to a file that is not a
+    // track log.
+    explicit TrackLogWriter(const std::string& path, TrackLogMode mode = TrackLogMode::Append,
+                            int recordsPerBlock = 256);
+    ~TrackLogWriter();
+
+    TrackLogWriter(const TrackLogWriter&) = delete;
+    TrackLogWriter& operator=(const TrackLogWriter&) = delete;
+
+    // Records must come in non-decreasing frame order; others are dropped
+    // and counted.
+    void append(const TrackLogRecord& record);
+
+    // Writes the pending partial block.
+    void flush();
+
+    std::size_t getRecordCount() const { return recordCount; }
+    std::size_t getBytesWritten() const { return bytesWritten; }
+    std::size_t getDroppedCount() const { return droppedCount; }
+
+private:
+    FILE* file = nullptr;
+    int recordsPerBlock;
+    std::vector<TrackLogRecord> pending;
+    std::vector<std::uint8_t> payload;
+    std::uint32_t lastFrame = 0;
+    std::size_t recordCount = 0;
+    std::size_t droppedCount = 0;
+    std::size_t bytesWritten = 0;
+};
+
+class TrackLogReader {
+public:
+    // Maps the whole file read-only. Throws if it is not a track log.
+    explicit TrackLogReader(const std::string& path);
+    ~TrackLogReader();
+
+    TrackLogReader(const TrackLogReader&) = delete;
+    TrackLogReader& operator=(const TrackLogReader&) = delete;
+
+    std::size_t getRecordCount() const { return recordCount; }
+    std::size_t getBlockCount() const { return blocks.size(); }
+    bool empty() const { return blocks.empty(); }
+    std::uint32_t getFirstFrame() const { return blocks.empty() ? 0 : blocks.front().firstFrame; }
+    std::uint32_t getLastFrame() const { return blocks.empty() ? 0 : blocks.back().lastFrame; }
+
+    // All records of one frame (several tracks, or none).
+    std::vector<TrackLogRecord> readFrame(std::uint32_t frameIndex) const;
+    std::vector<TrackLogRecord> readBlock(std::size_t index) const;
+    std::vector<TrackLogRecord> readAll() const;
+
+private:
+    struct BlockInfo {
+        std::size_t offset;         // of the payload
+        std::uint32_t count;
+        std::uint32_t payloadBytes;
+        std::uint32_t firstFrame;
+        std::uint32_t lastFrame;
+        std::int64_t firstTimestamp;
+    };
+
+    void decodeBlock(const BlockInfo& block, std::vector<TrackLogRecord>& records) const;
+
+    const std::uint8_t* data = nullptr;
+    std::size_t size = 0;
+    std::vector<BlockInfo> blocks;
+    std::size_t recordCount = 0;
+};
+
+// Conversion to and from the BoundingBoxSaver JSON schema: one
+// <frameIndex>.json per record of `trackId` in `dir`. Returns the number of
+// records converted; on import, files the writer dropped (frames before the
+// end of the log it appends to) are not counted.
+std::size_t exportTrackLogJson(const TrackLogReader& reader, const std::string& dir, std::int32_t trackId = 0);
+std::size_t importTrackLogJson(const std::string& dir, TrackLogWriter& writer, std::int32_t trackId = 0);
+
+#endif /* track_log_h */
@@ -7,9 +7,12 @@
 
 #include "utils.h"
 
+#include <cstdio>
 #include <fstream>
 #include <sstream>
 
+#include "overlay_renderer.h"
+
 const int color_list[3][3] = {
     //{255 ,255 ,255}, //bg
     {255, 0, 0}, // Blue
@@ -74,56 +77,57 @@ getFileExtension (std::string const& filename)
 namespace draw {
 void drawBoundingBox(const cv::Mat &image, std::vector<BoxInfo> &bboxes, const float& fps, const std::size_t& count, const std::size_t& missCount, const std::size_t& twoTargetMissCount, const std::size_t& numSelectedDetBox, const std::size_t numTrackedBox, const bool& do_group )
 {
-    static const std::array<std::string, 3> class_names =  {"person",  "tennis racket"};
+    BoxSet boxes;
+    boxes.assign(bboxes);
+    drawBoundingBox(image, boxes, fps, count, missCount, twoTargetMissCount, numSelectedDetBox, numTrackedBox, do_group);
+}
+
+void drawBoundingBox(const cv::Mat &image, const BoxSet &bboxes, const float& fps, const std::size_t& count, const std::size_t& missCount, const std::size_t& twoTargetMissCount, const std::size_t& numSelectedDetBox, const std::size_t numTrackedBox, const bool& do_group )
+{
+    static const TextStyle labelStyle = {cv::FONT_HERSHEY_SIMPLEX, 0.7, 2, 0};
+    static const TextStyle counterStyle = {cv::FONT_HERSHEY_SIMPLEX, 1.0, 2, 3};
+    OverlayRenderer& renderer = OverlayRenderer::shared();
+    cv::Mat canvas = image;
     
     const auto src_w = image.cols;
     const auto src_h = image.rows;
     auto baseline = int{10};
-    std::string text;
+    char text[128];
     cv::Size label_size = {10, 10};
-    for (BoxInfo &bbox : bboxes)
+    for (std::size_t i = 0; i < bboxes.size(); i++)
     {
-        auto score = bbox.getConfidence();
-        // auto trackId = bbox.getId();
-        auto classId = bbox.getClassId();
-        auto boxData = bbox.getBox();
-        auto rectData = cv::Rect(boxData.x, boxData.y, boxData.w, boxData.h);
-        auto xc = bbox.getCenter().xc;
-        auto yc = bbox.getCenter().yc;
+        auto score = bboxes.score[i];
+        // auto trackId = bboxes.id[i];
+        auto classId = bboxes.classId[i];
+        auto rectData = bboxes.rect(i);
         
         const auto color = cv::Scalar(color_list[0][classId]);
         
         cv::rectangle(image, rectData, color);
         
-        auto x = boxData.x;
-        auto y = boxData.y - 10;
-        
-        text = "[" + std::to_string(classId) + "] "
-        + std::to_string(int(score *100) % 100) + "% "
-        + " W" + std::to_string(rectData.width) + ", H" + std::to_string(rectData.height) + " "
-        + " (" + std::to_string(boxData.x) + ", " + std::to_string(boxData.y) + ") ";
+        auto x = rectData.x;
+        auto y = rectData.y - 10;
         
-        if (bbox.getConfidence() * 100 < 1 && do_group)
-            text = " Grouped ";
-        
-        label_size =
-        cv::getTextSize(text, cv::FONT_HERSHEY_SIMPLEX, 0.7, 1, &baseline);
+        const bool grouped = score * 100 < 1 && do_group;
+        if (grouped)
+            std::snprintf(text, sizeof(text), " Grouped ");
+        else
+            std::snprintf(text, sizeof(text), "[%d] %d%%  W%d, H%d  (%d, %d) ",
+                          int(classId), int(score * 100) % 100, rectData.width, rectData.height, rectData.x, rectData.y);
         
+        label_size = renderer.measure(text, labelStyle, &baseline);
         
         if (y < 0)
             y = 0;
         if (x + label_size.width > image.cols)
             x = image.cols - label_size.width;
-        if (bbox.getConfidence() * 100 < 1 && do_group) {
-            
-            
+        if (grouped) {
             cv::rectangle(image, rectData, cv::Scalar(0,0,0), 2);
             cv::rectangle(image, cv::Rect(cv::Point(x, y),
                                           cv::Size(label_size.width, 2* label_size.height + baseline)),
                           cv::Scalar(0, 0, 0), -1);
             
-            cv::putText(image, text, cv::Point(x, y + 2* label_size.height),
-                        cv::FONT_HERSHEY_SIMPLEX, 0.7, cv::Scalar(255, 255, 255), 2);
+            renderer.drawText(canvas, text, cv::Point(x, y + 2* label_size.height), labelStyle, cv::Scalar(255, 255, 255));
         }
         else {
             cv::rectangle(image, rectData, color);
@@ -132,32 +136,26 @@ void drawBoundingBox(const cv::Mat &image, std::vector<BoxInfo> &bboxes, const f
                           cv::Rect(cv::Point(x, y),
                                    cv::Size(label_size.width, label_size.height + baseline)),
                           color, -1);
-            cv::putText(image, text, cv::Point(x, y + label_size.height),
-                        cv::FONT_HERSHEY_SIMPLEX, 0.7, cv::Scalar(255, 255, 255), 2);
-            
+            renderer.drawText(canvas, text, cv::Point(x, y + label_size.height), labelStyle, cv::Scalar(255, 255, 255));
         }
         
     }
-    cv::putText(image, "fps: " + std::to_string(int(fps)), cv::Point(50, 50 + label_size.height),
-                cv::FONT_HERSHEY_SIMPLEX, 1, cv::Scalar(0, 0, 0), 3);
-    cv::putText(image, "fps: " + std::to_string(int(fps)), cv::Point(50, 50 + label_size.height),
-                cv::FONT_HERSHEY_SIMPLEX, 1, cv::Scalar(255, 255, 255), 2);
-    cv::putText(image, "fi: " + std::to_string(count), cv::Point(src_w - 150,  50 + label_size.height ), cv::FONT_HERSHEY_SIMPLEX, 1, cv::Scalar(0, 0, 0), 3);
-    cv::putText(image, "fi: " + std::to_string(count), cv::Point(src_w - 150,  50 + label_size.height ), cv::FONT_HERSHEY_SIMPLEX, 1, cv::Scalar(255, 255, 255), 2);
-    
-    cv::putText(image, "miss1: " + std::to_string(missCount), cv::Point(50,  src_h - (50 + label_size.height) ), cv::FONT_HERSHEY_SIMPLEX, 1, cv::Scalar(0, 0, 0), 3);
-    cv::putText(image, "miss1: " + std::to_string(missCount), cv::Point(50, src_h - (50 + label_size.height) ), cv::FONT_HERSHEY_SIMPLEX, 1, cv::Scalar(255, 255, 255), 2);
-    
-    cv::putText(image, "miss2: " + std::to_string(twoTargetMissCount), cv::Point(50,  src_h - (150 + label_size.height) ), cv::FONT_HERSHEY_SIMPLEX, 1, cv::Scalar(0, 0, 0), 3);
-    cv::putText(image, "miss2: " + std::to_string(twoTargetMissCount), cv::Point(50, src_h - (150 + label_size.height) ), cv::FONT_HERSHEY_SIMPLEX, 1, cv::Scalar(255, 255, 255), 2);
-    
-    
-    cv::putText(image, "n(selDet): " + std::to_string(numSelectedDetBox), cv::Point(src_w - 200, src_h - (50 + label_size.height) ), cv::FONT_HERSHEY_SIMPLEX, 1, cv::Scalar(0, 0, 0), 3);
-    cv::putText(image, "n(selDet): " + std::to_string(numSelectedDetBox), cv::Point(src_w - 200, src_h - (50 + label_size.height) ), cv::FONT_HERSHEY_SIMPLEX, 1, cv::Scalar(255, 255, 255), 2);
-    
-    cv::putText(image, "n(track): " + std::to_string(numTrackedBox), cv::Point(src_w - 200, src_h - (150 + label_size.height) ), cv::FONT_HERSHEY_SIMPLEX, 1, cv::Scalar(0, 0, 0), 3);
-    cv::putText(image, "n(track): " + std::to_string(numTrackedBox), cv::Point(src_w - 200, src_h - (150 + label_size.height) ), cv::FONT_HERSHEY_SIMPLEX, 1, cv::Scalar(255, 255, 255), 2);
     
+    // White on a black outline; each one is a single cached blit while its
+    // value does not change.
+    const cv::Scalar white(255, 255, 255);
+    std::snprintf(text, sizeof(text), "fps: %d", int(fps));
+    renderer.drawText(canvas, text, cv::Point(50, 50 + label_size.height), counterStyle, white);
+    std::snprintf(text, sizeof(text), "fi: %zu", count);
+    renderer.drawText(canvas, text, cv::Point(src_w - 150, 50 + label_size.height), counterStyle, white);
+    std::snprintf(text, sizeof(text), "miss1: %zu", missCount);
+    renderer.drawText(canvas, text, cv::Point(50, src_h - (50 + label_size.height)), counterStyle, white);
+    std::snprintf(text, sizeof(text), "miss2: %zu", twoTargetMissCount);
+    renderer.drawText(canvas, text, cv::Point(50, src_h - (150 + label_size.height)), counterStyle, white);
+    std::snprintf(text, sizeof(text), "n(selDet): %zu", numSelectedDetBox);
+    renderer.drawText(canvas, text, cv::Point(src_w - 200, src_h - (50 + label_size.height)), counterStyle, white);
+    std::snprintf(text, sizeof(text), "n(track): %zu", numTrackedBox);
+    renderer.drawText(canvas, text, cv::Point(src_w - 200, src_h - (150 + label_size.height)), counterStyle, white);
 }
 
 }
@@ -165,20 +163,28 @@ void drawBoundingBox(const cv::Mat &image, std::vector<BoxInfo> &bboxes, const f
 namespace bboxUtils {
 
 
+// Most confident box first. With more than maximum_number boxes the rest
+// follows by area, so only the best box needs finding, not a full sort by
+// confidence.
 void sortBoundingBox(const std::size_t maximum_number, BoxInfoVector& detectedBBoxes) {
-    std::sort(detectedBBoxes.begin(), detectedBBoxes.end(), [](BoxInfo& a, BoxInfo& b) {
-        return a.getConfidence() > b.getConfidence();
-    });
-    
-    if (detectedBBoxes.size() > maximum_number) {
-        std::sort(detectedBBoxes.begin() + 1, detectedBBoxes.end(),[](BoxInfo& a, BoxInfo& b) {
-            return (a.getBox().w * a.getBox().h) > (b.getBox().w * b.getBox().h);
+    if (detectedBBoxes.size() <= maximum_number) {
+        std::sort(detectedBBoxes.begin(), detectedBBoxes.end(), [](BoxInfo& a, BoxInfo& b) {
+            return a.getConfidence() > b.getConfidence();
         });
+        return;
     }
+    
+    auto best = std::max_element(detectedBBoxes.begin(), detectedBBoxes.end(), [](BoxInfo& a, BoxInfo& b) {
+        return a.getConfidence() < b.getConfidence();
+    });
+    std::iter_swap(detectedBBoxes.begin(), best);
+    std::sort(detectedBBoxes.begin() + 1, detectedBBoxes.end(),[](BoxInfo& a, BoxInfo& b) {
+        return (a.getBox().w * a.getBox().h) > (b.getBox().w * b.getBox().h);
+    });
 }
 
 
-double calculateIoU(BoxInfo &obj0, BoxInfo &obj1) {
+double calculateIoU(const BoxInfo &obj0, const BoxInfo &obj1) {
     int32_t interx0 = (std::max)(obj0.getLeft(), obj1.getLeft());
     int32_t intery0 = (std::max)(obj0.getTop(), obj1.getTop());
     int32_t interx1 = (std::min)(obj0.getRight(), obj1.getRight());
@@ -193,7 +199,7 @@ double calculateIoU(BoxInfo &obj0, BoxInfo &obj1) {
     return static_cast<double>(areaInter) / areaSum;
 }
 
-double calculateOverlap(BoxInfo target, BoxInfo other) {
+double calculateOverlap(const BoxInfo& target, const BoxInfo& other) {
     int32_t interx0 = (std::max)(target.getLeft(), other.getLeft());
     int32_t intery0 = (std::max)(target.getTop(), other.getTop());
     int32_t interx1 = (std::min)(target.getRight(), other.getRight());
@@ -240,7 +246,9 @@ double calculateOverlap(cv::Rect target, BBox other) {
 }
 
 double computeDistance(const BBoxCenter& center1, const BBoxCenter& center2) {
-    return sqrt(pow(center2.xc - center1.xc, 2) + pow(center2.yc - center1.yc, 2));
+    const double dx = center2.xc - center1.xc;
+    const double dy = center2.yc - center1.yc;
+    return std::sqrt(dx * dx + dy * dy);
 }
 
 
@@ -260,133 +268,28 @@ bool isPointInside(const cv::Rect& inputBox, const cv::Point& inputPoint) {
 
 
 int getConfidenceScoreRank(double score) {
-    std::vector<std::pair<double, int>> boundaries = {
-        {0.50, 10},
-        {0.55, 9},
-        {0.60, 8},
-        {0.65, 7},
-        {0.70, 6},
-        {0.75, 5},
-        {0.80, 4},
-        {0.85, 3},
-        {0.90, 2},
-        {0.95, 1},
-        {1.00, 0},
-    };
-
-    for (const auto& boundary : boundaries) {
-        if (score <= boundary.first)
-            return boundary.second;
-    }
-
-    // Return a default rank if score doesn't fit any range
-    return 11; // Larger number than current rank.
+    return confidenceRanks.lookup(score);
 }
 
 int getDistanceRank(double distance, double thresh) {
-    double normalizedDist = distance / thresh;
-    
-    std::vector<std::pair<double, int>> boundaries = {
-        {0.01, 0},
-        {0.02, 1},
-        {0.04, 2},
-        {0.07, 3},
-        {0.12, 4},
-        {0.19, 5},
-        {0.27, 6},
-        {0.35, 7},
-        {0.44, 8},
-        {0.54, 9},
-        {0.65, 10},
-        {0.77, 11},
-        {1.00, 12}
-    };
-
-    for (const auto& boundary : boundaries) {
-        if (normalizedDist <= boundary.first)
-            return boundary.second;
-    }
-
-    // Return a default rank if score doesn't fit any range
-    return 15; // Indicates an error or not found by case
+    return distanceRanks.lookup(distance / thresh);
 }
 
 int getDistanceFromRank(double distance) {
-    double normalizedDist = distance;
-    
-    std::vector<std::pair<double, int>> boundaries = {
-        {0.05, 0},
-        {0.1, 1},
-        {0.2, 2},
-        {0.3, 3},
-        {0.4, 4},
-        {0.5, 5},
-        {0.55, 6},
-        {0.60, 7},
-        {0.65, 8},
-        {0.70, 9},
-        {0.75, 10},
-        {0.85, 11},
-        {0.95, 12}
-    };
-
-    for (const auto& boundary : boundaries) {
-        if (normalizedDist <= boundary.first)
-            return boundary.second;
-    }
-
-    // Return a default rank if score doesn't fit any range
-    return 15; // Indicates an error or not found by case
+    return distanceFromRanks.lookup(distance);
 }
-int getAreaRank(double area, double maxArea) {
-    double normalizedArea = area / maxArea;
-    
-    std::vector<std::pair<double, int>> boundaries = {
-        {0.0, 10},
-        {0.1, 9},
-        {0.4, 6},
-        {0.7, 3},
-        {1.0, 0}
-    };
-    
-    for (const auto& boundary : boundaries) {
-        if (normalizedArea <= boundary.first)
-            return boundary.second;
-    }
 
-    // Return a default rank if score doesn't fit any range
-    return 11; // Indicates an error or not found
+int getAreaRank(double area, double maxArea) {
+    return areaRanks.lookup(area / maxArea);
 }
 
 int getOverlapRank(cv::Rect prevBox, BBox currBBox) {
     if (prevBox.empty())
         return 0;
-    double overlap = calculateOverlap(prevBox, currBBox);
-    std::vector<std::pair<double, int>> boundaries = {
-        {0.01, 10},
-        {0.1, 9},
-        {0.2, 8},
-        {0.3, 7},
-        {0.4, 6},
-        {0.5, 5},
-        {0.6, 4},
-        {0.7, 3},
-        {0.8, 2},
-        {0.9, 1},
-        {1.01, 0}
-    };
-    
-    for (const auto& boundary : boundaries) {
-        if (overlap <= boundary.first)
-            return boundary.second;
-    }
-
-    return 11;
-
-    
+    return overlapRanks.lookup(calculateOverlap(prevBox, currBBox));
 }
 
-void setIntersectionBox(BoxInfo boxInfo1, BoxInfo boxInfo2, cv::Rect& box) {
+void setIntersectionBox(const BoxInfo& boxInfo1, const BoxInfo& boxInfo2, cv::Rect& box) {
     
     int xmin = std::max(boxInfo1.getLeft(), boxInfo2.getLeft());
     int ymin = std::max(boxInfo1.getTop() , boxInfo2.getTop());
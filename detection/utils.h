@@ -11,8 +11,10 @@
 #include <stdio.h>
 #include <iostream>
 #include <algorithm>
+#include <array>
 #include <opencv2/opencv.hpp>
 
+#include "box_set.h"
 #include "boxinfo.h"
 
 
@@ -39,6 +41,7 @@ std::string currentDateTime();
 
 namespace draw {
 void drawBoundingBox(const cv::Mat &image, std::vector<BoxInfo> &bboxes, const float& fps, const std::size_t& count, const std::size_t& missCount, const std::size_t& twoTargetMissCount, const std::size_t& numSelectedDetBox, const std::size_t numTrackedBox, const bool& do_group );
+void drawBoundingBox(const cv::Mat &image, const BoxSet &bboxes, const float& fps, const std::size_t& count, const std::size_t& missCount, const std::size_t& twoTargetMissCount, const std::size_t& numSelectedDetBox, const std::size_t numTrackedBox, const bool& do_group );
 }
 
 
@@ -72,20 +75,65 @@ BBox convertToBBox(const T& rd) {
     return {rd.x, rd.y, rd.width, rd.height};
 }
 
-double calculateIoU(BoxInfo &obj0, BoxInfo &obj1);
-double calculateOverlap(BoxInfo target, BoxInfo other);
+double calculateIoU(const BoxInfo &obj0, const BoxInfo &obj1);
+double calculateOverlap(const BoxInfo& target, const BoxInfo& other);
 double calculateOverlap(cv::Rect target, BBox other);
 double computeDistance(const BBoxCenter& center1, const BBoxCenter& center2);
 
 cv::Point getRectCenter(const cv::Rect& input);
 bool isPointInside(const cv::Rect& inputBox, const cv::Point& inputPoint);
 
+// ---- RANK TABLES ---- //
+// A rank is looked up by counting the inclusive upper bounds the value lies
+// above: no branches, no allocation, and a loop the compiler unrolls or
+// vectorizes. Values above the last bound (and NaN) get the fallback rank.
+template <std::size_t N>
+struct RankTable {
+    std::array<double, N> upper;    // ascending
+    std::array<int, N + 1> rank;    // rank[N] is the fallback
+
+    constexpr int lookup(double value) const {
+        int bucket = 0;     // an int index keeps the gather vectorizable
+        for (std::size_t i = 0; i < N; i++)
+            bucket += !(value <= upper[i]);
+        return rank[bucket];
+    }
+};
+
+inline constexpr RankTable<11> confidenceRanks = {
+    {0.50, 0.55, 0.60, 0.65, 0.70, 0.75, 0.80, 0.85, 0.90, 0.95, 1.00},
+    {10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0, 11}};
+
+// Distance normalized by the threshold.
+inline constexpr RankTable<13> distanceRanks = {
+    {0.01, 0.02, 0.04, 0.07, 0.12, 0.19, 0.27, 0.35, 0.44, 0.54, 0.65, 0.77, 1.00},
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 15}};
+
+// Distance already normalized (e.g. by the frame diagonal).
+inline constexpr RankTable<13> distanceFromRanks = {
+    {0.05, 0.1, 0.2, 0.3, 0.4, 0.5, 0.55, 0.60, 0.65, 0.70, 0.75, 0.85, 0.95},
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 15}};
+
+// Area normalized by the largest expected area.
+inline constexpr RankTable<5> areaRanks = {
+    {0.0, 0.1, 0.4, 0.7, 1.0},
+    {10, 9, 6, 3, 0, 11}};
+
+// Intersection over the previous box.
+inline constexpr RankTable<11> overlapRanks = {
+    {0.01, 0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.7, 0.8, 0.9, 1.01},
+    {10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0, 11}};
+
+static_assert(confidenceRanks.lookup(0.5) == 10 && confidenceRanks.lookup(0.97) == 0 && confidenceRanks.lookup(1.5) == 11);
+static_assert(distanceRanks.lookup(0.0) == 0 && distanceRanks.lookup(0.3) == 7 && distanceRanks.lookup(2.0) == 15);
+static_assert(areaRanks.lookup(0.05) == 9 && areaRanks.lookup(1.0) == 0);
+
 int getConfidenceScoreRank(double score);
 int getDistanceRank(double distance, double thresh);
 int getDistanceFromRank(double distance);
 int getAreaRank(double area, double maxArea);
 int getOverlapRank(cv::Rect prevBox, BBox currBBox);
-void setIntersectionBox(BoxInfo boxInfo1, BoxInfo boxInfo2, cv::Rect& box);
+void setIntersectionBox(const BoxInfo& boxInfo1, const BoxInfo& boxInfo2, cv::Rect& box);
  }
 
 
@@ -0,0 +1,232 @@
+//
+//  work_stealing_executor.cpp
+//  Inference
+//
+
+#include "work_stealing_executor.h"
+
+#include <iostream>
+
+#include "thread_budget.h"
+
+namespace {
+thread_local const WorkStealingExecutor* currentExecutor = nullptr;
+thread_local int currentWorker = -1;
+}
+
+WorkStealingExecutor::WorkStealingExecutor(int numWorkers, int tasksPerTurn, std::vector<int> cpuAffinity, int openmpThreads)
+    : tasksPerTurn(std::max(1, tasksPerTurn)), cpuAffinity(std::move(cpuAffinity)), openmpThreads(openmpThreads),
+      startTime(std::chrono::steady_clock::now())
+{
+    numWorkers = std::max(1, numWorkers);
+    for (int i = 0; i < numWorkers; i++)
+        workers.push_back(std::make_unique<Worker>());
+    for (int i = 0; i < numWorkers; i++)
+        workers[i]->thread = std::thread(&WorkStealingExecutor::workerLoop, this, i);
+}
+
+WorkStealingExecutor::~WorkStealingExecutor()
+{
+    waitIdle();
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    sleepCond.notify_all();
+    for (auto& worker : workers)
+        worker->thread.join();
+}
+
+int WorkStealingExecutor::createStrand()
+{
+    std::lock_guard<std::mutex> lock(strandsMutex);
+    strands.push_back(std::make_unique<Strand>());
+    return int(strands.size() - 1);
+}
+
+void WorkStealingExecutor::post(int strandId, Task task)
+{
+    {
+        std::lock_guard<std::mutex> lock(idleMutex);
+        pendingTasks++;
+    }
+    push(strandId, std::move(task));
+}
+
+std::function<void(WorkStealingExecutor::Task)> WorkStealingExecutor::defer(int strandId)
+{
+    {
+        std::lock_guard<std::mutex> lock(idleMutex);
+        pendingTasks++;
+    }
+    return [this, strandId](Task task) { push(strandId, std::move(task)); };
+}
+
+// Queues a task whose pendingTasks slot is already taken.
+void WorkStealingExecutor::push(int strandId, Task task)
+{
+    Strand* strand;
+    {
+        std::lock_guard<std::mutex> lock(strandsMutex);
+        strand = strands[strandId].get();
+    }
+
+    bool schedule = false;
+    {
+        std::lock_guard<std::mutex> lock(strand->mutex);
+        strand->tasks.push_back(std::move(task));
+        if (!strand->scheduled) {
+            strand->scheduled = true;
+            schedule = true;
+        }
+    }
+    if (schedule)
+        enqueue(strand);
+}
+
+void WorkStealingExecutor::waitIdle()
+{
+    std::unique_lock<std::mutex> lock(idleMutex);
+    idleCond.wait(lock, [this] { return pendingTasks == 0; });
+}
+
+void WorkStealingExecutor::enqueue(Strand* strand)
+{
+    // Work posted from a worker stays on that worker (its caches are warm);
+    // work from outside is spread round-robin.
+    int index = currentExecutor == this ? currentWorker : int(nextWorker++ % workers.size());
+    {
+        std::lock_guard<std::mutex> lock(workers[index]->mutex);
+        workers[index]->ready.push_back(strand);
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        readyStrands++;
+    }
+    sleepCond.notify_one();
+}
+
+WorkStealingExecutor::Strand* WorkStealingExecutor::popLocal(int index)
+{
+    Worker& worker = *workers[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.ready.empty())
+        return nullptr;
+    Strand* strand = worker.ready.front();
+    worker.ready.pop_front();
+    return strand;
+}
+
+WorkStealingExecutor::Strand* WorkStealingExecutor::steal(int index)
+{
+    const int n = int(workers.size());
+    for (int k = 1; k < n; k++) {
+        Worker& victim = *workers[(index + k) % n];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.ready.empty())
+            continue;
+        Strand* strand = victim.ready.back();
+        victim.ready.pop_back();
+        return strand;
+    }
+    return nullptr;
+}
+
+void WorkStealingExecutor::runStrand(int index, Strand* strand)
+{
+    Worker& worker = *workers[index];
+
+    for (int turn = 0; turn < tasksPerTurn; turn++) {
+        Task task;
+        {
+            std::lock_guard<std::mutex> lock(strand->mutex);
+            if (strand->tasks.empty())
+                break;
+            task = std::move(strand->tasks.front());
+            strand->tasks.pop_front();
+        }
+
+        auto t0 = std::chrono::steady_clock::now();
+        try {
+            task();
+        } catch (const std::exception& e) {
+            std::cerr << "Executor task failed: " << e.what() << std::endl;
+        } catch (...) {
+            std::cerr << "Executor task failed with an unknown exception" << std::endl;
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        worker.busyNs += std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+        worker.tasks++;
+
+        {
+            std::lock_guard<std::mutex> lock(idleMutex);
+            if (--pendingTasks == 0)
+                idleCond.notify_all();
+        }
+    }
+
+    // The strand stays owned by this worker until it is either drained or
+    // handed back to a deque, so its tasks never run concurrently.
+    bool requeue;
+    {
+        std::lock_guard<std::mutex> lock(strand->mutex);
+        requeue = !strand->tasks.empty();
+        if (!requeue)
+            strand->scheduled = false;
+    }
+    if (requeue)
+        enqueue(strand);
+}
+
+void WorkStealingExecutor::workerLoop(int index)
+{
+    currentExecutor = this;
+    currentWorker = index;
+    if (!cpuAffinity.empty())
+        ThreadBudget::pinCurrentThread(cpuAffinity);
+    ThreadBudget::limitOpenMP(openmpThreads);
+
+    while (true) {
+        Strand* strand = popLocal(index);
+        if (!strand) {
+            strand = steal(index);
+            if (strand)
+                workers[index]->steals++;
+        }
+
+        if (!strand) {
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleepCond.wait(lock, [this] { return stopping || readyStrands > 0; });
+            if (stopping && readyStrands == 0)
+                return;
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            readyStrands--;
+        }
+        runStrand(index, strand);
+    }
+}
+
+ExecutorStats WorkStealingExecutor::getStats() const
+{
+    ExecutorStats stats;
+    double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+    for (const auto& worker : workers) {
+        ExecutorWorkerStats ws;
+        ws.tasks = worker->tasks;
+        ws.steals = worker->steals;
+        ws.busyMs = worker->busyNs / 1e6;
+        ws.utilization = wallMs > 0 ? ws.busyMs / wallMs : 0.0;
+        stats.tasks += ws.tasks;
+        stats.steals += ws.steals;
+        stats.utilization += ws.utilization;
+        stats.workers.push_back(ws);
+    }
+    if (!workers.empty())
+        stats.utilization /= workers.size();
+    return stats;
+}
@@ -0,0 +1,111 @@
+//
+//  work_stealing_executor.h
+//  Inference
+//
+//  Task executor for the per-frame work of many streams. Tasks are posted to
+//  a strand (one per stream) and run strictly in posting order; ready strands
+//  sit in per-worker deques and idle workers steal them from the far end of
+//  another worker's deque, so one expensive stream cannot leave cores idle.
+//
+
+#ifndef work_stealing_executor_h
+#define work_stealing_executor_h
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct ExecutorWorkerStats {
+    std::size_t tasks = 0;
+    std::size_t steals = 0;
+    double busyMs = 0.0;
+    double utilization = 0.0; // busy time / wall time since start
+};
+
+struct ExecutorStats {
+    std::vector<ExecutorWorkerStats> workers;
+    std::size_t tasks = 0;
+    std::size_t steals = 0;
+    double utilization = 0.0; // mean over workers
+};
+
+class WorkStealingExecutor {
+public:
+    using Task = std::function<void()>;
+
+    // tasksPerTurn bounds how many tasks of one strand a worker runs before
+    // it moves on to the next ready strand. Workers are pinned to
+    // cpuAffinity (budget cores, see ThreadBudget) when it is not empty, and
+    // limited to OpenMP teams of openmpThreads when it is positive.
+    explicit WorkStealingExecutor(int numWorkers, int tasksPerTurn = 4, std::vector<int> cpuAffinity = {},
+                                  int openmpThreads = 0);
+    ~WorkStealingExecutor();
+
+    WorkStealingExecutor(const WorkStealingExecutor&) = delete;
+    WorkStealingExecutor& operator=(const WorkStealingExecutor&) = delete;
+
+    int createStrand();
+    void post(int strandId, Task task);
+
+    // For work that finishes outside the executor (e.g. inference): returns
+    // a callback that posts its task to `strandId`. Until it has been called
+    // (exactly once, from any thread) waitIdle() counts it as pending, but no
+    // worker waits for it.
+    std::function<void(Task)> defer(int strandId);
+
+    // Blocks until every posted task, including tasks posted by tasks, has run.
+    void waitIdle();
+
+    int getNumWorkers() const { return int(workers.size()); }
+    ExecutorStats getStats() const;
+
+private:
+    struct Strand {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        bool scheduled = false;
+    };
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Strand*> ready;
+        std::atomic<std::size_t> tasks{0};
+        std::atomic<std::size_t> steals{0};
+        std::atomic<long long> busyNs{0};
+        std::thread thread;
+    };
+
+    void push(int strandId, Task task);
+    void enqueue(Strand* strand);
+    Strand* popLocal(int index);
+    Strand* steal(int index);
+    void runStrand(int index, Strand* strand);
+    void workerLoop(int index);
+
+    int tasksPerTurn;
+    std::vector<int> cpuAffinity;
+    int openmpThreads;
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::chrono::steady_clock::time_point startTime;
+
+    std::mutex strandsMutex;
+    std::vector<std::unique_ptr<Strand>> strands;
+
+    std::mutex sleepMutex;
+    std::condition_variable sleepCond;
+    std::size_t readyStrands = 0;
+    bool stopping = false;
+    std::atomic<std::size_t> nextWorker{0};
+
+    std::mutex idleMutex;
+    std::condition_variable idleCond;
+    std::size_t pendingTasks = 0;
+};
+
+#endif /* work_stealing_executor_h */
@@ -0,0 +1,200 @@
+//
+//  yolo_decode_layer.cpp
+//  Inference
+//
+
+#include "yolo_decode_layer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+namespace yolo {
+
+const char* const DECODE_OUTPUT = "cand0";
+
+static const char* DECODE_TYPE = "YoloDecode";
+static const char* DECODE_INPUT = "out0";
+
+// Anchors scanned together: the best score and label of a block stay in
+// L1 while every class row goes over it.
+static const int DECODE_BLOCK = 256;
+
+YoloDecodeLayer::YoloDecodeLayer()
+{
+    one_blob_only = true;
+    support_inplace = false;
+    // ncnn hands the layer unpacked fp32 whatever the rest of the graph uses.
+    support_packing = false;
+    support_fp16_storage = false;
+}
+
+int YoloDecodeLayer::load_param(const ncnn::ParamDict& pd)
+{
+    num_labels = pd.get(0, 0);
+    score_threshold = pd.get(1, 0.f);
+    clip_w = pd.get(2, 0);
+    clip_h = pd.get(3, 0);
+    return 0;
+}
+
+int YoloDecodeLayer::forward(const ncnn::Mat& bottom_blob, ncnn::Mat& top_blob, const ncnn::Option& opt) const
+{
+    const int num_anchors = bottom_blob.w;
+    const int labels = num_labels > 0 ? std::min(num_labels, bottom_blob.h - 4) : bottom_blob.h - 4;
+    if (bottom_blob.dims != 2 || labels <= 0)
+        return -1;
+
+    ncnn::Mat best(num_anchors, (size_t)4u, opt.workspace_allocator);
+    ncnn::Mat label(num_anchors, (size_t)4u, opt.workspace_allocator);
+    if (best.empty() || label.empty())
+        return -100;
+
+    // Same row-by-row scan as parse_yolov_detections(), blocked over anchors
+    // and split across the extractor's threads.
+    const int num_blocks = (num_anchors + DECODE_BLOCK - 1) / DECODE_BLOCK;
+    #pragma omp parallel for num_threads(opt.num_threads)
+    for (int b = 0; b < num_blocks; b++)
+    {
+        const int begin = b * DECODE_BLOCK;
+        const int end = std::min(begin + DECODE_BLOCK, num_anchors);
+        float* bestp = (float*)best.data;
+        int* labelp = (int*)label.data;
+        const float* first = bottom_blob.row(4);
+        for (int i = begin; i < end; i++)
+        {
+            bestp[i] = first[i];
+            labelp[i] = 0;
+        }
+        for (int k = 1; k < labels; k++)
+        {
+            const float* row = bottom_blob.row(4 + k);
+            for (int i = begin; i < end; i++)
+            {
+                const bool higher = row[i] > bestp[i];
+                bestp[i] = higher ? row[i] : bestp[i];
+                labelp[i] = higher ? k : labelp[i];
+            }
+        }
+    }
+
+    const float* bestp = (const float*)best.data;
+    const int* labelp = (const int*)label.data;
+    int count = 0;
+    for (int i = 0; i < num_anchors; i++)
+        count += bestp[i] > score_threshold;
+
+    top_blob.create(DECODE_COLUMNS, std::max(count, 1), (size_t)4u, opt.blob_allocator);
+    if (top_blob.empty())
+        return -100;
+    if (count == 0)
+    {
+        top_blob.fill(0.f);
+        return 0;
+    }
+
+    const float max_x = clip_w > 0 ? (float)clip_w : FLT_MAX;
+    const float max_y = clip_h > 0 ? (float)clip_h : FLT_MAX;
+    const float* xs = bottom_blob.row(0);
+    const float* ys = bottom_blob.row(1);
+    const float* ws = bottom_blob.row(2);
+    const float* hs = bottom_blob.row(3);
+    int n = 0;
+    for (int i = 0; i < num_anchors; i++)
+    {
+        if (bestp[i] <= score_threshold)
+            continue;
+        float* out = top_blob.row(n++);
+        out[DECODE_X0] = clampf(xs[i] - 0.5f * ws[i], 0.f, max_x);
+        out[DECODE_Y0] = clampf(ys[i] - 0.5f * hs[i], 0.f, max_y);
+        out[DECODE_X1] = clampf(xs[i] + 0.5f * ws[i], 0.f, max_x);
+        out[DECODE_Y1] = clampf(ys[i] + 0.5f * hs[i], 0.f, max_y);
+        out[DECODE_SCORE] = bestp[i];
+        out[DECODE_LABEL] = (float)labelp[i];
+    }
+    return 0;
+}
+
+DEFINE_LAYER_CREATOR(YoloDecodeLayer)
+
+// The param text with one more layer and one more blob: the counts on the
+// second line, and the layer line at the end.
+static bool append_decode_layer(const std::string& param, const DecodeLayerParams& params, std::string& result)
+{
+    std::istringstream in(param);
+    std::string magic;
+    int layerCount = 0, blobCount = 0;
+    if (!(in >> magic >> layerCount >> blobCount))
+        return false;
+    std::string layers((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (layers.find(std::string(" ") + DECODE_INPUT) == std::string::npos)
+        return false;
+    while (!layers.empty() && (layers.back() == '\n' || layers.back() == '\r' || layers.back() == ' '))
+        layers.pop_back();
+
+    std::ostringstream out;
+    out << magic << "\n" << layerCount + 1 << " " << blobCount + 1 << layers << "\n";
+    // ncnn reads a value as float only when it has a decimal point.
+    char threshold[32];
+    std::snprintf(threshold, sizeof(threshold), "%f", params.scoreThreshold);
+    out << DECODE_TYPE << " decode_0 1 1 " << DECODE_INPUT << " " << DECODE_OUTPUT
+        << " 0=" << params.numLabels << " 1=" << threshold
+        << " 2=" << params.clipWidth << " 3=" << params.clipHeight << "\n";
+    result = out.str();
+    return true;
+}
+
+int load_param_with_decode(ncnn::Net& net, const std::string& paramPath, const DecodeLayerParams& params)
+{
+    std::ifstream file(paramPath);
+    if (!file)
+        return -1;
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+
+    std::string param;
+    if (!append_decode_layer(buffer.str(), params, param))
+        return -1;
+    net.register_custom_layer(DECODE_TYPE, YoloDecodeLayer_layer_creator);
+    return net.load_param_mem(param.c_str());
+}
+
+bool has_fused_decode(const ncnn::Net& net)
+{
+    for (const char* name : net.output_names())
+    {
+        if (std::strcmp(name, DECODE_OUTPUT) == 0)
+            return true;
+    }
+    return false;
+}
+
+void decode_candidates(const DetectorClassInfo& classInfo, const ncnn::Mat& candidates, const Letterbox& lb,
+                       float nms_threshold, BoxSet& results)
+{
+    BoxSet proposals;
+    proposals.reserve(candidates.h);
+    for (int i = 0; i < candidates.h; i++)
+    {
+        const float* row = candidates.row(i);
+        if (row[DECODE_SCORE] <= 0.f)
+            continue;
+        Box2f box{row[DECODE_X0], row[DECODE_Y0], row[DECODE_X1], row[DECODE_Y1]};
+        proposals.push_back(box, row[DECODE_SCORE], (int)row[DECODE_LABEL]);
+    }
+    select_detections(classInfo, proposals, lb, nms_threshold, results);
+}
+
+void decode_candidates(const DetectorClassInfo& classInfo, const ncnn::Mat& candidates, const Letterbox& lb,
+                       float nms_threshold, std::vector<BoxInfo>& results)
+{
+    BoxSet boxes;
+    decode_candidates(classInfo, candidates, lb, nms_threshold, boxes);
+    boxes.appendTo(results);
+}
+
+}
@@ -0,0 +1,77 @@
+//
+//  yolo_decode_layer.h
+//  Inference
+//
+//  Detection decoding as the last layer of the graph. The YOLO head ends in
+//  out0, (4 + classes) x 8400 floats that the host used to copy out and
+//  scan in full. YoloDecode runs right after the Concat that produces it,
+//  while the tensor is still in cache: best class per anchor, threshold,
+//  centre/size to corners, and only the anchors that pass come out, as
+//  rows of (x0, y0, x1, y1, score, label) in anchor order. The host is
+//  left with NMS over a few dozen rows.
+//
+//  The layer is not in the exported .param files; load_param_with_decode()
+//  registers it and appends it behind out0 when the graph is loaded.
+//
+
+#ifndef yolo_decode_layer_h
+#define yolo_decode_layer_h
+
+#include <string>
+#include "layer.h"
+#include "net.h"
+
+#include "box_set.h"
+#include "detector_class_info.h"
+#include "detector_yolo_inference.hpp"
+
+namespace yolo {
+
+// Name of the blob the layer writes, extracted instead of out0.
+extern const char* const DECODE_OUTPUT;
+
+// Columns of a candidate row.
+enum DecodeColumn { DECODE_X0, DECODE_Y0, DECODE_X1, DECODE_Y1, DECODE_SCORE, DECODE_LABEL, DECODE_COLUMNS };
+
+// Param ids: 0 = classes to consider (0: every row after the box),
+// 1 = score threshold, 2/3 = width/height boxes are clamped to (0: none).
+class YoloDecodeLayer : public ncnn::Layer {
+public:
+    YoloDecodeLayer();
+
+    int load_param(const ncnn::ParamDict& pd) override;
+    // No candidate still produces one row, of zeros: ncnn blobs cannot be
+    // empty. Its score never passes a threshold.
+    int forward(const ncnn::Mat& bottom_blob, ncnn::Mat& top_blob, const ncnn::Option& opt) const override;
+
+private:
+    int num_labels = 0;
+    float score_threshold = 0.f;
+    int clip_w = 0;
+    int clip_h = 0;
+};
+
+struct DecodeLayerParams {
+    int numLabels = 0;
+    float scoreThreshold = PROB_THRESHOLD;
+    int clipWidth = TARGET_SIZE;
+    int clipHeight = TARGET_SIZE;
+};
+
+// Loads the graph at `paramPath` with YoloDecode appended after out0.
+// Returns non-zero, like Net::load_param(), if the file cannot be read or
+// has no out0; the net is then left without a graph.
+int load_param_with_decode(ncnn::Net& net, const std::string& paramPath, const DecodeLayerParams& params);
+
+// True if `net` was loaded through load_param_with_decode().
+bool has_fused_decode(const ncnn::Net& net);
+
+// NMS, target filtering and mapping back to the frame for the layer's
+// candidate rows; the counterpart of decode_detections() for out0.
+void decode_candidates(const DetectorClassInfo& classInfo, const ncnn::Mat& candidates, const Letterbox& lb,
+                       float nms_threshold, BoxSet& results);
+void decode_candidates(const DetectorClassInfo& classInfo, const ncnn::Mat& candidates, const Letterbox& lb,
+                       float nms_threshold, std::vector<BoxInfo>& results);
+}
+
+#endif /* yolo_decode_layer_h */
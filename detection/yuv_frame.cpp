@@ -0,0 +1,153 @@
+//
+//  yuv_frame.cpp
+//  Inference
+//
+
+#include "yuv_frame.h"
+
+#include <iostream>
+
+// ---- YUV FRAME ---- //
+void YuvFrame::toBgr(cv::Mat& bgr) const
+{
+    cv::cvtColor(data, bgr, format == YuvFormat::NV12 ? cv::COLOR_YUV2BGR_NV12 : cv::COLOR_YUV2BGR_I420);
+}
+
+// Chroma is subsampled 2x2, so a region must start and end on even pixels.
+static cv::Rect evenRegion(const cv::Rect& region, int width, int height)
+{
+    int x0 = std::max(0, region.x) & ~1;
+    int y0 = std::max(0, region.y) & ~1;
+    int x1 = std::min(width, (region.x + region.width + 1) & ~1);
+    int y1 = std::min(height, (region.y + region.height + 1) & ~1);
+    if (x1 <= x0 || y1 <= y0)
+        return cv::Rect();
+    return cv::Rect(x0, y0, x1 - x0, y1 - y0);
+}
+
+void YuvFrame::toBgr(const cv::Rect& region, cv::Mat& bgr) const
+{
+    if (bgr.rows != height || bgr.cols != width || bgr.type() != CV_8UC3)
+        bgr.create(height, width, CV_8UC3);
+
+    const cv::Rect aligned = evenRegion(region, width, height);
+    if (aligned.empty())
+        return;
+
+    const int x0 = aligned.x, y0 = aligned.y;
+    cv::Rect chroma(x0 / 2, y0 / 2, aligned.width / 2, aligned.height / 2);
+    cv::Mat y = luma()(aligned);
+    cv::Mat dst = bgr(aligned);
+    unsigned char* chromaBase = data.data + size_t(height) * data.step;
+
+    if (format == YuvFormat::NV12) {
+        cv::Mat uvPlane(height / 2, width / 2, CV_8UC2, chromaBase, data.step);
+        cv::cvtColorTwoPlane(y, uvPlane(chroma), dst, cv::COLOR_YUV2BGR_NV12);
+    } else {
+        const size_t chromaStep = width / 2;
+        cv::Mat uPlane(height / 2, width / 2, CV_8UC1, chromaBase, chromaStep);
+        cv::Mat vPlane(height / 2, width / 2, CV_8UC1, chromaBase + chromaStep * (height / 2), chromaStep);
+        cv::Mat uv;
+        cv::merge(std::vector<cv::Mat>{uPlane(chroma), vPlane(chroma)}, uv);
+        cv::cvtColorTwoPlane(y, uv, dst, cv::COLOR_YUV2BGR_NV12);
+    }
+}
+
+cv::Rect YuvFrame::crop(const cv::Rect& region, YuvFrame& out) const
+{
+    const cv::Rect aligned = evenRegion(region, width, height);
+    out.format = format;
+    out.width = aligned.width;
+    out.height = aligned.height;
+    if (aligned.empty()) {
+        out.data.release();
+        return aligned;
+    }
+    out.data.create(out.height * 3 / 2, out.width, CV_8UC1);
+    cv::Mat outY = out.data.rowRange(0, out.height);
+    luma()(aligned).copyTo(outY);
+
+    const cv::Rect chroma(aligned.x / 2, aligned.y / 2, aligned.width / 2, aligned.height / 2);
+    unsigned char* chromaBase = data.data + size_t(height) * data.step;
+    unsigned char* outChroma = out.data.data + size_t(out.height) * out.data.step;
+    if (format == YuvFormat::NV12) {
+        cv::Mat uvPlane(height / 2, width / 2, CV_8UC2, chromaBase, data.step);
+        cv::Mat outUv(out.height / 2, out.width / 2, CV_8UC2, outChroma, out.data.step);
+        uvPlane(chroma).copyTo(outUv);
+    } else {
+        const size_t chromaStep = width / 2;
+        const size_t outStep = out.width / 2;
+        cv::Mat uPlane(height / 2, width / 2, CV_8UC1, chromaBase, chromaStep);
+        cv::Mat vPlane(height / 2, width / 2, CV_8UC1, chromaBase + chromaStep * (height / 2), chromaStep);
+        cv::Mat outU(out.height / 2, out.width / 2, CV_8UC1, outChroma, outStep);
+        cv::Mat outV(out.height / 2, out.width / 2, CV_8UC1, outChroma + outStep * (out.height / 2), outStep);
+        uPlane(chroma).copyTo(outU);
+        vPlane(chroma).copyTo(outV);
+    }
+    return aligned;
+}
+
+void YuvFrame::resize(cv::Size size, YuvFrame& out, int interpolation) const
+{
+    out.format = format;
+    out.width = std::max(2, size.width & ~1);
+    out.height = std::max(2, size.height & ~1);
+    out.data.create(out.height * 3 / 2, out.width, CV_8UC1);
+
+    cv::Mat outY = out.data.rowRange(0, out.height);
+    cv::resize(luma(), outY, outY.size(), 0, 0, interpolation);
+
+    const cv::Size chromaSize(out.width / 2, out.height / 2);
+    unsigned char* chromaBase = data.data + size_t(height) * data.step;
+    unsigned char* outChroma = out.data.data + size_t(out.height) * out.data.step;
+    if (format == YuvFormat::NV12) {
+        cv::Mat uvPlane(height / 2, width / 2, CV_8UC2, chromaBase, data.step);
+        cv::Mat outUv(chromaSize, CV_8UC2, outChroma, out.data.step);
+        cv::resize(uvPlane, outUv, chromaSize, 0, 0, interpolation);
+    } else {
+        const size_t chromaStep = width / 2;
+        const size_t outStep = out.width / 2;
+        cv::Mat uPlane(height / 2, width / 2, CV_8UC1, chromaBase, chromaStep);
+        cv::Mat vPlane(height / 2, width / 2, CV_8UC1, chromaBase + chromaStep * (height / 2), chromaStep);
+        cv::Mat outU(chromaSize, CV_8UC1, outChroma, outStep);
+        cv::Mat outV(chromaSize, CV_8UC1, outChroma + outStep * chromaSize.height, outStep);
+        cv::resize(uPlane, outU, chromaSize, 0, 0, interpolation);
+        cv::resize(vPlane, outV, chromaSize, 0, 0, interpolation);
+    }
+}
+
+// ---- READER ---- //
+bool YuvVideoReader::open(const std::string& path)
+{
+    const std::string pipeline = "filesrc location=\"" + path + "\" ! decodebin ! videoconvert"
+                                 " ! video/x-raw,format=NV12 ! appsink sync=false";
+    if (!cap.open(pipeline, cv::CAP_GSTREAMER))
+        return false;
+    cap.set(cv::CAP_PROP_CONVERT_RGB, 0);
+
+    // The layout is only known once a frame arrives: NV12 comes back as a
+    // single-channel buffer 1.5x as tall as the picture.
+    if (!cap.read(pending) || pending.type() != CV_8UC1 || pending.rows % 3 != 0) {
+        std::cerr << "No NV12 output from GStreamer for " << path << "\n";
+        cap.release();
+        return false;
+    }
+    size = cv::Size(pending.cols, pending.rows * 2 / 3);
+    return true;
+}
+
+bool YuvVideoReader::read(YuvFrame& frame)
+{
+    cv::Mat data;
+    if (!pending.empty()) {
+        data = pending;
+        pending.release();
+    } else if (!cap.read(data) || data.empty()) {
+        return false;
+    }
+    frame.data = data.isContinuous() ? data : data.clone();
+    frame.format = YuvFormat::NV12;
+    frame.width = size.width;
+    frame.height = size.height;
+    return true;
+}
@@ -0,0 +1,71 @@
+//
+//  yuv_frame.h
+//  Inference
+//
+//  Decoder-native 4:2:0 frames. Decoders produce NV12/I420; going through
+//  cv::VideoCapture's default path converts every frame to full-size BGR,
+//  which the detector immediately shrinks to 640 px again. A YuvFrame keeps
+//  the planes as decoded: the detector resizes them before the colour
+//  conversion (see yolo::letterbox), the frame gate reads the Y plane, and
+//  BGR is produced only for the regions the tracker or the output need.
+//
+
+#ifndef yuv_frame_h
+#define yuv_frame_h
+
+#include <string>
+#include <opencv2/opencv.hpp>
+
+enum class YuvFormat {
+    NV12,   // Y plane, then interleaved UV at half resolution
+    I420    // Y plane, then U, then V, each at half resolution
+};
+
+struct YuvFrame {
+    cv::Mat data;                       // CV_8UC1, height * 3 / 2 rows, continuous
+    YuvFormat format = YuvFormat::NV12;
+    int width = 0;                      // even
+    int height = 0;                     // even
+
+    bool empty() const { return data.empty(); }
+    cv::Size size() const { return cv::Size(width, height); }
+
+    // Zero-copy view of the luma plane.
+    cv::Mat luma() const { return data.rowRange(0, height); }
+
+    // Converts the whole frame.
+    void toBgr(cv::Mat& bgr) const;
+
+    // Converts only `region` (grown to even coordinates) into the same region
+    // of `bgr`, which is (re)allocated to width x height CV_8UC3 if needed.
+    // Pixels outside the region are left untouched.
+    void toBgr(const cv::Rect& region, cv::Mat& bgr) const;
+
+    // Compact copy of `region` (grown to even coordinates) in the same
+    // format. Returns the region copied.
+    cv::Rect crop(const cv::Rect& region, YuvFrame& out) const;
+
+    // Copy resized to `size` (rounded down to even), plane by plane.
+    void resize(cv::Size size, YuvFrame& out, int interpolation = cv::INTER_AREA) const;
+};
+
+// Reads decoded frames without the BGR conversion, through a GStreamer
+// pipeline ending in an NV12 appsink. open() fails if OpenCV was built
+// without GStreamer or the backend still hands back BGR; callers then fall
+// back to the plain cv::VideoCapture path.
+class YuvVideoReader {
+public:
+    bool open(const std::string& path);
+    bool read(YuvFrame& frame);
+
+    bool isOpened() const { return cap.isOpened(); }
+    double getFps() const { return cap.get(cv::CAP_PROP_FPS); }
+    cv::Size getSize() const { return size; }
+
+private:
+    cv::VideoCapture cap;
+    cv::Mat pending;    // first frame, read by open() to check the layout
+    cv::Size size;
+};
+
+#endif /* yuv_frame_h */